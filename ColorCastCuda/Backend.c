@@ -0,0 +1,129 @@
+#include <string.h>
+#include "Backend.h"
+#include "Clock.h"
+#include "CpuProcess.h"
+#include "Failure.h"
+#include "Stage.h"
+
+// builds without the cuda toolkit define COLORCAST_NO_CUDA and only have the cpu backend
+#ifndef COLORCAST_NO_CUDA
+#include "Process.h"
+#endif
+
+Backend currentBackend = BACKEND_AUTO;
+
+// returns true if the gpu backend was built in and there is a gpu to run it on
+int isCudaBackendAvailable() {
+#ifdef COLORCAST_NO_CUDA
+    return 0;
+#else
+    return cudaIsAvailable();
+#endif
+}
+
+// selects the backend used by processBuffer and processStrips
+int setBackend(Backend backend) {
+    if (backend == BACKEND_AUTO) {
+        backend = isCudaBackendAvailable() ? BACKEND_CUDA : BACKEND_CPU;
+    }
+    else if (backend == BACKEND_CUDA && !isCudaBackendAvailable()) {
+        reportFailure("cuda backend is not available");
+        return -1;
+    }
+
+    currentBackend = backend;
+    return 0;
+}
+
+// returns the backend in use, picking one the first time it is needed
+Backend getBackend() {
+    if (currentBackend == BACKEND_AUTO) {
+        setBackend(BACKEND_AUTO);
+    }
+
+    return currentBackend;
+}
+
+// returns the name of a backend as used on the command line
+const char* getBackendName(Backend backend) {
+    switch (backend) {
+    case BACKEND_CUDA:
+        return "cuda";
+    case BACKEND_CPU:
+        return "cpu";
+    default:
+        return "auto";
+    }
+}
+
+// runs the kernel of the backend in use on a single pixel
+int warmUpBackend() {
+    unsigned char pixel[3] = { 200, 100, 50 };
+    unsigned char output[3];
+    unsigned char* outputs[1] = { output };
+    double power = 1;
+
+    return processBuffer(pixel, sizeof(pixel), &power, outputs, 1, 1, 1);
+}
+
+// converts a name from the command line into a backend
+int parseBackend(const char* name, Backend* backend) {
+    if (strcmp(name, "auto") == 0) {
+        *backend = BACKEND_AUTO;
+    }
+    else if (strcmp(name, "cuda") == 0) {
+        *backend = BACKEND_CUDA;
+    }
+    else if (strcmp(name, "cpu") == 0) {
+        *backend = BACKEND_CPU;
+    }
+    else {
+        return -1;
+    }
+
+    return 0;
+}
+
+// processes numBytes of contiguous rgb pixel data once for every power in a single pass
+int processBuffer(unsigned char* data, unsigned long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle) {
+#ifndef COLORCAST_NO_CUDA
+    if (getBackend() == BACKEND_CUDA) {
+        return cudaProcessBuffer(data, numBytes, powers, outputs, numPowers, bytesPerChannel, isLittle);
+    }
+#endif
+
+    // the cpu works on the pixels where they are, it has nothing to copy
+    CounterValues startCounts;
+    readCounters(&startCounts);
+    double start = getMonotonicTime();
+    int result = cpuProcessBuffer(data, numBytes, powers, outputs, numPowers, bytesPerChannel, isLittle);
+    addStageTime(STAGE_KERNEL, getMonotonicTime() - start, numBytes, numBytes / (3 * bytesPerChannel));
+    addStageCounters(STAGE_KERNEL, &startCounts);
+    return result;
+}
+
+// processes every strip of a file once for every power in a single pass
+int processStrips(unsigned char* data, unsigned long dataLen, unsigned int numStrips, unsigned int* stripOffsets,
+    unsigned int* bytesPerStrip, const double* powers, unsigned char** outputs, int numPowers, int bytesPerChannel,
+    int isLittle) {
+#ifndef COLORCAST_NO_CUDA
+    if (getBackend() == BACKEND_CUDA) {
+        return cudaProcessStrips(data, dataLen, numStrips, stripOffsets, bytesPerStrip, powers, outputs, numPowers,
+            bytesPerChannel, isLittle);
+    }
+#endif
+
+    unsigned long long numBytes = 0;
+    for (unsigned int i = 0; i < numStrips; i++) {
+        numBytes += bytesPerStrip[i];
+    }
+    CounterValues startCounts;
+    readCounters(&startCounts);
+    double start = getMonotonicTime();
+    int result = cpuProcessStrips(data, dataLen, numStrips, stripOffsets, bytesPerStrip, powers, outputs, numPowers,
+        bytesPerChannel, isLittle);
+    addStageTime(STAGE_KERNEL, getMonotonicTime() - start, numBytes, numBytes / (3 * bytesPerChannel));
+    addStageCounters(STAGE_KERNEL, &startCounts);
+    return result;
+}
@@ -0,0 +1,50 @@
+#ifndef COLORCAST_BACKEND_H
+#define COLORCAST_BACKEND_H
+
+// version of the output of the kernel. Bump it whenever a change to processPixel
+// changes the pixels it produces, so incremental runs convert every image again
+#define KERNEL_VERSION 1
+
+// most powers a single pass of the kernel produces outputs for
+#define MAX_POWERS 8
+
+// where the color cast kernel runs
+typedef enum {
+    BACKEND_AUTO,       // the gpu if there is one, otherwise the cpu
+    BACKEND_CUDA,
+    BACKEND_CPU
+} Backend;
+
+// selects the backend used by processBuffer and processStrips. BACKEND_AUTO is
+// resolved right away. returns 0 on success, -1 if the backend is not available
+int setBackend(Backend backend);
+
+// returns the backend in use
+Backend getBackend();
+
+// returns the name of a backend as used on the command line
+const char* getBackendName(Backend backend);
+
+// runs the kernel of the backend in use on a single pixel, so the gpu context and
+// everything the first image would set up is ready before it arrives.
+// returns 0 on success, -1 on failure
+int warmUpBackend();
+
+// converts a name from the command line (auto, cuda or cpu) into a backend.
+// returns 0 on success, -1 if the name is unknown
+int parseBackend(const char* name, Backend* backend);
+
+// processes numBytes of contiguous rgb pixel data once for every power in a single
+// pass. outputs[i] receives the pixels processed with powers[i] and may be data itself
+// to process in place. returns 0 on success, -1 on failure
+int processBuffer(unsigned char* data, unsigned long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle);
+
+// processes every strip of a file once for every power in a single pass. outputs[i]
+// is a copy of the file whose strips receive the pixels processed with powers[i], and
+// may be data itself. returns 0 on success, -1 on failure
+int processStrips(unsigned char* data, unsigned long dataLen, unsigned int numStrips, unsigned int* stripOffsets,
+    unsigned int* bytesPerStrip, const double* powers, unsigned char** outputs, int numPowers, int bytesPerChannel,
+    int isLittle);
+
+#endif //COLORCAST_BACKEND_H
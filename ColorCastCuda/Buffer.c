@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include <string.h>
+#include "Buffer.h"
+
+// initializes an empty buffer with room for cap bytes
+void initBuffer(Buffer* buffer, size_t cap) {
+    if (cap < 64) {
+        cap = 64;
+    }
+
+    buffer->data = malloc(cap);
+    buffer->len = 0;
+    buffer->cap = cap;
+}
+
+// makes sure there is room for extra more bytes
+void reserveBytes(Buffer* buffer, size_t extra) {
+    if (buffer->len + extra <= buffer->cap) {
+        return;
+    }
+
+    while (buffer->len + extra > buffer->cap) {
+        buffer->cap *= 2;
+    }
+    buffer->data = realloc(buffer->data, buffer->cap);
+}
+
+// appends len bytes to the end of the buffer
+void appendBytes(Buffer* buffer, const unsigned char* bytes, size_t len) {
+    reserveBytes(buffer, len);
+    memcpy(buffer->data + buffer->len, bytes, len);
+    buffer->len += len;
+}
+
+// appends a single byte to the end of the buffer
+void appendByte(Buffer* buffer, unsigned char byte) {
+    reserveBytes(buffer, 1);
+    buffer->data[buffer->len++] = byte;
+}
+
+// frees the memory held by the buffer
+void freeBuffer(Buffer* buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->len = 0;
+    buffer->cap = 0;
+}
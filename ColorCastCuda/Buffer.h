@@ -0,0 +1,25 @@
+#ifndef COLORCAST_BUFFER_H
+#define COLORCAST_BUFFER_H
+
+#include <stddef.h>
+
+// growable array of bytes used by the encoders
+typedef struct {
+    unsigned char* data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+// initializes an empty buffer with room for cap bytes
+void initBuffer(Buffer* buffer, size_t cap);
+
+// appends len bytes to the end of the buffer
+void appendBytes(Buffer* buffer, const unsigned char* bytes, size_t len);
+
+// appends a single byte to the end of the buffer
+void appendByte(Buffer* buffer, unsigned char byte);
+
+// frees the memory held by the buffer
+void freeBuffer(Buffer* buffer);
+
+#endif //COLORCAST_BUFFER_H
@@ -9,6 +9,12 @@ int isLittleEndian(unsigned char* data) {
     return (data[0] == data[1] && data[0] == 'I');
 }
 
+// returns true if the machine the program runs on is little endian
+int isHostLittleEndian() {
+    unsigned short test = 1;
+    return *(unsigned char*)&test == 1;
+}
+
 // returns an unsigned integer given its start location in the data, how many bytes long the int
 // assumes that bytes are in little endian ordering
 unsigned int getIntLittle(unsigned int start, unsigned int howManyBytes, unsigned char* data) {
@@ -77,4 +83,30 @@ unsigned char* getByteOrderFromInt(int input, int numBytes, int isLittleEndian)
     return getByteOrderFromIntBig(input, numBytes);
 }
 
+// writes the given value into data starting at start using howManyBytes bytes
+// in the given byte ordering. Counterpart of getInt, max howManyBytes is 4.
+void setInt(unsigned int value, unsigned int start, unsigned int howManyBytes, unsigned char* data, int isLittleEndian) {
+    for (unsigned int i = 0; i < howManyBytes; i++) {
+        unsigned char byte = value >> (i * BYTE);
+        if (isLittleEndian) {
+            data[start + i] = byte;
+        }
+        else {
+            data[start + howManyBytes - i - 1] = byte;
+        }
+    }
+}
 
+// like setInt for values of up to 8 bytes, such as the offsets of a BigTIFF
+void setLong(unsigned long long value, unsigned int start, unsigned int howManyBytes, unsigned char* data,
+    int isLittleEndian) {
+    for (unsigned int i = 0; i < howManyBytes; i++) {
+        unsigned char byte = (unsigned char)(value >> (i * BYTE));
+        if (isLittleEndian) {
+            data[start + i] = byte;
+        }
+        else {
+            data[start + howManyBytes - i - 1] = byte;
+        }
+    }
+}
@@ -6,6 +6,9 @@
 // match the format of a little endian tiff file
 int isLittleEndian(unsigned char* data);
 
+// returns true if the machine the program runs on is little endian
+int isHostLittleEndian();
+
 // returns an unsigned integer given its start location in the data, how many bytes long the int is
 // and the ordering of the bytes
 unsigned int getInt(unsigned int start, unsigned int howManyBytes, unsigned char* data, int isLittleEndian);
@@ -14,4 +17,12 @@ unsigned int getInt(unsigned int start, unsigned int howManyBytes, unsigned char
 // given byte ordering convention
 unsigned char* getByteOrderFromInt(int input, int numBytes, int isLittleEndian);
 
+// writes the given value into data starting at start using howManyBytes bytes
+// in the given byte ordering. Counterpart of getInt.
+void setInt(unsigned int value, unsigned int start, unsigned int howManyBytes, unsigned char* data, int isLittleEndian);
+
+// like setInt for values of up to 8 bytes, such as the offsets of a BigTIFF
+void setLong(unsigned long long value, unsigned int start, unsigned int howManyBytes, unsigned char* data,
+    int isLittleEndian);
+
 #endif //COLORCAST_BYTEORDERING_H
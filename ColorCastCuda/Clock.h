@@ -0,0 +1,8 @@
+#ifndef COLORCAST_CLOCK_H
+#define COLORCAST_CLOCK_H
+
+// returns the time in seconds from a monotonic clock. Only the difference
+// between two calls is meaningful.
+double getMonotonicTime();
+
+#endif //COLORCAST_CLOCK_H
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <string.h>
+#include "Counters.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+// the counters of one thread, closed when the thread ends
+typedef struct {
+    int fds[NUM_COUNTERS];
+} ThreadCounters;
+
+static int isCountingEnabled = 0;
+static pthread_key_t countersKey;
+
+// closes the counters of a thread that ended
+void closeThreadCounters(void* arg) {
+    ThreadCounters* counters = arg;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+        }
+    }
+    free(counters);
+}
+
+// opens the group of counters of this thread, the cycles lead so all of them are
+// scheduled onto the cpu together. returns NULL and keeps the reason in errno
+// if the kernel does not permit it
+ThreadCounters* openThreadCounters() {
+    static const unsigned long long configs[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    ThreadCounters* counters = malloc(sizeof(ThreadCounters));
+    if (counters == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // threads started later count into these, group reads do not allow that
+        attr.inherit = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int leader = i == 0 ? -1 : counters->fds[0];
+        counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (counters->fds[i] < 0) {
+            int error = errno;
+            for (int j = 0; j < i; j++) {
+                close(counters->fds[j]);
+            }
+            free(counters);
+            errno = error;
+            return NULL;
+        }
+    }
+
+    return counters;
+}
+
+// starts counting, trying the counters on this thread first
+int startCounters() {
+    ThreadCounters* counters = openThreadCounters();
+    if (counters == NULL) {
+        if (errno == EACCES || errno == EPERM) {
+            printf("hardware counters are not permitted, lower /proc/sys/kernel/perf_event_paranoid to count\n");
+        }
+        else {
+            printf("hardware counters are not available on this machine: %s\n", strerror(errno));
+        }
+        return -1;
+    }
+
+    pthread_key_create(&countersKey, closeThreadCounters);
+    pthread_setspecific(countersKey, counters);
+    isCountingEnabled = 1;
+    return 0;
+}
+
+// returns 1 if counting
+int isCounting() {
+    return isCountingEnabled;
+}
+
+// reads the counters of this thread, opening them the first time. The kernel shares
+// the counters between processes when there are too few of them, so each count is
+// scaled up from the time it was counted to the whole time
+void readCounters(CounterValues* values) {
+    memset(values, 0, sizeof(CounterValues));
+    if (!isCountingEnabled) {
+        return;
+    }
+
+    ThreadCounters* counters = pthread_getspecific(countersKey);
+    if (counters == NULL) {
+        counters = openThreadCounters();
+        if (counters == NULL) {
+            return;
+        }
+        pthread_setspecific(countersKey, counters);
+    }
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        unsigned long long data[3];     // value, time enabled, time running
+        if (read(counters->fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            continue;
+        }
+        values->values[i] = data[2] == data[1] ? data[0] : (unsigned long long)((double)data[0] * data[1] / data[2]);
+    }
+}
+
+#else
+
+// counting needs perf_event_open
+int startCounters() {
+    printf("hardware counters are only available on linux\n");
+    return -1;
+}
+
+// never counting
+int isCounting() {
+    return 0;
+}
+
+// every count is 0
+void readCounters(CounterValues* values) {
+    memset(values, 0, sizeof(CounterValues));
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef COLORCAST_COUNTERS_H
+#define COLORCAST_COUNTERS_H
+
+// hardware performance counters of the cpu, read with perf_event_open on linux. Every
+// thread counts with a group of its own that also counts the threads it starts, so
+// the threads of runParallel add to the thread that waits for them. Elsewhere, or when
+// the kernel does not permit counting, every count reads as 0.
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_MISSES,       // last level cache
+    COUNTER_BRANCH_MISSES,
+    NUM_COUNTERS
+} Counter;
+
+// counts since a thread started counting, or the difference of two of those
+typedef struct {
+    unsigned long long values[NUM_COUNTERS];
+} CounterValues;
+
+// starts counting on every thread that reads the counters. returns 0 on success,
+// -1 after printing why the counters are not available
+int startCounters();
+
+// returns 1 if startCounters succeeded
+int isCounting();
+
+// reads the counters of this thread, all 0 if not counting
+void readCounters(CounterValues* values);
+
+#endif //COLORCAST_COUNTERS_H
@@ -0,0 +1,301 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CpuProcess.h"
+#include "Failure.h"
+#include "Thread.h"
+#include "Trace.h"
+
+// number of pixels handed to a thread at a time
+#define PIXELS_PER_TASK 65536
+
+// a range of bytes of pixel data to process, at the same offset in data and the outputs
+typedef struct {
+    unsigned long offset;
+    unsigned long numBytes;
+} PixelRange;
+
+// state shared by the threads processing one array
+typedef struct {
+    PixelArray input;
+    PixelArray output;
+    int height;
+    int width;
+    int rowsPerTask;
+    ChannelType type;
+    double power;
+} ArrayJob;
+
+// state shared by the threads processing one buffer
+typedef struct {
+    PixelRange* ranges;
+    unsigned char* data;
+    const double* powers;
+    unsigned char** outputs;
+    int numPowers;
+    int bytesPerChannel;
+    int isLittle;
+} CpuJob;
+
+// returns the dampened r, g, or b value of a color based on the avg value of
+// the color and a grayness rating from 0 - 1. Same as dampenColor in Process.cu
+int dampenColorCpu(int col, double avg, double grayness, double power) {
+    double diff = fabs(col - avg);
+    // the amount to move towards the avg value of the color
+    double change = diff * pow(grayness, power);
+
+    if (col > avg) {
+        return col - (int)rint(change);
+    }
+
+    return col + (int)rint(change);
+}
+
+// processes the pixel at offset in data once for every power, writing the result
+// of powers[i] to outputs[i]. Same as processPixel in Process.cu
+void processPixelCpu(unsigned char* data, unsigned long offset, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle) {
+    unsigned char* pix = data + offset;
+    int red, green, blue;
+
+    if (bytesPerChannel == 1) {
+        red = pix[0];
+        green = pix[1];
+        blue = pix[2];
+    }
+    else if (isLittle) {
+        red = pix[0] | (pix[1] << 8);
+        green = pix[2] | (pix[3] << 8);
+        blue = pix[4] | (pix[5] << 8);
+    }
+    else {
+        red = (pix[0] << 8) | pix[1];
+        green = (pix[2] << 8) | pix[3];
+        blue = (pix[4] << 8) | pix[5];
+    }
+
+    double grayness = abs(red - green) + abs(red - blue) + abs(blue - green);
+
+    int maxRange = 65536 * 2;
+    if (bytesPerChannel == 1) {
+        maxRange = 255 * 2;
+    }
+
+    // maps grayness from [0, maxRange] to [0, 1] and reverses it so 1 is true gray.
+    // written the same way as mapDouble in Process.cu so the results are identical
+    grayness = 1 - (1.0 / maxRange) * grayness;
+
+    double avg = (double)(red + green + blue) / 3;
+    // the grayness and average are shared by every power, only the dampening differs
+    for (int i = 0; i < numPowers; i++) {
+        int r = dampenColorCpu(red, avg, grayness, powers[i]);
+        int g = dampenColorCpu(green, avg, grayness, powers[i]);
+        int b = dampenColorCpu(blue, avg, grayness, powers[i]);
+        unsigned char* out = outputs[i] + offset;
+
+        if (bytesPerChannel == 1) {
+            out[0] = r;
+            out[1] = g;
+            out[2] = b;
+        }
+        else if (isLittle) {
+            out[0] = r;
+            out[1] = r >> 8;
+            out[2] = g;
+            out[3] = g >> 8;
+            out[4] = b;
+            out[5] = b >> 8;
+        }
+        else {
+            out[0] = r >> 8;
+            out[1] = r;
+            out[2] = g >> 8;
+            out[3] = g;
+            out[4] = b >> 8;
+            out[5] = b;
+        }
+    }
+}
+
+// processes every whole pixel of one range
+void processRange(void* context, int index) {
+    CpuJob* job = context;
+    PixelRange range = job->ranges[index];
+    unsigned long bytesPerPixel = 3 * job->bytesPerChannel;
+
+    unsigned long end = range.offset + range.numBytes;
+
+    TRACE_BEGIN("process range", NULL);
+    for (unsigned long i = range.offset; i + bytesPerPixel <= end; i += bytesPerPixel) {
+        processPixelCpu(job->data, i, job->powers, job->outputs, job->numPowers, job->bytesPerChannel, job->isLittle);
+    }
+    TRACE_END("process range");
+}
+
+// appends the given region split into ranges of PIXELS_PER_TASK pixels, returns the new count
+int addRanges(PixelRange* ranges, int numRanges, unsigned long start, unsigned long numBytes, int bytesPerChannel) {
+    unsigned long bytesPerTask = (unsigned long)PIXELS_PER_TASK * 3 * bytesPerChannel;
+
+    for (unsigned long offset = 0; offset < numBytes; offset += bytesPerTask) {
+        ranges[numRanges].offset = start + offset;
+        ranges[numRanges].numBytes = numBytes - offset < bytesPerTask ? numBytes - offset : bytesPerTask;
+        numRanges++;
+    }
+
+    return numRanges;
+}
+
+// returns how many ranges a region of numBytes is split into
+int countRanges(unsigned long numBytes, int bytesPerChannel) {
+    unsigned long bytesPerTask = (unsigned long)PIXELS_PER_TASK * 3 * bytesPerChannel;
+    return (int)((numBytes + bytesPerTask - 1) / bytesPerTask);
+}
+
+// processes numBytes of contiguous rgb pixel data once for every power
+int cpuProcessBuffer(unsigned char* data, unsigned long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle) {
+    unsigned int offset = 0;
+    unsigned int count = numBytes;
+    return cpuProcessStrips(data, numBytes, 1, &offset, &count, powers, outputs, numPowers, bytesPerChannel, isLittle);
+}
+
+// processes every strip of a file once for every power
+int cpuProcessStrips(unsigned char* data, unsigned long dataLen, unsigned int numStrips, unsigned int* stripOffsets,
+    unsigned int* bytesPerStrip, const double* powers, unsigned char** outputs, int numPowers, int bytesPerChannel,
+    int isLittle) {
+    int numRanges = 0;
+    for (unsigned int i = 0; i < numStrips; i++) {
+        numRanges += countRanges(bytesPerStrip[i], bytesPerChannel);
+    }
+
+    CpuJob job;
+    job.ranges = malloc((numRanges + 1) * sizeof(PixelRange));
+    job.data = data;
+    job.powers = powers;
+    job.outputs = outputs;
+    job.numPowers = numPowers;
+    job.bytesPerChannel = bytesPerChannel;
+    job.isLittle = isLittle;
+    if (job.ranges == NULL) {
+        reportFailure("not enough memory to split the image for the threads");
+        return -1;
+    }
+
+    numRanges = 0;
+    for (unsigned int i = 0; i < numStrips; i++) {
+        // never read past the end of the file even if the strip claims to
+        unsigned long numBytes = bytesPerStrip[i];
+        if (stripOffsets[i] >= dataLen) {
+            continue;
+        }
+        if (stripOffsets[i] + numBytes > dataLen) {
+            numBytes = dataLen - stripOffsets[i];
+        }
+        numRanges = addRanges(job.ranges, numRanges, stripOffsets[i], numBytes, bytesPerChannel);
+    }
+
+    runParallel(processRange, &job, numRanges);
+    free(job.ranges);
+
+    return 0;
+}
+
+// processes one pixel of float channels. The kernel with maxRange 2 for channels
+// from 0 to 1, without rounding the result
+void processFloatPixel(const unsigned char* in, unsigned char* out, ptrdiff_t inStride, ptrdiff_t outStride,
+    double power) {
+    float rgb[3];
+    for (int c = 0; c < 3; c++) {
+        memcpy(&rgb[c], in + c * inStride, sizeof(float));
+    }
+
+    double grayness = fabs(rgb[0] - rgb[1]) + fabs(rgb[0] - rgb[2]) + fabs(rgb[2] - rgb[1]);
+    grayness = 1 - (1.0 / 2) * grayness;
+    // channels outside of 0 to 1 must not take pow below 0
+    if (grayness < 0) {
+        grayness = 0;
+    }
+
+    double avg = ((double)rgb[0] + rgb[1] + rgb[2]) / 3;
+    double dampen = pow(grayness, power);
+    for (int c = 0; c < 3; c++) {
+        float col = (float)(rgb[c] + (avg - rgb[c]) * dampen);
+        memcpy(out + c * outStride, &col, sizeof(float));
+    }
+}
+
+// processes one pixel of 8 or 16 bit channels the same way as processPixelCpu
+void processIntPixel(const unsigned char* in, unsigned char* out, ptrdiff_t inStride, ptrdiff_t outStride,
+    int is16Bit, double power) {
+    int rgb[3];
+    for (int c = 0; c < 3; c++) {
+        if (is16Bit) {
+            unsigned short col;
+            memcpy(&col, in + c * inStride, sizeof(col));
+            rgb[c] = col;
+        }
+        else {
+            rgb[c] = in[c * inStride];
+        }
+    }
+
+    double grayness = abs(rgb[0] - rgb[1]) + abs(rgb[0] - rgb[2]) + abs(rgb[2] - rgb[1]);
+    int maxRange = is16Bit ? 65536 * 2 : 255 * 2;
+    grayness = 1 - (1.0 / maxRange) * grayness;
+
+    double avg = (double)(rgb[0] + rgb[1] + rgb[2]) / 3;
+    for (int c = 0; c < 3; c++) {
+        int col = dampenColorCpu(rgb[c], avg, grayness, power);
+        if (is16Bit) {
+            unsigned short value = (unsigned short)col;
+            memcpy(out + c * outStride, &value, sizeof(value));
+        }
+        else {
+            out[c * outStride] = (unsigned char)col;
+        }
+    }
+}
+
+// processes the rows of one task of an array
+void processArrayRows(void* context, int index) {
+    ArrayJob* job = context;
+    int firstRow = index * job->rowsPerTask;
+    int lastRow = firstRow + job->rowsPerTask < job->height ? firstRow + job->rowsPerTask : job->height;
+
+    for (int y = firstRow; y < lastRow; y++) {
+        const unsigned char* in = job->input.data + y * job->input.rowStride;
+        unsigned char* out = job->output.data + y * job->output.rowStride;
+        for (int x = 0; x < job->width; x++) {
+            if (job->type == CHANNEL_FLOAT32) {
+                processFloatPixel(in, out, job->input.channelStride, job->output.channelStride, job->power);
+            }
+            else {
+                processIntPixel(in, out, job->input.channelStride, job->output.channelStride,
+                    job->type == CHANNEL_UINT16, job->power);
+            }
+            in += job->input.pixelStride;
+            out += job->output.pixelStride;
+        }
+    }
+}
+
+// processes an array of pixels with one power
+int cpuProcessArray(const PixelArray* input, const PixelArray* output, int height, int width, ChannelType type,
+    double power) {
+    if (height <= 0 || width <= 0) {
+        return 0;
+    }
+
+    ArrayJob job;
+    job.input = *input;
+    job.output = *output;
+    job.height = height;
+    job.width = width;
+    job.type = type;
+    job.power = power;
+    // whole rows of roughly PIXELS_PER_TASK pixels are handed out at a time
+    job.rowsPerTask = width >= PIXELS_PER_TASK ? 1 : PIXELS_PER_TASK / width;
+
+    runParallel(processArrayRows, &job, (height + job.rowsPerTask - 1) / job.rowsPerTask);
+    return 0;
+}
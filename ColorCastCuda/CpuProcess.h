@@ -0,0 +1,40 @@
+#ifndef COLORCAST_CPUPROCESS_H
+#define COLORCAST_CPUPROCESS_H
+
+#include <stddef.h>
+
+// the color cast kernel run on the cpu with the same results as the gpu kernel
+// in Process.cu. The work is split over getNumThreads() threads.
+// All of them return 0 on success and -1 on failure.
+
+// processes numBytes of contiguous rgb pixel data once for every power
+int cpuProcessBuffer(unsigned char* data, unsigned long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle);
+
+// processes every strip of a file once for every power
+int cpuProcessStrips(unsigned char* data, unsigned long dataLen, unsigned int numStrips, unsigned int* stripOffsets,
+    unsigned int* bytesPerStrip, const double* powers, unsigned char** outputs, int numPowers, int bytesPerChannel,
+    int isLittle);
+
+// element types of the channels of a pixel array
+typedef enum {
+    CHANNEL_UINT8,
+    CHANNEL_UINT16,     // in the byte order of the machine
+    CHANNEL_FLOAT32     // expected to be from 0 to 1
+} ChannelType;
+
+// height x width rgb pixels anywhere in memory. Strides are in bytes and may be negative
+typedef struct {
+    unsigned char* data;
+    ptrdiff_t rowStride;
+    ptrdiff_t pixelStride;
+    ptrdiff_t channelStride;
+} PixelArray;
+
+// processes an array of pixels with one power, writing the result to output, which
+// is either input itself or does not overlap it. Integer channels get the same
+// results as cpuProcessBuffer
+int cpuProcessArray(const PixelArray* input, const PixelArray* output, int height, int width, ChannelType type,
+    double power);
+
+#endif //COLORCAST_CPUPROCESS_H
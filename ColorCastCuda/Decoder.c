@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "Decoder.h"
+#include "stb_image.h"
+
+#ifdef COLORCAST_USE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+// decodes a jpeg in memory with stb_image. stb_image can not scale while decoding,
+// and decoding the full image to shrink it afterwards is slower than no preview
+unsigned char* stbDecode(unsigned char* data, unsigned long len, int scaleDenom, int* width, int* height) {
+    if (scaleDenom != 1) {
+        printf("ERROR: stb_image can not decode jpegs at a reduced size\n");
+        return NULL;
+    }
+
+    int channels;
+    return stbi_load_from_memory(data, (int)len, width, height, &channels, 3);
+}
+
+const JpegDecoder stbDecoder = { "stb_image", 0, stbDecode };
+
+#ifdef COLORCAST_USE_TURBOJPEG
+// decodes a jpeg in memory with libjpeg-turbo. The image is decompressed
+// straight into the buffer the kernel will work on, no extra copy is made.
+// Reduced sizes come directly from scaling the inverse DCT.
+unsigned char* turboDecode(unsigned char* data, unsigned long len, int scaleDenom, int* width, int* height) {
+    tjhandle handle = tjInitDecompress();
+    if (handle == NULL) {
+        return NULL;
+    }
+
+    int subsamp, colorspace;
+    if (tjDecompressHeader3(handle, data, len, width, height, &subsamp, &colorspace) != 0) {
+        printf("ERROR: %s\n", tjGetErrorStr2(handle));
+        tjDestroy(handle);
+        return NULL;
+    }
+
+    tjscalingfactor factor = { 1, scaleDenom };
+    *width = TJSCALED(*width, factor);
+    *height = TJSCALED(*height, factor);
+
+    // tjDecompress2 picks the scaling factor that matches the requested size
+    unsigned char* pixels = malloc((size_t)*width * *height * 3);
+    if (pixels != NULL && tjDecompress2(handle, data, len, pixels, *width, *width * 3, *height,
+        TJPF_RGB, 0) != 0) {
+        printf("ERROR: %s\n", tjGetErrorStr2(handle));
+        free(pixels);
+        pixels = NULL;
+    }
+
+    tjDestroy(handle);
+    return pixels;
+}
+
+const JpegDecoder turboDecoder = { "libjpeg-turbo", 1, turboDecode };
+#endif
+
+// returns the fastest jpeg decoder that was available at build time
+const JpegDecoder* getJpegDecoder() {
+#ifdef COLORCAST_USE_TURBOJPEG
+    return &turboDecoder;
+#else
+    return &stbDecoder;
+#endif
+}
+
+// returns the stb_image decoder, which is always available
+const JpegDecoder* getStbJpegDecoder() {
+    return &stbDecoder;
+}
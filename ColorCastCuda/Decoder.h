@@ -0,0 +1,23 @@
+#ifndef COLORCAST_DECODER_H
+#define COLORCAST_DECODER_H
+
+// a jpeg decoding backend. The pixels returned by decode are 8 bit rgb,
+// tightly packed and allocated with malloc so they can be handed directly
+// to the kernel and released with free. scaleDenom (1, 2, 4 or 8) reduces
+// the size of the decoded image to 1/scaleDenom of the original, decoders
+// that can not scale only accept 1.
+typedef struct {
+    const char* name;
+    int canScale;       // reduced sizes come straight from a scaled inverse DCT
+    unsigned char* (*decode)(unsigned char* data, unsigned long len, int scaleDenom, int* width, int* height);
+} JpegDecoder;
+
+// returns the fastest jpeg decoder that was available at build time.
+// libjpeg-turbo is used when the program is built with COLORCAST_USE_TURBOJPEG,
+// otherwise stb_image is used.
+const JpegDecoder* getJpegDecoder();
+
+// returns the stb_image decoder, which is always available
+const JpegDecoder* getStbJpegDecoder();
+
+#endif //COLORCAST_DECODER_H
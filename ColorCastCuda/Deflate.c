@@ -0,0 +1,703 @@
+#include <stdlib.h>
+#include <string.h>
+#include "Deflate.h"
+
+#define WINDOW_SIZE 32768
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MAX_STORED 65535
+// number of symbols collected before a block is written out
+#define BLOCK_SYMBOLS 65536
+#define NUM_LIT_CODES 286
+#define NUM_DIST_CODES 30
+#define NUM_CL_CODES 19
+#define ADLER_BASE 65521
+
+// how hard each compression level searches for matches
+typedef struct {
+    int maxChain;       // number of earlier positions compared at most
+    int niceLength;     // stop searching once a match is at least this long
+    int lazy;           // whether to check if the next position has a longer match
+} LevelConfig;
+
+const LevelConfig levelConfigs[10] = {
+    { 0, 0, 0 },        // stored, not used for matching
+    { 4, 16, 0 },
+    { 8, 32, 0 },
+    { 16, 32, 0 },
+    { 16, 64, 1 },
+    { 32, 128, 1 },
+    { 64, 128, 1 },
+    { 128, 258, 1 },
+    { 512, 258, 1 },
+    { 1024, 258, 1 }
+};
+
+const unsigned short lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const unsigned char lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const unsigned short distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const unsigned char distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// order in which code length code lengths are stored in a dynamic block header
+const unsigned char codeLengthOrder[NUM_CL_CODES] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5,
+    11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// writes bits least significant bit first as required by deflate
+typedef struct {
+    Buffer* out;
+    unsigned long long bits;
+    int count;
+} BitWriter;
+
+// a huffman code, the codes are stored bit reversed so they can be written directly
+typedef struct {
+    unsigned char lengths[NUM_LIT_CODES + 2];
+    unsigned short codes[NUM_LIT_CODES + 2];
+} HuffmanCode;
+
+// a literal (dist == 0) or a match of length litLen at distance dist
+typedef struct {
+    unsigned short litLen;
+    unsigned short dist;
+} Symbol;
+
+// state of the compressor for one band
+typedef struct {
+    const unsigned char* in;
+    size_t end;
+    int* head;
+    int* prev;
+    size_t dictStart;
+    size_t hashed;          // every position before this one is in the hash chains
+    Symbol* symbols;
+    int numSymbols;
+    size_t blockStart;      // first input byte covered by the pending symbols
+    BitWriter writer;
+} Compressor;
+
+void putBits(BitWriter* writer, unsigned int value, int numBits) {
+    writer->bits |= (unsigned long long)value << writer->count;
+    writer->count += numBits;
+    while (writer->count >= 8) {
+        appendByte(writer->out, writer->bits & 0xff);
+        writer->bits >>= 8;
+        writer->count -= 8;
+    }
+}
+
+// pads the output with zero bits up to the next byte boundary
+void alignBits(BitWriter* writer) {
+    if (writer->count > 0) {
+        appendByte(writer->out, writer->bits & 0xff);
+        writer->bits = 0;
+        writer->count = 0;
+    }
+}
+
+// returns the index of the highest set bit
+int highestBit(unsigned int value) {
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+
+    return bit;
+}
+
+// returns the length code (0 - 28) for a match length of 3 - 258
+int getLengthCode(int length) {
+    int l = length - MIN_MATCH;
+    if (l < 8) {
+        return l;
+    }
+    if (l == 255) {
+        return 28;
+    }
+
+    int bit = highestBit(l);
+    return 4 * (bit - 1) + ((l >> (bit - 2)) & 3);
+}
+
+// returns the distance code (0 - 29) for a distance of 1 - 32768
+int getDistCode(int dist) {
+    int d = dist - 1;
+    if (d < 4) {
+        return d;
+    }
+
+    int bit = highestBit(d);
+    return 2 * bit + ((d >> (bit - 1)) & 1);
+}
+
+// reverses the lowest numBits bits of code
+unsigned short reverseBits(unsigned int code, int numBits) {
+    unsigned short result = 0;
+    for (int i = 0; i < numBits; i++) {
+        result = (result << 1) | ((code >> i) & 1);
+    }
+
+    return result;
+}
+
+// computes huffman code lengths of at most maxBits for the given frequencies.
+// unused symbols get a length of 0.
+void buildLengths(const unsigned int* freqs, int numSymbols, int maxBits, unsigned char* lengths) {
+    unsigned int weights[NUM_LIT_CODES * 2];
+    int parents[NUM_LIT_CODES * 2];
+    int leaves[NUM_LIT_CODES];
+    int numLeaves = 0;
+
+    memset(lengths, 0, numSymbols);
+    for (int i = 0; i < numSymbols; i++) {
+        if (freqs[i] > 0) {
+            leaves[numLeaves++] = i;
+            weights[i] = freqs[i];
+        }
+    }
+
+    // a code needs at least two symbols, pad with unused ones
+    if (numLeaves == 0) {
+        lengths[0] = 1;
+        lengths[1] = 1;
+        return;
+    }
+    if (numLeaves == 1) {
+        lengths[leaves[0]] = 1;
+        lengths[leaves[0] == 0 ? 1 : 0] = 1;
+        return;
+    }
+
+    while (1) {
+        // sort the leaves by weight
+        for (int i = 1; i < numLeaves; i++) {
+            int leaf = leaves[i];
+            int j = i;
+            for (; j > 0 && weights[leaves[j - 1]] > weights[leaf]; j--) {
+                leaves[j] = leaves[j - 1];
+            }
+            leaves[j] = leaf;
+        }
+
+        // combine the two lightest nodes until one is left. Internal nodes are
+        // numbered from numSymbols on and are created in order of weight, so
+        // the two sorted queues can be merged.
+        int nextLeaf = 0;
+        int nextNode = numSymbols;
+        int numNodes = numSymbols;
+        for (int i = 0; i < numLeaves - 1; i++) {
+            int picked[2];
+            for (int k = 0; k < 2; k++) {
+                if (nextLeaf < numLeaves && (nextNode == numNodes || weights[leaves[nextLeaf]] <= weights[nextNode])) {
+                    picked[k] = leaves[nextLeaf++];
+                }
+                else {
+                    picked[k] = nextNode++;
+                }
+            }
+            weights[numNodes] = weights[picked[0]] + weights[picked[1]];
+            parents[picked[0]] = numNodes;
+            parents[picked[1]] = numNodes;
+            numNodes++;
+        }
+
+        // the root is the last node, walk down to get the depth of every node
+        unsigned char depths[NUM_LIT_CODES * 2];
+        depths[numNodes - 1] = 0;
+        for (int node = numNodes - 2; node >= numSymbols; node--) {
+            depths[node] = depths[parents[node]] + 1;
+        }
+
+        int tooLong = 0;
+        for (int i = 0; i < numLeaves; i++) {
+            int leaf = leaves[i];
+            lengths[leaf] = depths[parents[leaf]] + 1;
+            if (lengths[leaf] > maxBits) {
+                tooLong = 1;
+            }
+        }
+
+        if (!tooLong) {
+            return;
+        }
+        // flatten the frequencies and try again
+        for (int i = 0; i < numLeaves; i++) {
+            weights[leaves[i]] = (weights[leaves[i]] >> 1) + 1;
+        }
+    }
+}
+
+// assigns canonical codes to the given lengths as described in RFC 1951
+void buildCodes(HuffmanCode* code, int numSymbols) {
+    int lengthCounts[16] = { 0 };
+    int nextCode[16];
+
+    for (int i = 0; i < numSymbols; i++) {
+        lengthCounts[code->lengths[i]]++;
+    }
+    lengthCounts[0] = 0;
+
+    int value = 0;
+    for (int bits = 1; bits < 16; bits++) {
+        value = (value + lengthCounts[bits - 1]) << 1;
+        nextCode[bits] = value;
+    }
+
+    for (int i = 0; i < numSymbols; i++) {
+        int length = code->lengths[i];
+        if (length != 0) {
+            code->codes[i] = reverseBits(nextCode[length]++, length);
+        }
+    }
+}
+
+// fills in the fixed huffman codes of deflate
+void buildFixedCodes(HuffmanCode* litCode, HuffmanCode* distCode) {
+    for (int i = 0; i < 288; i++) {
+        if (i < 144) {
+            litCode->lengths[i] = 8;
+        }
+        else if (i < 256) {
+            litCode->lengths[i] = 9;
+        }
+        else if (i < 280) {
+            litCode->lengths[i] = 7;
+        }
+        else {
+            litCode->lengths[i] = 8;
+        }
+    }
+    buildCodes(litCode, 288);
+
+    for (int i = 0; i < NUM_DIST_CODES; i++) {
+        distCode->lengths[i] = 5;
+    }
+    buildCodes(distCode, NUM_DIST_CODES);
+}
+
+// run length encodes the code lengths of a dynamic block. Writes the code length
+// symbols into clSymbols and their extra bit values into clExtra, returns the count.
+int encodeCodeLengths(const unsigned char* lengths, int count, unsigned char* clSymbols, unsigned char* clExtra) {
+    int numCl = 0;
+    int i = 0;
+
+    while (i < count) {
+        int length = lengths[i];
+        int run = 1;
+        while (i + run < count && lengths[i + run] == length) {
+            run++;
+        }
+
+        if (length == 0 && run >= 3) {
+            // runs of zeros: 17 for 3 - 10, 18 for 11 - 138
+            int taken = run > 138 ? 138 : run;
+            if (taken >= 11) {
+                clSymbols[numCl] = 18;
+                clExtra[numCl++] = taken - 11;
+            }
+            else {
+                clSymbols[numCl] = 17;
+                clExtra[numCl++] = taken - 3;
+            }
+            i += taken;
+        }
+        else if (length != 0 && run >= 4) {
+            // write the length once then repeat it 3 - 6 times with 16
+            clSymbols[numCl] = length;
+            clExtra[numCl++] = 0;
+            int repeats = run - 1;
+            while (repeats >= 3) {
+                int taken = repeats > 6 ? 6 : repeats;
+                clSymbols[numCl] = 16;
+                clExtra[numCl++] = taken - 3;
+                repeats -= taken;
+            }
+            i += run - repeats;
+        }
+        else {
+            clSymbols[numCl] = length;
+            clExtra[numCl++] = 0;
+            i++;
+        }
+    }
+
+    return numCl;
+}
+
+// returns the number of bits needed for the symbols using the given codes
+unsigned long long getSymbolCost(const unsigned int* litFreqs, const unsigned int* distFreqs,
+    const HuffmanCode* litCode, const HuffmanCode* distCode) {
+    unsigned long long bits = 0;
+
+    for (int i = 0; i < NUM_LIT_CODES; i++) {
+        bits += (unsigned long long)litFreqs[i] * litCode->lengths[i];
+        if (i > 256) {
+            bits += (unsigned long long)litFreqs[i] * lengthExtra[i - 257];
+        }
+    }
+    for (int i = 0; i < NUM_DIST_CODES; i++) {
+        bits += (unsigned long long)distFreqs[i] * (distCode->lengths[i] + distExtra[i]);
+    }
+
+    return bits;
+}
+
+// writes the pending symbols using the given codes followed by the end of block code
+void writeSymbols(Compressor* comp, const HuffmanCode* litCode, const HuffmanCode* distCode) {
+    BitWriter* writer = &comp->writer;
+
+    for (int i = 0; i < comp->numSymbols; i++) {
+        Symbol symbol = comp->symbols[i];
+        if (symbol.dist == 0) {
+            putBits(writer, litCode->codes[symbol.litLen], litCode->lengths[symbol.litLen]);
+            continue;
+        }
+
+        int lengthCode = getLengthCode(symbol.litLen);
+        putBits(writer, litCode->codes[257 + lengthCode], litCode->lengths[257 + lengthCode]);
+        putBits(writer, symbol.litLen - lengthBase[lengthCode], lengthExtra[lengthCode]);
+
+        int distCodeIndex = getDistCode(symbol.dist);
+        putBits(writer, distCode->codes[distCodeIndex], distCode->lengths[distCodeIndex]);
+        putBits(writer, symbol.dist - distBase[distCodeIndex], distExtra[distCodeIndex]);
+    }
+
+    putBits(writer, litCode->codes[256], litCode->lengths[256]);
+}
+
+// writes in[start, end) as stored blocks
+void writeStored(BitWriter* writer, const unsigned char* in, size_t start, size_t end, int isFinal) {
+    do {
+        size_t len = end - start > MAX_STORED ? MAX_STORED : end - start;
+        int isLastBlock = start + len == end;
+
+        putBits(writer, isFinal && isLastBlock, 1);
+        putBits(writer, 0, 2);
+        alignBits(writer);
+        putBits(writer, len, 16);
+        putBits(writer, ~len & 0xffff, 16);
+        appendBytes(writer->out, in + start, len);
+        start += len;
+    } while (start < end);
+}
+
+// writes the pending symbols as a block using whichever of the fixed codes, a
+// dynamic code or storing the raw bytes is the smallest
+void flushBlock(Compressor* comp, size_t blockEnd, int isFinal) {
+    unsigned int litFreqs[NUM_LIT_CODES] = { 0 };
+    unsigned int distFreqs[NUM_DIST_CODES] = { 0 };
+
+    for (int i = 0; i < comp->numSymbols; i++) {
+        Symbol symbol = comp->symbols[i];
+        if (symbol.dist == 0) {
+            litFreqs[symbol.litLen]++;
+        }
+        else {
+            litFreqs[257 + getLengthCode(symbol.litLen)]++;
+            distFreqs[getDistCode(symbol.dist)]++;
+        }
+    }
+    litFreqs[256] = 1;
+
+    HuffmanCode fixedLit, fixedDist;
+    buildFixedCodes(&fixedLit, &fixedDist);
+
+    HuffmanCode dynLit, dynDist, clCode;
+    memset(&dynLit, 0, sizeof(HuffmanCode));
+    memset(&dynDist, 0, sizeof(HuffmanCode));
+    memset(&clCode, 0, sizeof(HuffmanCode));
+    buildLengths(litFreqs, NUM_LIT_CODES, 15, dynLit.lengths);
+    buildLengths(distFreqs, NUM_DIST_CODES, 15, dynDist.lengths);
+    buildCodes(&dynLit, NUM_LIT_CODES);
+    buildCodes(&dynDist, NUM_DIST_CODES);
+
+    int numLit = NUM_LIT_CODES;
+    while (numLit > 257 && dynLit.lengths[numLit - 1] == 0) {
+        numLit--;
+    }
+    int numDist = NUM_DIST_CODES;
+    while (numDist > 1 && dynDist.lengths[numDist - 1] == 0) {
+        numDist--;
+    }
+
+    // the literal and distance code lengths are encoded as one sequence
+    unsigned char allLengths[NUM_LIT_CODES + NUM_DIST_CODES];
+    memcpy(allLengths, dynLit.lengths, numLit);
+    memcpy(allLengths + numLit, dynDist.lengths, numDist);
+    unsigned char clSymbols[NUM_LIT_CODES + NUM_DIST_CODES];
+    unsigned char clExtra[NUM_LIT_CODES + NUM_DIST_CODES];
+    int numCl = encodeCodeLengths(allLengths, numLit + numDist, clSymbols, clExtra);
+
+    unsigned int clFreqs[NUM_CL_CODES] = { 0 };
+    for (int i = 0; i < numCl; i++) {
+        clFreqs[clSymbols[i]]++;
+    }
+    buildLengths(clFreqs, NUM_CL_CODES, 7, clCode.lengths);
+    buildCodes(&clCode, NUM_CL_CODES);
+
+    int numClLengths = NUM_CL_CODES;
+    while (numClLengths > 4 && clCode.lengths[codeLengthOrder[numClLengths - 1]] == 0) {
+        numClLengths--;
+    }
+
+    unsigned long long dynamicBits = 3 + 5 + 5 + 4 + 3 * numClLengths;
+    for (int i = 0; i < numCl; i++) {
+        int symbol = clSymbols[i];
+        dynamicBits += clCode.lengths[symbol] + (symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0);
+    }
+    dynamicBits += getSymbolCost(litFreqs, distFreqs, &dynLit, &dynDist);
+    unsigned long long fixedBits = 3 + getSymbolCost(litFreqs, distFreqs, &fixedLit, &fixedDist);
+    size_t rawLen = blockEnd - comp->blockStart;
+    unsigned long long storedBits = rawLen * 8 + (rawLen / MAX_STORED + 1) * 40 + 7;
+
+    BitWriter* writer = &comp->writer;
+    if (storedBits <= dynamicBits && storedBits <= fixedBits) {
+        writeStored(writer, comp->in, comp->blockStart, blockEnd, isFinal);
+    }
+    else if (fixedBits <= dynamicBits) {
+        putBits(writer, isFinal, 1);
+        putBits(writer, 1, 2);
+        writeSymbols(comp, &fixedLit, &fixedDist);
+    }
+    else {
+        putBits(writer, isFinal, 1);
+        putBits(writer, 2, 2);
+        putBits(writer, numLit - 257, 5);
+        putBits(writer, numDist - 1, 5);
+        putBits(writer, numClLengths - 4, 4);
+        for (int i = 0; i < numClLengths; i++) {
+            putBits(writer, clCode.lengths[codeLengthOrder[i]], 3);
+        }
+        for (int i = 0; i < numCl; i++) {
+            int symbol = clSymbols[i];
+            putBits(writer, clCode.codes[symbol], clCode.lengths[symbol]);
+            if (symbol == 16) {
+                putBits(writer, clExtra[i], 2);
+            }
+            else if (symbol == 17) {
+                putBits(writer, clExtra[i], 3);
+            }
+            else if (symbol == 18) {
+                putBits(writer, clExtra[i], 7);
+            }
+        }
+        writeSymbols(comp, &dynLit, &dynDist);
+    }
+
+    comp->numSymbols = 0;
+    comp->blockStart = blockEnd;
+}
+
+// returns the hash of the three bytes starting at pos
+unsigned int hashAt(const unsigned char* in, size_t pos) {
+    unsigned int value = in[pos] | (in[pos + 1] << 8) | (in[pos + 2] << 16);
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// adds every position before pos to the hash chains
+void insertUpTo(Compressor* comp, size_t pos) {
+    // positions too close to the end can not start a match
+    size_t limit = comp->end >= MIN_MATCH ? comp->end - MIN_MATCH + 1 : 0;
+    if (pos > limit) {
+        pos = limit;
+    }
+
+    for (; comp->hashed < pos; comp->hashed++) {
+        unsigned int hash = hashAt(comp->in, comp->hashed);
+        int rel = (int)(comp->hashed - comp->dictStart);
+        comp->prev[rel & WINDOW_MASK] = comp->head[hash];
+        comp->head[hash] = rel;
+    }
+}
+
+// finds the longest earlier match for the bytes starting at pos. Returns the length
+// (0 if there is none) and sets dist.
+int findMatch(Compressor* comp, size_t pos, const LevelConfig* config, int* dist) {
+    if (pos + MIN_MATCH > comp->end) {
+        return 0;
+    }
+
+    const unsigned char* in = comp->in;
+    int maxLength = comp->end - pos > MAX_MATCH ? MAX_MATCH : (int)(comp->end - pos);
+    int rel = (int)(pos - comp->dictStart);
+    int candidate = comp->head[hashAt(in, pos)];
+    int bestLength = 0;
+
+    for (int chain = 0; chain < config->maxChain && candidate >= 0 && rel - candidate <= WINDOW_SIZE; chain++) {
+        const unsigned char* a = in + comp->dictStart + candidate;
+        const unsigned char* b = in + pos;
+
+        if (a[bestLength] == b[bestLength] && a[0] == b[0]) {
+            int length = 0;
+            while (length < maxLength && a[length] == b[length]) {
+                length++;
+            }
+
+            if (length > bestLength) {
+                bestLength = length;
+                *dist = rel - candidate;
+                if (length >= config->niceLength || length == maxLength) {
+                    break;
+                }
+            }
+        }
+
+        int next = comp->prev[candidate & WINDOW_MASK];
+        // the slot was reused by a newer position, the chain ends here
+        if (next >= candidate) {
+            break;
+        }
+        candidate = next;
+    }
+
+    return bestLength >= MIN_MATCH ? bestLength : 0;
+}
+
+// adds a symbol, writing out a block when enough symbols have been collected
+void addSymbol(Compressor* comp, int litLen, int dist, size_t nextPos) {
+    comp->symbols[comp->numSymbols].litLen = litLen;
+    comp->symbols[comp->numSymbols].dist = dist;
+    comp->numSymbols++;
+
+    if (comp->numSymbols == BLOCK_SYMBOLS) {
+        flushBlock(comp, nextPos, 0);
+    }
+}
+
+// compresses in[start, end) into raw deflate blocks appended to out
+void deflateBand(const unsigned char* in, size_t start, size_t end, int level, int isLast, Buffer* out) {
+    Compressor comp;
+    comp.writer.out = out;
+    comp.writer.bits = 0;
+    comp.writer.count = 0;
+
+    if (level < 0) {
+        level = 0;
+    }
+    if (level > 9) {
+        level = 9;
+    }
+
+    if (level == 0 || start == end) {
+        if (start == end) {
+            // an empty fixed block, just the end of block code
+            putBits(&comp.writer, isLast, 1);
+            putBits(&comp.writer, 1, 2);
+            putBits(&comp.writer, 0, 7);
+        }
+        else {
+            writeStored(&comp.writer, in, start, end, isLast);
+        }
+    }
+    else {
+        const LevelConfig* config = &levelConfigs[level];
+        comp.in = in;
+        comp.end = end;
+        comp.dictStart = start > WINDOW_SIZE ? start - WINDOW_SIZE : 0;
+        comp.hashed = comp.dictStart;
+        comp.head = malloc(HASH_SIZE * sizeof(int));
+        comp.prev = malloc(WINDOW_SIZE * sizeof(int));
+        comp.symbols = malloc(BLOCK_SYMBOLS * sizeof(Symbol));
+        comp.numSymbols = 0;
+        comp.blockStart = start;
+        for (int i = 0; i < HASH_SIZE; i++) {
+            comp.head[i] = -1;
+        }
+
+        size_t pos = start;
+        while (pos < end) {
+            int dist = 0;
+            insertUpTo(&comp, pos);
+            int length = findMatch(&comp, pos, config, &dist);
+
+            // if the next position has a longer match emit a literal instead
+            if (length > 0 && config->lazy && length < config->niceLength) {
+                int nextDist = 0;
+                insertUpTo(&comp, pos + 1);
+                int nextLength = findMatch(&comp, pos + 1, config, &nextDist);
+                if (nextLength > length) {
+                    addSymbol(&comp, in[pos], 0, pos + 1);
+                    pos++;
+                    length = nextLength;
+                    dist = nextDist;
+                }
+            }
+
+            if (length > 0) {
+                addSymbol(&comp, length, dist, pos + length);
+                pos += length;
+            }
+            else {
+                addSymbol(&comp, in[pos], 0, pos + 1);
+                pos++;
+            }
+        }
+
+        if (comp.numSymbols > 0 || isLast) {
+            flushBlock(&comp, end, isLast);
+        }
+
+        free(comp.head);
+        free(comp.prev);
+        free(comp.symbols);
+    }
+
+    if (!isLast) {
+        // sync flush, an empty stored block leaves the stream byte aligned
+        putBits(&comp.writer, 0, 3);
+        alignBits(&comp.writer);
+        putBits(&comp.writer, 0x0000, 16);
+        putBits(&comp.writer, 0xffff, 16);
+    }
+    alignBits(&comp.writer);
+}
+
+// updates the adler-32 checksum with the given bytes, start with an adler of 1
+unsigned int adler32(unsigned int adler, const unsigned char* data, size_t len) {
+    unsigned int a = adler & 0xffff;
+    unsigned int b = adler >> 16;
+
+    while (len > 0) {
+        // 5552 is the most bytes that can be summed before b overflows
+        size_t chunk = len > 5552 ? 5552 : len;
+        len -= chunk;
+        while (chunk--) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+
+    return a | (b << 16);
+}
+
+// returns the adler-32 checksum of two concatenated blocks of data given the
+// checksum of each block and the length of the second one. Adapted from zlib.
+unsigned int adler32Combine(unsigned int adler1, unsigned int adler2, size_t len2) {
+    unsigned long long rem = len2 % ADLER_BASE;
+    unsigned long long sum1 = adler1 & 0xffff;
+    unsigned long long sum2 = (rem * sum1) % ADLER_BASE;
+
+    sum1 += (adler2 & 0xffff) + ADLER_BASE - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+    if (sum1 >= ADLER_BASE) {
+        sum1 -= ADLER_BASE;
+    }
+    if (sum1 >= ADLER_BASE) {
+        sum1 -= ADLER_BASE;
+    }
+    if (sum2 >= 2 * ADLER_BASE) {
+        sum2 -= 2 * ADLER_BASE;
+    }
+    if (sum2 >= ADLER_BASE) {
+        sum2 -= ADLER_BASE;
+    }
+
+    return (unsigned int)(sum1 | (sum2 << 16));
+}
@@ -0,0 +1,23 @@
+#ifndef COLORCAST_DEFLATE_H
+#define COLORCAST_DEFLATE_H
+
+#include <stddef.h>
+#include "Buffer.h"
+
+// compresses in[start, end) into raw deflate blocks (RFC 1951) appended to out.
+// level 0 stores the data, 1 is the fastest and 9 the smallest compression.
+// The bytes of in before start (up to 32 KB) are used as a dictionary, so bands of
+// one stream that are compressed on different threads can still reference the data
+// in front of them. If isLast is not set the output ends with a sync flush (an empty
+// stored block) leaving it byte aligned, so the outputs of consecutive bands can be
+// concatenated into one stream.
+void deflateBand(const unsigned char* in, size_t start, size_t end, int level, int isLast, Buffer* out);
+
+// updates the adler-32 checksum with the given bytes, start with an adler of 1
+unsigned int adler32(unsigned int adler, const unsigned char* data, size_t len);
+
+// returns the adler-32 checksum of two concatenated blocks of data given the
+// checksum of each block and the length of the second one
+unsigned int adler32Combine(unsigned int adler1, unsigned int adler2, size_t len2);
+
+#endif //COLORCAST_DEFLATE_H
@@ -0,0 +1,41 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "Failure.h"
+#include "Thread.h"
+
+// the last reason reported on each thread, empty once taken
+static THREAD_LOCAL char lastFailure[MAX_FAILURE_LENGTH];
+
+// prints the reason and keeps it for takeFailure
+void reportFailure(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(lastFailure, sizeof(lastFailure), format, args);
+    va_end(args);
+
+#ifndef COLORCAST_BUILD_LIBRARY
+    printf("ERROR: %s\n", lastFailure);
+#endif
+}
+
+// returns the last reason reported on this thread without forgetting it
+const char* getFailure() {
+    return lastFailure;
+}
+
+// copies the last reason reported on this thread into reason and forgets it
+int takeFailure(char* reason, size_t size) {
+    if (lastFailure[0] == '\0') {
+        return -1;
+    }
+
+    snprintf(reason, size, "%s", lastFailure);
+    lastFailure[0] = '\0';
+    return 0;
+}
+
+// forgets the last reason reported on this thread
+void clearFailure() {
+    lastFailure[0] = '\0';
+}
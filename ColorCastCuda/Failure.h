@@ -0,0 +1,25 @@
+#ifndef COLORCAST_FAILURE_H
+#define COLORCAST_FAILURE_H
+
+#include <stddef.h>
+
+// longest reason kept, longer ones are cut off
+#define MAX_FAILURE_LENGTH 256
+
+// prints why the image the current thread works on can not be converted and keeps
+// the reason until takeFailure, so it can be reported along with the image. Built into
+// libcolorcast it only keeps the reason, the host program decides what to show
+void reportFailure(const char* format, ...);
+
+// returns the last reason reported on this thread without forgetting it, empty if
+// there is none. It stays valid until the next failure on this thread
+const char* getFailure();
+
+// copies the last reason reported on this thread into reason, which has room for
+// size bytes, and forgets it. returns 0 if there was one and -1 if not
+int takeFailure(char* reason, size_t size);
+
+// forgets the last reason reported on this thread
+void clearFailure();
+
+#endif //COLORCAST_FAILURE_H
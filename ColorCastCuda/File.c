@@ -1,8 +1,21 @@
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <direct.h>
+#include <sys/stat.h>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
 #include "File.h"
+#include "Platform.h"
+#include "Thread.h"
 #include "tinyfiledialogs.h"
 
 // given a title and a message, sends a
@@ -102,105 +115,408 @@ int isExtension(char* filePath, const char* extension) {
     return 1;
 }
 
-// function adapted from: https://stackoverflow.com/questions/2314542/listing-directory-contents-using-c-and-windows
-// returns the number of tif files in a given directory
-int getNumImgInDir(const char* inputPath) {
-    WIN32_FIND_DATA fdFile;
+// returns 1 if the file is a tif, jpg or png
+int isSupportedImage(char* filePath) {
+    return isExtension(filePath, "tif") || isExtension(filePath, "tiff") || isExtension(filePath, "jpg") || isExtension(filePath, "png");
+}
+
+// creates an empty path list
+void initPathList(PathList* list) {
+    list->paths = NULL;
+    list->count = 0;
+    list->cap = 0;
+}
+
+// adds a copy of path to the end of the list, doubling its capacity when full
+void addPath(PathList* list, const char* path) {
+    if (list->count == list->cap) {
+        list->cap = list->cap == 0 ? 64 : list->cap * 2;
+        list->paths = realloc(list->paths, list->cap * sizeof(char*));
+    }
+
+    list->paths[list->count++] = _strdup(path);
+}
+
+// frees every path and the list itself
+void freePathList(PathList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+
+    free(list->paths);
+    initPathList(list);
+}
+
+// state shared by the walker threads of one findImages call
+typedef struct {
+    PathList pending;       // directories found but not read yet
+    PathList* images;
+    int numBusy;            // walkers currently reading a directory
+    int recursive;
+    Mutex lock;
+    Condition changed;      // signaled when pending grows or a walker becomes idle
+} Walk;
+
+#ifdef _WIN32
+// reads one directory, adding its images to images and, when recursive, its
+// subdirectories to subdirs. returns 0 on success, -1 if it can not be read
+int readDirectory(const char* dirPath, PathList* images, PathList* subdirs, int recursive) {
+    WIN32_FIND_DATAA fdFile;
     HANDLE hFind = NULL;
 
     char sPath[2048];
 
     //Specify a file mask. *.* = We want everything!
-    sprintf(sPath, "%s\\*.*", inputPath);
+    sprintf(sPath, "%s\\*.*", dirPath);
 
     if ((hFind = FindFirstFileA(sPath, &fdFile)) == INVALID_HANDLE_VALUE) {
-        printf("Path not found: [%s]\n", inputPath);
-        return 0;
+        return -1;
     }
 
-    int numImgs = 0;
-
     do {
         //Find first file will always return "."
         //    and ".." as the first two directories.
         if (strcmp(fdFile.cFileName, ".") != 0
             && strcmp(fdFile.cFileName, "..") != 0) {
             //Build up our file path using the passed in
-            //  [inputPath] and the file/foldername we just found:
-            sprintf(sPath, "%s\\%ls", inputPath, fdFile.cFileName);
-            //sprintf(filePath, "%s\\%s", inputPath, fdFile.cFileName);
+            //  [dirPath] and the file/foldername we just found:
+            sprintf(sPath, "%s\\%s", dirPath, fdFile.cFileName);
 
-            //Is the entity a File or Folder?
+            //Is the entity a File or Folder? Links to folders are not followed
             if (fdFile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-            }
-            else {
-                // if path is tif, jpg, or png add to numImgs
-                if (isExtension(sPath, "tif") || isExtension(sPath, "tiff") || isExtension(sPath, "jpg") || isExtension(sPath, "png")) {
-                    numImgs++;
+                if (recursive && !(fdFile.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                    addPath(subdirs, sPath);
                 }
             }
+            else if (isSupportedImage(sPath)) {
+                addPath(images, sPath);
+            }
         }
-    } while (FindNextFile(hFind, &fdFile));
+    } while (FindNextFileA(hFind, &fdFile));
 
     FindClose(hFind);
 
-    return numImgs;
+    return 0;
 }
+#else
+#ifdef __linux__
+// a record filled in by getdents64, glibc does not declare it
+struct linux_dirent64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+// adds one directory entry to images or subdirs. The type of the entry comes from
+// d_type so only file systems that do not fill it in cost a stat
+void addEntry(int dirFd, const char* dirPath, const char* name, unsigned char type,
+    PathList* images, PathList* subdirs, int recursive) {
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        return;
+    }
 
-// function adapted from: https://stackoverflow.com/questions/2314542/listing-directory-contents-using-c-and-windows
-// sets imgPaths to contain the paths to all of the tif, jpg, and png files in the input directory
-void setImagePaths(char** imgPaths, const char* inputPath) {
-    WIN32_FIND_DATA fdFile;
-    HANDLE hFind = NULL;
+    // links are resolved so linked images are found, links to directories are not followed
+    int isLink = type == DT_LNK;
+    if (type == DT_UNKNOWN || type == DT_LNK) {
+        struct stat info;
+        if (fstatat(dirFd, name, &info, 0) != 0) {
+            return;
+        }
+        type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+    }
 
-    char sPath[2048] ;
+    char sPath[2048];
+    snprintf(sPath, sizeof(sPath), "%s/%s", dirPath, name);
+    if (type == DT_DIR) {
+        if (recursive && !isLink) {
+            addPath(subdirs, sPath);
+        }
+    }
+    else if (type == DT_REG && isSupportedImage(sPath)) {
+        addPath(images, sPath);
+    }
+}
 
-    //Specify a file mask. *.* = We want everything!
-    sprintf(sPath, "%s\\*.*", inputPath);
+// reads one directory, adding its images to images and, when recursive, its
+// subdirectories to subdirs. returns 0 on success, -1 if it can not be read
+int readDirectory(const char* dirPath, PathList* images, PathList* subdirs, int recursive) {
+    int dirFd = openat(AT_FDCWD, dirPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return -1;
+    }
 
-    if ((hFind = FindFirstFileA(sPath, &fdFile)) == INVALID_HANDLE_VALUE) {
+#ifdef __linux__
+    // getdents64 returns many entries per call, which matters on network file systems
+    long long buf[4096];
+    long numRead;
+    while ((numRead = syscall(SYS_getdents64, dirFd, buf, sizeof(buf))) > 0) {
+        for (long pos = 0; pos < numRead;) {
+            struct linux_dirent64* entry = (struct linux_dirent64*)((char*)buf + pos);
+            addEntry(dirFd, dirPath, entry->d_name, entry->d_type, images, subdirs, recursive);
+            pos += entry->d_reclen;
+        }
+    }
+
+    close(dirFd);
+    if (numRead < 0) {
+        return -1;
+    }
+#else
+    DIR* dir = fdopendir(dirFd);
+    if (dir == NULL) {
+        close(dirFd);
+        return -1;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        addEntry(dirFd, dirPath, entry->d_name, entry->d_type, images, subdirs, recursive);
+    }
+
+    closedir(dir);
+#endif
+
+    return 0;
+}
+#endif
+
+// takes directories off the pending list until every directory has been read.
+// Results are gathered per directory so the lock is taken once per directory
+void walkDirectories(void* context, int index) {
+    (void)index;
+    Walk* walk = (Walk*)context;
+    PathList images;
+    PathList subdirs;
+    initPathList(&images);
+    initPathList(&subdirs);
+
+    lockMutex(&walk->lock);
+    while (1) {
+        // a walker that is still reading may find more directories
+        while (walk->pending.count == 0 && walk->numBusy > 0) {
+            waitCondition(&walk->changed, &walk->lock);
+        }
+        if (walk->pending.count == 0) {
+            break;
+        }
+
+        char* dirPath = walk->pending.paths[--walk->pending.count];
+        walk->numBusy++;
+        unlockMutex(&walk->lock);
+
+        if (readDirectory(dirPath, &images, &subdirs, walk->recursive) != 0) {
+            printf("Path not found: [%s]\n", dirPath);
+        }
+        free(dirPath);
+
+        lockMutex(&walk->lock);
+        for (int i = 0; i < images.count; i++) {
+            addPath(walk->images, images.paths[i]);
+        }
+        for (int i = 0; i < subdirs.count; i++) {
+            addPath(&walk->pending, subdirs.paths[i]);
+        }
+        walk->numBusy--;
+        // wake walkers waiting for directories, or all of them once the walk is done
+        broadcastCondition(&walk->changed);
+
+        freePathList(&images);
+        freePathList(&subdirs);
+    }
+    unlockMutex(&walk->lock);
+}
+
+// orders paths by name
+int comparePaths(const void* a, const void* b) {
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+// adds the paths of all of the tif, jpg, and png files in the input directory to
+// images, sorted by name. When recursive, subdirectories are searched as well using
+// getNumThreads() walkers. returns 0 on success, -1 if the directory can not be read
+int findImages(const char* inputPath, int recursive, PathList* images) {
+    Walk walk;
+    initPathList(&walk.pending);
+    walk.images = images;
+    walk.numBusy = 0;
+    walk.recursive = recursive;
+    initMutex(&walk.lock);
+    initCondition(&walk.changed);
+
+    int firstImage = images->count;
+    // the input directory is read first so a missing directory is reported as a failure
+    int result = readDirectory(inputPath, images, &walk.pending, recursive);
+    if (result != 0) {
         printf("Path not found: [%s]\n", inputPath);
-        return;
+    }
+    else if (walk.pending.count > 0) {
+        runParallel(walkDirectories, &walk, getNumThreads());
     }
 
-    int imgIndex = 0;
+    // walkers finish in any order, sorting keeps the order of the output the same between runs
+    qsort(images->paths + firstImage, images->count - firstImage, sizeof(char*), comparePaths);
 
-    do {
-        //Find first file will always return "."
-        //    and ".." as the first two directories.
-        if (strcmp(fdFile.cFileName, ".") != 0
-            && strcmp(fdFile.cFileName, "..") != 0) {
-            //Build up our file path using the passed in
-            //  [inputPath] and the file/foldername we just found:
-            sprintf(sPath, "%s\\%ls", inputPath, fdFile.cFileName);
+    freePathList(&walk.pending);
+    destroyCondition(&walk.changed);
+    destroyMutex(&walk.lock);
 
-            //Is the entity a File or Folder?
-            if (fdFile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-            }
-            else {
-                // if path is tif, png, or jpg add to
-                if (isExtension(sPath, "tif") || isExtension(sPath, "tiff") || isExtension(sPath, "jpg") || isExtension(sPath, "png")) {
-                    imgPaths[imgIndex] = _strdup(sPath);
-                    imgIndex++;
-                }
-            }
+    return result;
+}
+
+// returns the part of the path after the last directory separator
+const char* getFileName(const char* path) {
+    const char* name = path;
+    for (const char* c = path; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
         }
-    } while (FindNextFile(hFind, &fdFile));
+    }
 
-    FindClose(hFind);
+    return name;
+}
+
+// returns 1 if c separates the directories of a path
+int isSeparator(char c) {
+    return c == '/' || c == '\\';
 }
 
 // given the input file and output directory, returns a string of the
 // output file which will be in the output directory but have the
-// input file name with the power as a prefix.
-char* getOutputFilePath(char* inputFile, char* outputDir, double power) {
-    char filename[400];
-    char extension[10];
-    _splitpath(_strdup(inputFile), NULL, NULL, filename, extension);
+// input file name with the power as a prefix. An input file below
+// inputDir keeps its subdirectory under the output directory, so images
+// with the same name in different subdirectories do not overwrite each other
+char* getOutputFilePath(char* inputFile, const char* inputDir, char* outputDir, double power) {
+    const char* filename = getFileName(inputFile);
+    // the extension keeps its dot, a name without one has no extension
+    const char* extension = strrchr(filename, '.');
+    if (extension == NULL) {
+        extension = filename + strlen(filename);
+    }
+
+    // the directories between inputDir and the file name, without separators at either end
+    const char* subdir = filename;
+    size_t dirLen = inputDir != NULL ? strlen(inputDir) : 0;
+    if (dirLen > 0 && strncmp(inputFile, inputDir, dirLen) == 0
+        && (isSeparator(inputFile[dirLen]) || isSeparator(inputDir[dirLen - 1]))) {
+        subdir = inputFile + dirLen;
+        while (isSeparator(*subdir)) {
+            subdir++;
+        }
+    }
+    int subdirLen = (int)(filename - subdir);
+    while (subdirLen > 0 && isSeparator(subdir[subdirLen - 1])) {
+        subdirLen--;
+    }
 
     char res[2048];
-    sprintf(res, "%s\\%s.CC-%04.1f.%s", outputDir, filename, power, extension);
+    if (subdirLen > 0) {
+        snprintf(res, sizeof(res), "%s" PATH_SEPARATOR "%.*s" PATH_SEPARATOR "%.*s.CC-%04.1f%s", outputDir, subdirLen,
+            subdir, (int)(extension - filename), filename, power, extension);
+    }
+    else {
+        snprintf(res, sizeof(res), "%s" PATH_SEPARATOR "%.*s.CC-%04.1f%s", outputDir, (int)(extension - filename),
+            filename, power, extension);
+    }
 
     return _strdup(res);
 }
 
+// returns 1 if the file name ends in the power suffix getOutputFilePath adds, such as
+// image.CC-02.5.png
+int isOutputFile(const char* path) {
+    const char* filename = getFileName(path);
+    const char* extension = strrchr(filename, '.');
+    if (extension == NULL) {
+        extension = filename + strlen(filename);
+    }
+
+    const char* suffix = NULL;
+    for (const char* c = strstr(filename, ".CC-"); c != NULL && c < extension; c = strstr(c + 1, ".CC-")) {
+        suffix = c;
+    }
+    if (suffix == NULL || suffix + 4 == extension) {
+        return 0;
+    }
+
+    const char* c = suffix + 4;
+    while (c < extension && (isdigit((unsigned char)*c) || *c == '.')) {
+        c++;
+    }
+    return c == extension;
+}
+
+// creates every directory on the way to the file at path that does not exist yet.
+// returns 0 on success, -1 if one can not be created
+int makeParentDirectories(const char* path) {
+    char* dir = _strdup(path);
+    int result = 0;
+    // the first character is skipped so an absolute path does not try to create the root
+    for (char* c = dir + 1; *c != '\0' && result == 0; c++) {
+        if (!isSeparator(*c) || isSeparator(c[-1]) || c[-1] == ':') {
+            continue;
+        }
+
+        *c = '\0';
+        struct stat info;
+        if (stat(dir, &info) != 0 && _mkdir(dir) != 0) {
+            printf("ERROR: could not create directory %s\n", dir);
+            result = -1;
+        }
+        *c = path[c - dir];
+    }
+
+    free(dir);
+    return result;
+}
+
+// returns the absolute path of an existing file or directory with symbolic links
+// resolved, or NULL if it does not exist
+char* getAbsolutePath(const char* path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        return NULL;
+    }
+    return _fullpath(NULL, path, 0);
+#else
+    return realpath(path, NULL);
+#endif
+}
+
+// parses a byte size such as "4096", "256K" or "8G".
+// returns 0 if the string is not a valid size
+unsigned long long parseByteSize(const char* str) {
+    char* end;
+    double size = strtod(str, &end);
+    if (end == str || size <= 0) {
+        return 0;
+    }
+
+    switch (toupper((unsigned char)*end)) {
+    case 'K':
+        size *= 1024;
+        end++;
+        break;
+    case 'M':
+        size *= 1024 * 1024;
+        end++;
+        break;
+    case 'G':
+        size *= 1024 * 1024 * 1024;
+        end++;
+        break;
+    }
+    // allow a trailing B as in "256KB"
+    if (toupper((unsigned char)*end) == 'B') {
+        end++;
+    }
+    // anything else is invalid
+    if (*end != '\0' || size >= 18446744073709551616.0) {
+        return 0;
+    }
+
+    return (unsigned long long)size;
+}
@@ -15,17 +15,51 @@ double getPower();
 
 int isExtension(char* filePath, const char* extension);
 
-// returns the number of tif files in a given directory
-int getNumImgInDir(const char* inputPath);
+// returns 1 if the file is a tif, jpg or png
+int isSupportedImage(char* filePath);
 
-// sets imgPaths to contain the paths to all of the supported
-// images in the directory
-void setImagePaths(char** imgPaths, const char* inputPath);
+// a growable list of paths
+typedef struct {
+    char** paths;
+    int count;
+    int cap;
+} PathList;
+
+void initPathList(PathList* list);
+
+// adds a copy of path to the end of the list
+void addPath(PathList* list, const char* path);
+
+void freePathList(PathList* list);
+
+// adds the paths of all of the tif, jpg, and png files in the input directory to
+// images, sorted by name. When recursive, subdirectories are searched as well.
+// returns 0 on success, -1 if the directory can not be read
+int findImages(const char* inputPath, int recursive, PathList* images);
+
+// returns the part of the path after the last directory separator
+const char* getFileName(const char* path);
 
 // given the input file and output directory, returns a string of the
 // output file which will be in the output directory but have the
-// input file name with the power as a prefix.
-char* getOutputFilePath(char* inputFile, char* outputDir, double power);
+// input file name with the power as a prefix. An input file below
+// inputDir, which may be NULL, keeps its subdirectory under outputDir.
+char* getOutputFilePath(char* inputFile, const char* inputDir, char* outputDir, double power);
+
+// returns 1 if the file name ends in the power suffix getOutputFilePath adds
+int isOutputFile(const char* path);
+
+// creates every directory on the way to the file at path that does not exist yet.
+// returns 0 on success, -1 if one can not be created
+int makeParentDirectories(const char* path);
+
+// returns the absolute path of an existing file or directory with symbolic links
+// resolved, or NULL if it does not exist. The path is freed by the caller
+char* getAbsolutePath(const char* path);
+
+// parses a byte size such as "4096", "256K" or "8G".
+// returns 0 if the string is not a valid size
+unsigned long long parseByteSize(const char* str);
 
 
 #endif //COLORCAST_FILE_H
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "Backend.h"
+#include "Clock.h"
+#include "Failure.h"
+#include "File.h"
+#include "Handle.h"
+#include "Stage.h"
+
+extern const int NUM_CHANNELS;
+
+// returns the length of the given file in bytes
+// -1 if cannot get length
+unsigned int getFileSize(char* filename) {
+    struct stat discriptor;
+
+    if (stat(filename, &discriptor) == 0) {
+        return discriptor.st_size;
+    }
+
+    return -1;
+}
+
+// frees all data related to the tif
+void freeTiff(Tiff* tiff) {
+    free(tiff->data);
+    free(tiff->entries);
+    free(tiff->stripOffsets);
+    free(tiff->bytesPerStrip);
+    free(tiff);
+}
+
+// estimates the most memory in bytes the job holds between loading and writing
+// from the file size and header of the image. returns 0 if the file can not be read
+unsigned long long estimateJobMemory(char* imagePath, unsigned int stripSize, int numPowers) {
+    unsigned int fileLen = getFileSize(imagePath);
+    if (fileLen == (unsigned int)-1) {
+        return 0;
+    }
+
+    if (isExtension(imagePath, "jpg") || isExtension(imagePath, "png")) {
+        int width, height, bitsPerSample;
+        if (getImageInfo(imagePath, &width, &height, &bitsPerSample) != 0) {
+            return fileLen;
+        }
+        // the file is read while the pixels are decoded, there are pixels for every
+        // power, and encoding one of them adds a filtered copy and the compressed output
+        unsigned long long pixelBytes = (unsigned long long)width * height * NUM_CHANNELS * (bitsPerSample / 8);
+        return fileLen + (numPowers + 2) * pixelBytes;
+    }
+
+    // tiffs are processed in a copy of the whole file per power, whatever the strip
+    // layout. Restriping builds the new file next to the old one
+    return (unsigned long long)fileLen * (stripSize == 0 ? numPowers : numPowers + 1);
+}
+
+// determines if a tiff is valid and reads it into the job
+int loadTiff(Job* job, unsigned int stripSize) {
+    unsigned int fileLen = getFileSize(job->imagePath);
+    if (fileLen == (unsigned int)-1) {
+        reportFailure("could not find file");
+        return -1;
+    }
+
+    Tiff* tiff = openTiff(job->imagePath, fileLen);
+    if (tiff == NULL) {
+        return -1;
+    }
+
+    // isValidTiff will print the reason why the tiff is not valid
+    if (!isValidTiff(tiff)) {
+        freeTiff(tiff);
+        return -1;
+    }
+
+    // rewriting the strips is what a tiff has instead of decoding
+    if (stripSize != 0) {
+        CounterValues startCounts;
+        readCounters(&startCounts);
+        double start = getMonotonicTime();
+        int result = restripeTiff(tiff, stripSize);
+        addStageTime(STAGE_DECODE, getMonotonicTime() - start, tiff->dataLen,
+            (unsigned long long)getWidth(tiff) * getHeight(tiff));
+        addStageCounters(STAGE_DECODE, &startCounts);
+        if (result != 0) {
+            freeTiff(tiff);
+            return -1;
+        }
+    }
+
+    job->tiff = tiff;
+    return 0;
+}
+
+// returns the number of pixels of the loaded image
+unsigned long long getJobPixels(Job* job) {
+    if (job->image != NULL) {
+        return (unsigned long long)job->image->width * job->image->height;
+    }
+    if (job->tiff != NULL) {
+        return (unsigned long long)getWidth(job->tiff) * getHeight(job->tiff);
+    }
+
+    return 0;
+}
+
+// reads the image into memory. Tiffs are checked to be supported and, if
+// stripSize is not 0, rewritten into strips of roughly stripSize bytes
+int loadJob(Job* job, unsigned int stripSize) {
+    job->tiff = NULL;
+    job->image = NULL;
+    job->outputs = NULL;
+
+    if (isExtension(job->imagePath, "jpg") || isExtension(job->imagePath, "png")) {
+        job->image = getImage(job->imagePath);
+        return job->image == NULL ? -1 : 0;
+    }
+
+    return loadTiff(job, stripSize);
+}
+
+// processes any image that is not a tiff
+int processImage(Image* img, const double* powers, unsigned char** outputs, int numPowers) {
+    unsigned long numPix = (unsigned long)img->width * img->height;
+    // 16 bit pngs are loaded in the byte order of the machine
+    int bytesPerChannel = img->bitsPerSample / 8;
+    unsigned long numBytes = numPix * NUM_CHANNELS * bytesPerChannel;
+
+    for (int i = 1; i < numPowers; i++) {
+        outputs[i] = malloc(numBytes);
+        if (outputs[i] == NULL) {
+            reportFailure("not enough memory for the output of every power");
+            return -1;
+        }
+    }
+
+    return processBuffer(img->pix, numBytes, powers, outputs, numPowers, bytesPerChannel, isHostLittleEndian());
+}
+
+// processes a single strip tiff. Only the pixel data of the strip is processed
+int processSingleStrip(Tiff* tiff, const double* powers, unsigned char** outputs, int numPowers) {
+    unsigned long pixelStartOffset = tiff->stripOffsets[0];
+    unsigned int numBytes = tiff->bytesPerStrip[0];
+    int bytesPerChannel = tiff->bitsPerSample / 8;
+
+    // the pixels start at the same offset in every copy of the file
+    unsigned char* pixelOutputs[MAX_POWERS];
+    for (int i = 0; i < numPowers; i++) {
+        pixelOutputs[i] = outputs[i] + pixelStartOffset;
+    }
+
+    return processBuffer(tiff->data + pixelStartOffset, numBytes, powers, pixelOutputs, numPowers, bytesPerChannel,
+        tiff->isLittle);
+}
+
+// processes a tiff with multiple strips, which are not guaranteed to be
+// placed continuously throughout the file
+int processMultiStrips(Tiff* tiff, const double* powers, unsigned char** outputs, int numPowers) {
+    int bytesPerChannel = tiff->bitsPerSample / 8;
+
+    return processStrips(tiff->data, tiff->dataLen, tiff->numStrips, tiff->stripOffsets, tiff->bytesPerStrip,
+        powers, outputs, numPowers, bytesPerChannel, tiff->isLittle);
+}
+
+// processes the pixels of a loaded image once for every power with the selected backend
+int processJob(Job* job, const double* powers) {
+    job->outputs = calloc(job->numPowers, sizeof(unsigned char*));
+
+    if (job->image != NULL) {
+        job->outputs[0] = job->image->pix;
+        return processImage(job->image, powers, job->outputs, job->numPowers);
+    }
+
+    // every power gets its own copy of the file, the first one is the file itself
+    job->outputs[0] = job->tiff->data;
+    for (int i = 1; i < job->numPowers; i++) {
+        job->outputs[i] = malloc(job->tiff->dataLen);
+        if (job->outputs[i] == NULL) {
+            reportFailure("not enough memory for the output of every power");
+            return -1;
+        }
+        memcpy(job->outputs[i], job->tiff->data, job->tiff->dataLen);
+    }
+
+    // handle tif according how many strips it has
+    if (job->tiff->numStrips == 1) {
+        return processSingleStrip(job->tiff, powers, job->outputs, job->numPowers);
+    }
+
+    return processMultiStrips(job->tiff, powers, job->outputs, job->numPowers);
+}
+
+// writes the processed image to the output file of every power
+int writeJob(Job* job) {
+    int result = 0;
+    for (int i = 0; i < job->numPowers; i++) {
+        if (job->image != NULL) {
+            Image output = *job->image;
+            output.pix = job->outputs[i];
+            if (writeImage(&output, job->outputPaths[i]) != 0) {
+                result = -1;
+            }
+        }
+        else {
+            Tiff output = *job->tiff;
+            output.data = job->outputs[i];
+            if (writeTiff(&output, job->outputPaths[i]) != 0) {
+                result = -1;
+            }
+        }
+    }
+
+    return result;
+}
+
+// frees the image held by the job, if any
+void freeJob(Job* job) {
+    // the first output is the buffer of the image or tiff, freed with it
+    if (job->outputs != NULL) {
+        for (int i = 1; i < job->numPowers; i++) {
+            free(job->outputs[i]);
+        }
+        free(job->outputs);
+        job->outputs = NULL;
+    }
+    if (job->image != NULL) {
+        free(job->image->pix);
+        free(job->image);
+        job->image = NULL;
+    }
+    if (job->tiff != NULL) {
+        freeTiff(job->tiff);
+        job->tiff = NULL;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef COLORCAST_HANDLE_H
+#define COLORCAST_HANDLE_H
+
+#include "Image.h"
+#include "Tiff.h"
+
+// one image on its way from the input file to its output files, one per power.
+// Converting an image takes three steps, loadJob, processJob and writeJob, so they
+// can run on different threads. All of them return 0 for success and -1 for failure.
+typedef struct {
+    char* imagePath;
+    char** outputPaths;         // one per power
+    int numPowers;
+    Tiff* tiff;                 // set once a tiff is loaded
+    Image* image;               // set once a jpg or png is loaded
+    unsigned char** outputs;    // per power the processed pixels of an image or the processed
+                                // tiff file. The first is the loaded buffer, processed in place
+} Job;
+
+// returns the length of the given file in bytes
+// -1 if cannot get length
+unsigned int getFileSize(char* filename);
+
+// estimates the most memory in bytes the job holds between loading and writing
+// from the file size and header of the image. returns 0 if the file can not be read
+unsigned long long estimateJobMemory(char* imagePath, unsigned int stripSize, int numPowers);
+
+// returns the number of pixels of the loaded image
+unsigned long long getJobPixels(Job* job);
+
+// reads the image into memory. Tiffs are checked to be supported and, if
+// stripSize is not 0, rewritten into strips of roughly stripSize bytes
+int loadJob(Job* job, unsigned int stripSize);
+
+// processes the pixels of a loaded image once for every power with the selected backend
+int processJob(Job* job, const double* powers);
+
+// writes the processed image to the output file of every power
+int writeJob(Job* job);
+
+// frees the image held by the job, if any
+void freeJob(Job* job);
+
+#endif //COLORCAST_HANDLE_H
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Hash.h"
+
+#define PRIME1 11400714785074694791ULL
+#define PRIME2 14029467366897019727ULL
+#define PRIME3 1609587929392839161ULL
+#define PRIME4 9650029242287828579ULL
+#define PRIME5 2870177450012600261ULL
+
+unsigned long long rotateLeft(unsigned long long x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+// reads little endian values whatever the byte order of the machine
+unsigned long long read64(const unsigned char* p) {
+    unsigned long long result = 0;
+    for (int i = 7; i >= 0; i--) {
+        result = (result << 8) | p[i];
+    }
+
+    return result;
+}
+
+unsigned long long read32(const unsigned char* p) {
+    return (unsigned long long)p[0] | (unsigned long long)p[1] << 8 | (unsigned long long)p[2] << 16
+        | (unsigned long long)p[3] << 24;
+}
+
+// mixes 8 bytes of input into an accumulator
+unsigned long long hashRound(unsigned long long acc, unsigned long long input) {
+    acc += input * PRIME2;
+    acc = rotateLeft(acc, 31);
+    return acc * PRIME1;
+}
+
+// folds an accumulator into the final hash
+unsigned long long mergeRound(unsigned long long hash, unsigned long long acc) {
+    hash ^= hashRound(0, acc);
+    return hash * PRIME1 + PRIME4;
+}
+
+void initHash(HashState* state, unsigned long long seed) {
+    state->totalLen = 0;
+    state->v[0] = seed + PRIME1 + PRIME2;
+    state->v[1] = seed + PRIME2;
+    state->v[2] = seed;
+    state->v[3] = seed - PRIME1;
+    state->bufferLen = 0;
+    state->seed = seed;
+}
+
+// mixes one 32 byte stripe into the accumulators
+void hashStripe(HashState* state, const unsigned char* stripe) {
+    for (int i = 0; i < 4; i++) {
+        state->v[i] = hashRound(state->v[i], read64(stripe + i * 8));
+    }
+}
+
+// adds len bytes of data to the hash
+void updateHash(HashState* state, const unsigned char* data, unsigned long len) {
+    state->totalLen += len;
+
+    // complete a stripe started by an earlier call
+    if (state->bufferLen > 0) {
+        unsigned long take = 32 - state->bufferLen;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(state->buffer + state->bufferLen, data, take);
+        state->bufferLen += take;
+        data += take;
+        len -= take;
+
+        if (state->bufferLen < 32) {
+            return;
+        }
+        hashStripe(state, state->buffer);
+        state->bufferLen = 0;
+    }
+
+    while (len >= 32) {
+        hashStripe(state, data);
+        data += 32;
+        len -= 32;
+    }
+
+    memcpy(state->buffer, data, len);
+    state->bufferLen = len;
+}
+
+// returns the hash of all data added so far
+unsigned long long finishHash(const HashState* state) {
+    unsigned long long hash;
+    if (state->totalLen >= 32) {
+        hash = rotateLeft(state->v[0], 1) + rotateLeft(state->v[1], 7) + rotateLeft(state->v[2], 12)
+            + rotateLeft(state->v[3], 18);
+        for (int i = 0; i < 4; i++) {
+            hash = mergeRound(hash, state->v[i]);
+        }
+    }
+    else {
+        hash = state->seed + PRIME5;
+    }
+    hash += state->totalLen;
+
+    // the bytes that did not fill a stripe
+    const unsigned char* p = state->buffer;
+    unsigned int len = state->bufferLen;
+    for (; len >= 8; p += 8, len -= 8) {
+        hash ^= hashRound(0, read64(p));
+        hash = rotateLeft(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (len >= 4) {
+        hash ^= read32(p) * PRIME1;
+        hash = rotateLeft(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+        len -= 4;
+    }
+    for (; len > 0; p++, len--) {
+        hash ^= *p * PRIME5;
+        hash = rotateLeft(hash, 11) * PRIME1;
+    }
+
+    // spread every input bit over the whole hash
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+// returns the hash of len bytes of data
+unsigned long long hashBytes(const unsigned char* data, unsigned long len, unsigned long long seed) {
+    HashState state;
+    initHash(&state, seed);
+    updateHash(&state, data, len);
+    return finishHash(&state);
+}
+
+// hashes the contents of a file. returns 0 on success, -1 if the file can not be read
+int hashFile(const char* path, unsigned long long* hash) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    HashState state;
+    initHash(&state, 0);
+
+    unsigned long chunkSize = 1 << 20;
+    unsigned char* chunk = malloc(chunkSize);
+    size_t numRead;
+    while ((numRead = fread(chunk, 1, chunkSize, file)) > 0) {
+        updateHash(&state, chunk, (unsigned long)numRead);
+    }
+
+    int result = ferror(file) ? -1 : 0;
+    free(chunk);
+    fclose(file);
+
+    *hash = finishHash(&state);
+    return result;
+}
@@ -0,0 +1,29 @@
+#ifndef COLORCAST_HASH_H
+#define COLORCAST_HASH_H
+
+// XXH64, a fast non-cryptographic hash used to tell whether a file changed
+
+// state of a hash computed over data given in pieces
+typedef struct {
+    unsigned long long totalLen;
+    unsigned long long v[4];            // accumulators of the 32 byte stripes
+    unsigned char buffer[32];           // start of a stripe not complete yet
+    unsigned int bufferLen;
+    unsigned long long seed;
+} HashState;
+
+void initHash(HashState* state, unsigned long long seed);
+
+// adds len bytes of data to the hash
+void updateHash(HashState* state, const unsigned char* data, unsigned long len);
+
+// returns the hash of all data added so far
+unsigned long long finishHash(const HashState* state);
+
+// returns the hash of len bytes of data
+unsigned long long hashBytes(const unsigned char* data, unsigned long len, unsigned long long seed);
+
+// hashes the contents of a file. returns 0 on success, -1 if the file can not be read
+int hashFile(const char* path, unsigned long long* hash);
+
+#endif //COLORCAST_HASH_H
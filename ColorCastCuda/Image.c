@@ -1,42 +1,157 @@
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 
+#include "Clock.h"
+#include "Decoder.h"
+#include "Failure.h"
 #include "File.h"
 #include "Image.h"
+#include "Jpeg.h"
+#include "Png.h"
+#include "Stage.h"
 #include "stb_image.h"
 #include "stb_image_write.h"
 
+// compression level of png output, 0 (store) to 9
+int pngLevel = 6;
+// quality (1 - 100) and chroma subsampling of jpeg output
+int jpegQuality = 95;
+int jpegSubsampling = SUBSAMPLING_444;
+// jpegs are decoded at 1/jpegScaleDenom of their size, used for previews
+int jpegScaleDenom = 1;
+
+// reads the entire file into memory, returns NULL if the file could not be read
+unsigned char* readFile(char* path, unsigned long* len) {
+    double start = getMonotonicTime();
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    *len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char* data = malloc(*len);
+    if (data != NULL && fread(data, 1, *len, file) != *len) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    addStageTime(STAGE_READ, getMonotonicTime() - start, *len, 0);
+    return data;
+}
+
 // returns a struct that contains an array of pixels, width and height of an image
-// in rgb. Exits program if unable to load image.
+// in rgb. The file is read whole before it is decoded, so reading and decoding are
+// timed apart. returns NULL if unable to load image.
 Image* getImage(char* path) {
     int width, height, channels;
-    unsigned char* pixels = stbi_load(path, &width, &height, &channels, 3);
+    int bitsPerSample = 8;
+    unsigned char* pixels;
+    unsigned long len;
+    unsigned char* data = readFile(path, &len);
+    if (data == NULL) {
+        reportFailure("could not read image");
+        return NULL;
+    }
+
+    CounterValues startCounts;
+    readCounters(&startCounts);
+    double start = getMonotonicTime();
+    if (isExtension(path, "jpg")) {
+        // decoded with the fastest decoder available
+        pixels = getJpegDecoder()->decode(data, len, jpegScaleDenom, &width, &height);
+    }
+    else if (stbi_is_16_bit_from_memory(data, (int)len)) {
+        // keep the full precision of 16 bit pngs
+        pixels = (unsigned char*)stbi_load_16_from_memory(data, (int)len, &width, &height, &channels, 3);
+        bitsPerSample = 16;
+    }
+    else {
+        pixels = stbi_load_from_memory(data, (int)len, &width, &height, &channels, 3);
+    }
+    free(data);
     // failed to load image
     if (pixels == NULL) {
-        printf("Failed to load image\n");
+        reportFailure("could not decode image with %s",
+            isExtension(path, "jpg") ? getJpegDecoderName() : stbi_failure_reason());
         return NULL;
     }
     // create image struct
     Image* img = malloc(sizeof(Image));
     img->width = width;
     img->height = height;
+    img->bitsPerSample = bitsPerSample;
     img->pix = pixels;
+    img->decodeTime = getMonotonicTime() - start;
+    addStageTime(STAGE_DECODE, img->decodeTime, (unsigned long long)width * height * 3 * (bitsPerSample / 8),
+        (unsigned long long)width * height);
+    addStageCounters(STAGE_DECODE, &startCounts);
 
     return img;
 }
 
+// reads the size the image will have once loaded by getImage from the header of the
+// file, without decoding it. returns 0 on success, -1 if the header can not be read
+int getImageInfo(char* path, int* width, int* height, int* bitsPerSample) {
+    int channels;
+    if (!stbi_info(path, width, height, &channels)) {
+        return -1;
+    }
+
+    *bitsPerSample = 8;
+    if (isExtension(path, "jpg")) {
+        // previews are decoded at a fraction of their size, rounded up
+        *width = (*width + jpegScaleDenom - 1) / jpegScaleDenom;
+        *height = (*height + jpegScaleDenom - 1) / jpegScaleDenom;
+    }
+    else if (stbi_is_16_bit(path)) {
+        *bitsPerSample = 16;
+    }
+
+    return 0;
+}
+
 // writes the given image to the given outputPath
-void writeImage(Image* img, char* outputPath) {
+int writeImage(Image* img, char* outputPath) {
     if (isExtension(outputPath, "jpg")) {
-        stbi_write_jpg(outputPath, img->width, img->height, 3, img->pix, 100);
-    }
-    else {
-        stbi_write_png(outputPath, img->width, img->height, 3, img->pix, img->width * 3);
+        return writeJpeg(outputPath, img->pix, img->width, img->height, jpegQuality, jpegSubsampling);
     }
 
-    // free up image
-    free(img->pix);
-    free(img);
+    return writePng(outputPath, img->pix, img->width, img->height, img->bitsPerSample, pngLevel);
 }
 
+// sets the compression level of png output. 0 stores the pixels
+// uncompressed, 1 is the fastest and 9 the smallest compression
+void setPngCompressionLevel(int level) {
+    pngLevel = level;
+}
 
+// sets the quality (1 - 100) of jpeg output
+void setJpegQuality(int quality) {
+    jpegQuality = quality;
+}
+
+// sets the chroma subsampling of jpeg output, one of the SUBSAMPLING_ values in Jpeg.h
+void setJpegSubsampling(int subsampling) {
+    jpegSubsampling = subsampling;
+}
+
+// sets the scale jpegs are decoded at to 1/scaleDenom of their size, only
+// decoders that scale the inverse DCT can decode below full size
+int setJpegPreviewScale(int scaleDenom) {
+    if (scaleDenom != 1 && !getJpegDecoder()->canScale) {
+        printf("preview needs the libjpeg-turbo build\n");
+        return -1;
+    }
+
+    jpegScaleDenom = scaleDenom;
+    return 0;
+}
+
+// returns the name of the decoder used for jpegs
+const char* getJpegDecoderName() {
+    return getJpegDecoder()->name;
+}
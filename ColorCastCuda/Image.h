@@ -4,14 +4,39 @@
 typedef struct {
     int width;
     int height;
+    int bitsPerSample;      // 8, or 16 for 16 bit pngs whose samples are in the byte order of the machine
     unsigned char* pix;
+    double decodeTime;      // seconds spent decoding the file into pix
 } Image;
 
 // loads and returns a pointer to the image struct
 // based on the given path
 Image* getImage(char* path);
 
+// reads the size the image will have once loaded by getImage from the header of the
+// file, without decoding it. returns 0 on success, -1 if the header can not be read
+int getImageInfo(char* path, int* width, int* height, int* bitsPerSample);
+
 // writes the given image to the given outputPath
-void writeImage(Image* image, char* outputPath);
+// returns 0 on success, -1 on failure
+int writeImage(Image* image, char* outputPath);
+
+// sets the compression level of png output. 0 stores the pixels
+// uncompressed, 1 is the fastest and 9 the smallest compression
+void setPngCompressionLevel(int level);
+
+// sets the quality (1 - 100) of jpeg output
+void setJpegQuality(int quality);
+
+// sets the chroma subsampling of jpeg output, one of the SUBSAMPLING_ values in Jpeg.h
+void setJpegSubsampling(int subsampling);
+
+// sets the scale jpegs are decoded at to 1/scaleDenom of their size.
+// scaleDenom must be 1, 2, 4 or 8. returns 0 on success, -1 if the jpeg
+// decoder of this build can only decode at full size
+int setJpegPreviewScale(int scaleDenom);
+
+// returns the name of the decoder used for jpegs
+const char* getJpegDecoderName();
 
 #endif //COLORCAST_IMAGE_H
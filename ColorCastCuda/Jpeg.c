@@ -0,0 +1,475 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Buffer.h"
+#include "Clock.h"
+#include "Failure.h"
+#include "Jpeg.h"
+#include "Stage.h"
+#include "Thread.h"
+#include "Trace.h"
+
+// number of bands per thread, more bands even out the work between threads
+#define BANDS_PER_THREAD 4
+
+// the tables below are the standard tables from Annex K of the jpeg specification,
+// taken from stb_image_write (public domain)
+
+// zigzag position of each coefficient of a block in natural order
+const unsigned char zigzag[64] = { 0, 1, 5, 6, 14, 15, 27, 28, 2, 4, 7, 13, 16, 26, 29, 42, 3, 8, 12, 17, 25, 30, 41, 43,
+    9, 11, 18, 24, 31, 40, 44, 53, 10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60, 21, 34, 37, 47, 50, 56,
+    59, 61, 35, 36, 48, 49, 57, 58, 62, 63 };
+
+const int lumaQuant[64] = { 16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56,
+    14, 17, 22, 29, 51, 87, 80, 62, 18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92, 49, 64, 78, 87,
+    103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+const int chromaQuant[64] = { 17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99 };
+
+// number of codes of each length from 1 to 16 bits followed by the symbols
+const unsigned char dcLumaCounts[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+const unsigned char dcLumaValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const unsigned char dcChromaCounts[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+const unsigned char dcChromaValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const unsigned char acLumaCounts[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+const unsigned char acLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32,
+    0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+    0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94,
+    0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8,
+    0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa };
+const unsigned char acChromaCounts[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+const unsigned char acChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81,
+    0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+    0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92,
+    0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6,
+    0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa };
+
+// scale factors of the AAN forward dct for each row and column
+const float aanScales[8] = { 1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+
+// huffman code and its length in bits for every symbol
+typedef struct {
+    unsigned short codes[256];
+    unsigned char lengths[256];
+} JpegHuffman;
+
+// writes bits most significant bit first, stuffing a 0 after every 0xff byte
+typedef struct {
+    Buffer* out;
+    unsigned int bits;
+    int count;
+} JpegBitWriter;
+
+// state shared by the threads writing one jpeg
+typedef struct {
+    unsigned char* pix;
+    int width;
+    int height;
+    int hSamp;                      // horizontal and vertical sampling factors of luma,
+    int vSamp;                      // chroma is always sampled once per MCU
+    int mcusPerRow;
+    int mcuRows;
+    int rowsPerBand;
+    unsigned char lumaTable[64];    // quantization tables in zigzag order
+    unsigned char chromaTable[64];
+    float lumaDivisors[64];         // reciprocal quantization and dct scale in natural order
+    float chromaDivisors[64];
+    JpegHuffman dcLuma;
+    JpegHuffman acLuma;
+    JpegHuffman dcChroma;
+    JpegHuffman acChroma;
+    Buffer* bands;
+} JpegJob;
+
+// builds the huffman codes from the number of codes of each length and their symbols
+void buildJpegHuffman(JpegHuffman* table, const unsigned char* counts, const unsigned char* values) {
+    int code = 0;
+    int k = 0;
+
+    memset(table, 0, sizeof(JpegHuffman));
+    for (int length = 1; length <= 16; length++) {
+        for (int i = 0; i < counts[length - 1]; i++) {
+            table->codes[values[k]] = code++;
+            table->lengths[values[k]] = length;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+void putJpegBits(JpegBitWriter* writer, unsigned int code, int length) {
+    writer->bits = (writer->bits << length) | code;
+    writer->count += length;
+
+    while (writer->count >= 8) {
+        unsigned char byte = writer->bits >> (writer->count - 8);
+        appendByte(writer->out, byte);
+        if (byte == 0xff) {
+            appendByte(writer->out, 0);
+        }
+        writer->count -= 8;
+    }
+    writer->bits &= (1 << writer->count) - 1;
+}
+
+// pads the last byte of an entropy coded segment with 1 bits
+void flushJpegBits(JpegBitWriter* writer) {
+    if (writer->count > 0) {
+        putJpegBits(writer, (1 << (8 - writer->count)) - 1, 8 - writer->count);
+    }
+}
+
+// one dimensional AAN forward dct over 8 values spaced stride apart
+void fdct(float* d, int stride) {
+    float tmp0 = d[0] + d[7 * stride];
+    float tmp7 = d[0] - d[7 * stride];
+    float tmp1 = d[stride] + d[6 * stride];
+    float tmp6 = d[stride] - d[6 * stride];
+    float tmp2 = d[2 * stride] + d[5 * stride];
+    float tmp5 = d[2 * stride] - d[5 * stride];
+    float tmp3 = d[3 * stride] + d[4 * stride];
+    float tmp4 = d[3 * stride] - d[4 * stride];
+
+    // even part
+    float tmp10 = tmp0 + tmp3;
+    float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
+
+    d[0] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = tmp10 * 0.541196100f + z5;
+    float z4 = tmp12 * 1.306562965f + z5;
+    float z3 = tmp11 * 0.707106781f;
+
+    float z11 = tmp7 + z3;
+    float z13 = tmp7 - z3;
+
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+// sets length to the number of bits needed for value and bits to how they are stored
+void getCategory(int value, unsigned int* bits, int* length) {
+    int magnitude = value < 0 ? -value : value;
+    int len = 0;
+    while (magnitude) {
+        len++;
+        magnitude >>= 1;
+    }
+
+    *length = len;
+    *bits = (value < 0 ? value - 1 : value) & ((1 << len) - 1);
+}
+
+// transforms, quantizes and encodes one 8x8 block. Returns the dc value of the
+// block, which the next block of the same component is predicted from.
+int encodeBlock(JpegBitWriter* writer, float* block, const float* divisors, int prevDc,
+    const JpegHuffman* dcTable, const JpegHuffman* acTable) {
+    int coefs[64];
+    unsigned int bits;
+    int length;
+
+    for (int i = 0; i < 8; i++) {
+        fdct(block + i * 8, 1);
+    }
+    for (int i = 0; i < 8; i++) {
+        fdct(block + i, 8);
+    }
+
+    for (int i = 0; i < 64; i++) {
+        float value = block[i] * divisors[i];
+        coefs[zigzag[i]] = (int)(value < 0 ? value - 0.5f : value + 0.5f);
+    }
+
+    // dc is coded as the difference to the previous block
+    getCategory(coefs[0] - prevDc, &bits, &length);
+    putJpegBits(writer, dcTable->codes[length], dcTable->lengths[length]);
+    putJpegBits(writer, bits, length);
+
+    int last = 63;
+    while (last > 0 && coefs[last] == 0) {
+        last--;
+    }
+
+    int run = 0;
+    for (int i = 1; i <= last; i++) {
+        if (coefs[i] == 0) {
+            run++;
+            continue;
+        }
+        // runs of 16 zeros
+        while (run >= 16) {
+            putJpegBits(writer, acTable->codes[0xf0], acTable->lengths[0xf0]);
+            run -= 16;
+        }
+
+        getCategory(coefs[i], &bits, &length);
+        int symbol = (run << 4) | length;
+        putJpegBits(writer, acTable->codes[symbol], acTable->lengths[symbol]);
+        putJpegBits(writer, bits, length);
+        run = 0;
+    }
+    if (last < 63) {
+        // end of block
+        putJpegBits(writer, acTable->codes[0], acTable->lengths[0]);
+    }
+
+    return coefs[0];
+}
+
+// returns the pixel at x, y repeating the edge pixels past the border
+unsigned char* getClampedPixel(JpegJob* job, int x, int y) {
+    if (x >= job->width) {
+        x = job->width - 1;
+    }
+    if (y >= job->height) {
+        y = job->height - 1;
+    }
+
+    return job->pix + ((size_t)y * job->width + x) * 3;
+}
+
+// encodes one MCU, updating the dc predictions of the three components
+void encodeMcu(JpegJob* job, JpegBitWriter* writer, int mcuX, int mcuY, int* dc) {
+    int mcuWidth = 8 * job->hSamp;
+    int mcuHeight = 8 * job->vSamp;
+    int x0 = mcuX * mcuWidth;
+    int y0 = mcuY * mcuHeight;
+    float y[4][64];
+    float cb[64] = { 0 };
+    float cr[64] = { 0 };
+    float chromaScale = 1.0f / (job->hSamp * job->vSamp);
+
+    for (int py = 0; py < mcuHeight; py++) {
+        for (int px = 0; px < mcuWidth; px++) {
+            unsigned char* rgb = getClampedPixel(job, x0 + px, y0 + py);
+            float r = rgb[0];
+            float g = rgb[1];
+            float b = rgb[2];
+            int block = (py / 8) * job->hSamp + px / 8;
+            int index = (py % 8) * 8 + px % 8;
+            int chromaIndex = (py / job->vSamp) * 8 + px / job->hSamp;
+
+            // jfif rgb to ycbcr, level shifted to be centered around 0
+            y[block][index] = 0.299f * r + 0.587f * g + 0.114f * b - 128;
+            cb[chromaIndex] += (-0.168736f * r - 0.331264f * g + 0.5f * b) * chromaScale;
+            cr[chromaIndex] += (0.5f * r - 0.418688f * g - 0.081312f * b) * chromaScale;
+        }
+    }
+
+    for (int block = 0; block < job->hSamp * job->vSamp; block++) {
+        dc[0] = encodeBlock(writer, y[block], job->lumaDivisors, dc[0], &job->dcLuma, &job->acLuma);
+    }
+    dc[1] = encodeBlock(writer, cb, job->chromaDivisors, dc[1], &job->dcChroma, &job->acChroma);
+    dc[2] = encodeBlock(writer, cr, job->chromaDivisors, dc[2], &job->dcChroma, &job->acChroma);
+}
+
+// encodes a band of MCU rows. Every row is a restart interval that starts with
+// fresh dc predictions and is followed by a restart marker, except the last row.
+void encodeBand(void* context, int band) {
+    JpegJob* job = context;
+    int firstRow = band * job->rowsPerBand;
+    int lastRow = firstRow + job->rowsPerBand > job->mcuRows ? job->mcuRows : firstRow + job->rowsPerBand;
+
+    TRACE_BEGIN("encode band", NULL);
+    Buffer* out = &job->bands[band];
+    initBuffer(out, (size_t)(lastRow - firstRow) * job->mcusPerRow * 64);
+    JpegBitWriter writer = { out, 0, 0 };
+
+    for (int row = firstRow; row < lastRow; row++) {
+        int dc[3] = { 0, 0, 0 };
+        for (int col = 0; col < job->mcusPerRow; col++) {
+            encodeMcu(job, &writer, col, row, dc);
+        }
+        flushJpegBits(&writer);
+
+        if (row != job->mcuRows - 1) {
+            appendByte(out, 0xff);
+            appendByte(out, 0xd0 + (row & 7));
+        }
+    }
+    TRACE_END("encode band");
+}
+
+// appends a marker segment header: marker and the length of the segment
+void appendMarker(Buffer* out, unsigned char marker, int length) {
+    appendByte(out, 0xff);
+    appendByte(out, marker);
+    appendByte(out, length >> 8);
+    appendByte(out, length);
+}
+
+// appends a DHT table definition
+void appendHuffmanTable(Buffer* out, int tableClassAndId, const unsigned char* counts, const unsigned char* values, int numValues) {
+    appendByte(out, tableClassAndId);
+    appendBytes(out, counts, 16);
+    appendBytes(out, values, numValues);
+}
+
+// builds every header in front of the entropy coded data
+void buildJpegHeaders(JpegJob* job, Buffer* out) {
+    const unsigned char jfif[14] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+
+    // start of image
+    appendByte(out, 0xff);
+    appendByte(out, 0xd8);
+    appendMarker(out, 0xe0, 2 + sizeof(jfif));
+    appendBytes(out, jfif, sizeof(jfif));
+
+    // quantization tables
+    appendMarker(out, 0xdb, 2 + 2 * 65);
+    appendByte(out, 0);
+    appendBytes(out, job->lumaTable, 64);
+    appendByte(out, 1);
+    appendBytes(out, job->chromaTable, 64);
+
+    // baseline frame with three components: id, sampling factors, quantization table
+    appendMarker(out, 0xc0, 17);
+    appendByte(out, 8);
+    appendByte(out, job->height >> 8);
+    appendByte(out, job->height);
+    appendByte(out, job->width >> 8);
+    appendByte(out, job->width);
+    appendByte(out, 3);
+    const unsigned char components[9] = { 1, (job->hSamp << 4) | job->vSamp, 0, 2, 0x11, 1, 3, 0x11, 1 };
+    appendBytes(out, components, 9);
+
+    // huffman tables
+    appendMarker(out, 0xc4, 2 + 4 * 17 + 12 + 162 + 12 + 162);
+    appendHuffmanTable(out, 0x00, dcLumaCounts, dcLumaValues, 12);
+    appendHuffmanTable(out, 0x10, acLumaCounts, acLumaValues, 162);
+    appendHuffmanTable(out, 0x01, dcChromaCounts, dcChromaValues, 12);
+    appendHuffmanTable(out, 0x11, acChromaCounts, acChromaValues, 162);
+
+    // restart interval of one row of MCUs
+    appendMarker(out, 0xdd, 4);
+    appendByte(out, job->mcusPerRow >> 8);
+    appendByte(out, job->mcusPerRow);
+
+    // start of scan: each component with its dc and ac tables, full spectral selection
+    appendMarker(out, 0xda, 12);
+    const unsigned char scan[8] = { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0 };
+    appendBytes(out, scan, 8);
+    appendByte(out, 0x3f);
+    appendByte(out, 0);
+}
+
+// writes 8 bit rgb pixels to a baseline jpeg file. returns 0 on success, -1 on failure
+int writeJpeg(char* path, unsigned char* pix, int width, int height, int quality, int subsampling) {
+    if (width <= 0 || height <= 0 || width > 65535 || height > 65535) {
+        reportFailure("image is too large to be saved as a jpeg");
+        return -1;
+    }
+
+    CounterValues startCounts;
+    readCounters(&startCounts);
+    double start = getMonotonicTime();
+    JpegJob job;
+    job.pix = pix;
+    job.width = width;
+    job.height = height;
+    job.hSamp = subsampling == SUBSAMPLING_444 ? 1 : 2;
+    job.vSamp = subsampling == SUBSAMPLING_420 ? 2 : 1;
+    job.mcusPerRow = (width + 8 * job.hSamp - 1) / (8 * job.hSamp);
+    job.mcuRows = (height + 8 * job.vSamp - 1) / (8 * job.vSamp);
+
+    // scale the standard tables the same way libjpeg does
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; i++) {
+        int luma = (lumaQuant[i] * scale + 50) / 100;
+        int chroma = (chromaQuant[i] * scale + 50) / 100;
+        job.lumaTable[zigzag[i]] = luma < 1 ? 1 : luma > 255 ? 255 : luma;
+        job.chromaTable[zigzag[i]] = chroma < 1 ? 1 : chroma > 255 ? 255 : chroma;
+    }
+    // fold the scaling of the AAN dct into the quantization
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            int i = row * 8 + col;
+            float dctScale = aanScales[row] * aanScales[col] * 8;
+            job.lumaDivisors[i] = 1 / (job.lumaTable[zigzag[i]] * dctScale);
+            job.chromaDivisors[i] = 1 / (job.chromaTable[zigzag[i]] * dctScale);
+        }
+    }
+
+    buildJpegHuffman(&job.dcLuma, dcLumaCounts, dcLumaValues);
+    buildJpegHuffman(&job.acLuma, acLumaCounts, acLumaValues);
+    buildJpegHuffman(&job.dcChroma, dcChromaCounts, dcChromaValues);
+    buildJpegHuffman(&job.acChroma, acChromaCounts, acChromaValues);
+
+    int numThreads = getNumThreads();
+    job.rowsPerBand = (job.mcuRows + numThreads * BANDS_PER_THREAD - 1) / (numThreads * BANDS_PER_THREAD);
+    int numBands = (job.mcuRows + job.rowsPerBand - 1) / job.rowsPerBand;
+    job.bands = malloc(numBands * sizeof(Buffer));
+    if (job.bands == NULL) {
+        reportFailure("not enough memory to write jpeg");
+        return -1;
+    }
+
+    runParallel(encodeBand, &job, numBands);
+
+    Buffer headers;
+    initBuffer(&headers, 1024);
+    buildJpegHeaders(&job, &headers);
+    double encoded = getMonotonicTime();
+    addStageTime(STAGE_ENCODE, encoded - start, (unsigned long long)width * height * 3,
+        (unsigned long long)width * height);
+    addStageCounters(STAGE_ENCODE, &startCounts);
+
+    int result = 0;
+    size_t fileLen = headers.len + 2;
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        reportFailure("could not open output file");
+        result = -1;
+    }
+    else {
+        const unsigned char endOfImage[2] = { 0xff, 0xd9 };
+        fwrite(headers.data, 1, headers.len, file);
+        for (int i = 0; i < numBands; i++) {
+            fwrite(job.bands[i].data, 1, job.bands[i].len, file);
+            fileLen += job.bands[i].len;
+        }
+        fwrite(endOfImage, 1, 2, file);
+
+        if (ferror(file)) {
+            reportFailure("could not write jpeg");
+            result = -1;
+        }
+        fclose(file);
+        addStageTime(STAGE_WRITE, getMonotonicTime() - encoded, fileLen, (unsigned long long)width * height);
+    }
+
+    for (int i = 0; i < numBands; i++) {
+        freeBuffer(&job.bands[i]);
+    }
+    freeBuffer(&headers);
+    free(job.bands);
+
+    return result;
+}
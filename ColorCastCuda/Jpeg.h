@@ -0,0 +1,15 @@
+#ifndef COLORCAST_JPEG_H
+#define COLORCAST_JPEG_H
+
+// chroma subsampling modes, named after the usual J:a:b notation
+#define SUBSAMPLING_444 444
+#define SUBSAMPLING_422 422
+#define SUBSAMPLING_420 420
+
+// writes 8 bit rgb pixels to a baseline jpeg file with the given quality (1 - 100)
+// and chroma subsampling. Every row of MCUs is its own restart interval, so bands
+// of rows are encoded on multiple threads and joined with RSTn markers.
+// returns 0 on success, -1 on failure
+int writeJpeg(char* path, unsigned char* pix, int width, int height, int quality, int subsampling);
+
+#endif //COLORCAST_JPEG_H
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "Hash.h"
+#include "Manifest.h"
+#include "Platform.h"
+
+#define MANIFEST_NAME ".colorcast-manifest"
+#define MANIFEST_HEADER "# colorcast manifest 2"
+
+// returns where the entry for an input and power is or belongs in the table
+int findSlot(Manifest* manifest, const char* path, double power) {
+    unsigned long long hash = hashBytes((const unsigned char*)path, (unsigned long)strlen(path),
+        hashBytes((const unsigned char*)&power, sizeof(power), 0));
+    int slot = (int)(hash & (manifest->tableSize - 1));
+
+    while (manifest->table[slot] != -1) {
+        ManifestEntry* entry = &manifest->entries[manifest->table[slot]];
+        if (entry->power == power && strcmp(entry->path, path) == 0) {
+            break;
+        }
+        slot = (slot + 1) & (manifest->tableSize - 1);
+    }
+
+    return slot;
+}
+
+// doubles the table and puts every entry back in it
+void growTable(Manifest* manifest) {
+    free(manifest->table);
+    manifest->tableSize = manifest->tableSize == 0 ? 1024 : manifest->tableSize * 2;
+    manifest->table = malloc(manifest->tableSize * sizeof(int));
+    memset(manifest->table, -1, manifest->tableSize * sizeof(int));
+
+    for (int i = 0; i < manifest->count; i++) {
+        manifest->table[findSlot(manifest, manifest->entries[i].path, manifest->entries[i].power)] = i;
+    }
+}
+
+// returns the entry for an input converted with the given power, NULL if there is none
+ManifestEntry* findManifestEntry(Manifest* manifest, const char* path, double power) {
+    int index = manifest->table[findSlot(manifest, path, power)];
+    return index == -1 ? NULL : &manifest->entries[index];
+}
+
+// adds the entry, replacing the one for the same input and power
+void setManifestEntry(Manifest* manifest, const ManifestEntry* entry) {
+    ManifestEntry* existing = findManifestEntry(manifest, entry->path, entry->power);
+    if (existing != NULL) {
+        char* path = existing->path;
+        *existing = *entry;
+        existing->path = path;
+        return;
+    }
+
+    // keep the table at most half full so probes stay short
+    if ((manifest->count + 1) * 2 > manifest->tableSize) {
+        growTable(manifest);
+    }
+    if (manifest->count == manifest->cap) {
+        manifest->cap = manifest->cap == 0 ? 256 : manifest->cap * 2;
+        manifest->entries = realloc(manifest->entries, manifest->cap * sizeof(ManifestEntry));
+    }
+
+    ManifestEntry* added = &manifest->entries[manifest->count];
+    *added = *entry;
+    added->path = _strdup(entry->path);
+    manifest->table[findSlot(manifest, added->path, added->power)] = manifest->count;
+    manifest->count++;
+}
+
+// loads the manifest of the output directory, which is empty if there is none yet
+Manifest* loadManifest(const char* outputDir) {
+    Manifest* manifest = calloc(1, sizeof(Manifest));
+    size_t pathLength = strlen(outputDir) + strlen(PATH_SEPARATOR MANIFEST_NAME) + 1;
+    manifest->filePath = malloc(pathLength);
+    snprintf(manifest->filePath, pathLength, "%s" PATH_SEPARATOR "%s", outputDir, MANIFEST_NAME);
+    const char* filePath = manifest->filePath;
+    growTable(manifest);
+
+    FILE* file = fopen(filePath, "r");
+    if (file == NULL) {
+        return manifest;
+    }
+
+    // every line is: hash size mtime power kernel-version settings path, separated by tabs.
+    // The path comes last so it may contain anything but a line break
+    char line[4096];
+    if (fgets(line, sizeof(line), file) == NULL || strncmp(line, MANIFEST_HEADER, strlen(MANIFEST_HEADER)) != 0) {
+        printf("ignoring manifest in an unknown format: %s\n", filePath);
+        fclose(file);
+        return manifest;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        ManifestEntry entry;
+        int pathStart = 0;
+        if (sscanf(line, "%llx\t%llu\t%lld\t%lf\t%d\t%llx\t%n", &entry.hash, &entry.size, &entry.mtime, &entry.power,
+            &entry.kernelVersion, &entry.settings, &pathStart) != 6 || pathStart == 0) {
+            continue;
+        }
+
+        entry.path = line + pathStart;
+        setManifestEntry(manifest, &entry);
+    }
+
+    fclose(file);
+    return manifest;
+}
+
+// writes the manifest back to the output directory. The new manifest replaces the
+// old one only once it is complete, so an interrupted run keeps the old one.
+// returns 0 on success, -1 on failure
+int saveManifest(Manifest* manifest) {
+    size_t pathLength = strlen(manifest->filePath) + strlen(".tmp") + 1;
+    char* tempPath = malloc(pathLength);
+    snprintf(tempPath, pathLength, "%s.tmp", manifest->filePath);
+
+    FILE* file = fopen(tempPath, "w");
+    if (file == NULL) {
+        printf("could not write manifest: %s\n", tempPath);
+        free(tempPath);
+        return -1;
+    }
+
+    fprintf(file, "%s\n", MANIFEST_HEADER);
+    for (int i = 0; i < manifest->count; i++) {
+        ManifestEntry* entry = &manifest->entries[i];
+        // powers are written with enough digits to read back the same double
+        fprintf(file, "%016llx\t%llu\t%lld\t%.17g\t%d\t%016llx\t%s\n", entry->hash, entry->size, entry->mtime,
+            entry->power, entry->kernelVersion, entry->settings, entry->path);
+    }
+
+    if (fclose(file) != 0) {
+        remove(tempPath);
+        free(tempPath);
+        return -1;
+    }
+
+#ifdef _WIN32
+    // rename does not replace an existing file on windows
+    remove(manifest->filePath);
+#endif
+    int result = rename(tempPath, manifest->filePath) == 0 ? 0 : -1;
+    free(tempPath);
+    return result;
+}
+
+void freeManifest(Manifest* manifest) {
+    for (int i = 0; i < manifest->count; i++) {
+        free(manifest->entries[i].path);
+    }
+
+    free(manifest->entries);
+    free(manifest->table);
+    free(manifest->filePath);
+    free(manifest);
+}
+
+// reads the size and last modification time of a file. returns 0 on success, -1 on failure
+int getFileInfo(const char* path, unsigned long long* size, long long* mtime) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return -1;
+    }
+
+    *size = (unsigned long long)info.st_size;
+    *mtime = (long long)info.st_mtime;
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef COLORCAST_MANIFEST_H
+#define COLORCAST_MANIFEST_H
+
+// the manifest is a file in the output directory recording every image converted
+// into it, so a rerun can skip images whose input and settings did not change
+
+// what an output was made from
+typedef struct {
+    char* path;                     // absolute path of the input image
+    double power;
+    unsigned long long size;        // of the input in bytes
+    long long mtime;                // last modification of the input, seconds since the epoch
+    unsigned long long hash;        // of the contents of the input
+    int kernelVersion;
+    unsigned long long settings;    // hash of the encoder settings the output was written with
+} ManifestEntry;
+
+typedef struct {
+    char* filePath;
+    ManifestEntry* entries;
+    int count;
+    int cap;
+    int* table;                     // open addressing table of indices into entries, -1 if empty
+    int tableSize;
+} Manifest;
+
+// loads the manifest of the output directory, which is empty if there is none yet
+Manifest* loadManifest(const char* outputDir);
+
+// returns the entry for an input converted with the given power, NULL if there is none
+ManifestEntry* findManifestEntry(Manifest* manifest, const char* path, double power);
+
+// adds the entry, replacing the one for the same input and power
+void setManifestEntry(Manifest* manifest, const ManifestEntry* entry);
+
+// writes the manifest back to the output directory. returns 0 on success, -1 on failure
+int saveManifest(Manifest* manifest);
+
+void freeManifest(Manifest* manifest);
+
+// reads the size and last modification time of a file. returns 0 on success, -1 on failure
+int getFileInfo(const char* path, unsigned long long* size, long long* mtime);
+
+#endif //COLORCAST_MANIFEST_H
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "Backend.h"
+#include "File.h"
+#include "Metrics.h"
+#include "Thread.h"
+
+struct Metrics {
+    FILE* file;
+    int isCsv;
+    Mutex lock;
+};
+
+// returns the most memory in bytes the process has held at once so far
+unsigned long long getPeakMemory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // linux reports kilobytes
+    return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+}
+
+// returns the name of a final status as written in the records
+const char* getStatusName(ImageStatus status) {
+    switch (status) {
+    case IMAGE_WRITTEN:
+        return "written";
+    case IMAGE_CANCELLED:
+        return "cancelled";
+    case IMAGE_FAILED:
+        return "failed";
+    default:
+        return "started";
+    }
+}
+
+// returns the format of an image from its extension
+const char* getFormatName(const char* path) {
+    if (isExtension((char*)path, "jpg")) {
+        return "jpeg";
+    }
+    if (isExtension((char*)path, "png")) {
+        return "png";
+    }
+    if (isExtension((char*)path, "tif") || isExtension((char*)path, "tiff")) {
+        return "tiff";
+    }
+
+    return "unknown";
+}
+
+// writes a string as a quoted field, in the quoting of csv or json
+void writeString(Metrics* metrics, const char* str) {
+    fputc('"', metrics->file);
+    for (const unsigned char* c = (const unsigned char*)str; *c != '\0'; c++) {
+        if (metrics->isCsv) {
+            // quotes are doubled, everything else is kept between the quotes
+            if (*c == '"') {
+                fputc('"', metrics->file);
+            }
+            fputc(*c, metrics->file);
+        }
+        else if (*c == '"' || *c == '\\') {
+            fprintf(metrics->file, "\\%c", *c);
+        }
+        else if (*c < 0x20) {
+            fprintf(metrics->file, "\\u%04x", *c);
+        }
+        else {
+            fputc(*c, metrics->file);
+        }
+    }
+    fputc('"', metrics->file);
+}
+
+// writes the name of the next field, json only, and the separator before it
+void writeKey(Metrics* metrics, const char* key, int isFirst) {
+    if (!isFirst) {
+        fputc(',', metrics->file);
+    }
+    if (!metrics->isCsv) {
+        fprintf(metrics->file, "\"%s\":", key);
+    }
+}
+
+// the stages whose hardware counts are recorded, see Counters.h
+static const Stage countedStages[] = { STAGE_DECODE, STAGE_KERNEL, STAGE_ENCODE };
+#define NUM_COUNTED_STAGES (int)(sizeof(countedStages) / sizeof(countedStages[0]))
+
+// writes numerator / denominator, or no value if the denominator is 0 because
+// nothing was counted
+void writeRatio(Metrics* metrics, const char* key, unsigned long long numerator, unsigned long long denominator) {
+    writeKey(metrics, key, 0);
+    if (denominator != 0) {
+        fprintf(metrics->file, "%.4f", (double)numerator / denominator);
+    }
+    else if (!metrics->isCsv) {
+        fprintf(metrics->file, "null");
+    }
+}
+
+// creates the metrics file, csv files start with the names of the fields
+Metrics* openMetrics(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("ERROR: could not create metrics file %s\n", path);
+        return NULL;
+    }
+
+    Metrics* metrics = malloc(sizeof(Metrics));
+    metrics->file = file;
+    metrics->isCsv = isExtension((char*)path, "csv");
+    initMutex(&metrics->lock);
+
+    if (metrics->isCsv) {
+        fprintf(file, "path,format,width,height,bitsPerSample,strips,status,failure,backend,bytesRead,"
+            "bytesWritten,memoryEstimate,peakMemory,totalMs");
+        // scanning is done once for the whole batch, not per image
+        for (int i = STAGE_PROBE; i < NUM_STAGES; i++) {
+            fprintf(file, ",%sMs", getStageName((Stage)i));
+        }
+        for (int i = 0; i < NUM_COUNTED_STAGES; i++) {
+            const char* name = getStageName(countedStages[i]);
+            fprintf(file, ",%sIpc,%sCacheMissesPerPixel,%sBranchMissesPerPixel", name, name, name);
+        }
+        fputc('\n', file);
+    }
+
+    return metrics;
+}
+
+// appends the record of an image
+void writeMetrics(Metrics* metrics, const ImageMetrics* image) {
+    const StageTimes* stages = &image->timing->stages;
+    unsigned long long peakMemory = getPeakMemory();
+
+    lockMutex(&metrics->lock);
+    FILE* file = metrics->file;
+    if (!metrics->isCsv) {
+        fputc('{', file);
+    }
+    writeKey(metrics, "path", 1);
+    writeString(metrics, image->imagePath);
+    writeKey(metrics, "format", 0);
+    writeString(metrics, getFormatName(image->imagePath));
+    writeKey(metrics, "width", 0);
+    fprintf(file, "%d", image->width);
+    writeKey(metrics, "height", 0);
+    fprintf(file, "%d", image->height);
+    writeKey(metrics, "bitsPerSample", 0);
+    fprintf(file, "%d", image->bitsPerSample);
+    writeKey(metrics, "strips", 0);
+    fprintf(file, "%u", image->numStrips);
+    writeKey(metrics, "status", 0);
+    writeString(metrics, getStatusName(image->status));
+    writeKey(metrics, "failure", 0);
+    writeString(metrics, image->failure);
+    writeKey(metrics, "backend", 0);
+    writeString(metrics, getBackendName(getBackend()));
+    writeKey(metrics, "bytesRead", 0);
+    fprintf(file, "%llu", stages->bytes[STAGE_READ]);
+    writeKey(metrics, "bytesWritten", 0);
+    fprintf(file, "%llu", stages->bytes[STAGE_WRITE]);
+    writeKey(metrics, "memoryEstimate", 0);
+    fprintf(file, "%llu", image->memoryEstimate);
+    writeKey(metrics, "peakMemory", 0);
+    fprintf(file, "%llu", peakMemory);
+    writeKey(metrics, "totalMs", 0);
+    fprintf(file, "%.3f", image->timing->totalTime * 1000);
+    for (int i = STAGE_PROBE; i < NUM_STAGES; i++) {
+        char key[32];
+        sprintf(key, "%sMs", getStageName((Stage)i));
+        writeKey(metrics, key, 0);
+        fprintf(file, "%.3f", stages->seconds[i] * 1000);
+    }
+    // empty unless the hardware counters were counting
+    for (int i = 0; i < NUM_COUNTED_STAGES; i++) {
+        const char* name = getStageName(countedStages[i]);
+        const CounterValues* counts = &stages->counters[countedStages[i]];
+        unsigned long long pixels = counts->values[COUNTER_CYCLES] != 0 ? stages->pixels[countedStages[i]] : 0;
+        char key[48];
+        sprintf(key, "%sIpc", name);
+        writeRatio(metrics, key, counts->values[COUNTER_INSTRUCTIONS], counts->values[COUNTER_CYCLES]);
+        sprintf(key, "%sCacheMissesPerPixel", name);
+        writeRatio(metrics, key, counts->values[COUNTER_CACHE_MISSES], pixels);
+        sprintf(key, "%sBranchMissesPerPixel", name);
+        writeRatio(metrics, key, counts->values[COUNTER_BRANCH_MISSES], pixels);
+    }
+    fputs(metrics->isCsv ? "\n" : "}\n", file);
+    // a dashboard following the file sees every image as soon as it is done
+    fflush(file);
+    unlockMutex(&metrics->lock);
+}
+
+// closes the file and frees the metrics
+int closeMetrics(Metrics* metrics) {
+    int result = ferror(metrics->file) ? -1 : 0;
+    if (fclose(metrics->file) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        printf("ERROR: could not write metrics file\n");
+    }
+
+    destroyMutex(&metrics->lock);
+    free(metrics);
+    return result;
+}
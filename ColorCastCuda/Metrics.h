@@ -0,0 +1,35 @@
+#ifndef COLORCAST_METRICS_H
+#define COLORCAST_METRICS_H
+
+#include "Pipeline.h"
+
+// everything recorded about a single image once it is done
+typedef struct {
+    const char* imagePath;
+    int width;                          // 0 if the image was not loaded
+    int height;
+    int bitsPerSample;
+    unsigned int numStrips;             // 0 for images that are not tiffs
+    ImageStatus status;
+    const char* failure;                // why it failed or was cancelled, "" if it was written
+    const ImageTiming* timing;
+    unsigned long long memoryEstimate;  // 0 without a memory budget
+} ImageMetrics;
+
+// a file with one record per image, for dashboards and finding slow files
+typedef struct Metrics Metrics;
+
+// creates the file at path. Records are comma separated values with a header line if
+// the path ends in .csv, and json objects one per line otherwise. returns NULL if the
+// file can not be created
+Metrics* openMetrics(const char* path);
+
+// appends the record of an image along with the backend and the peak memory of the
+// process so far. Safe to call from every pipeline thread
+void writeMetrics(Metrics* metrics, const ImageMetrics* image);
+
+// closes the file and frees the metrics. returns 0 on success, -1 if a record
+// could not be written
+int closeMetrics(Metrics* metrics);
+
+#endif //COLORCAST_METRICS_H
@@ -0,0 +1,344 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "File.h"
+#include "Jpeg.h"
+#include "Options.h"
+#include "Platform.h"
+
+// adds a path to the list of files to convert
+void addFile(Options* options, const char* path) {
+    options->files = realloc(options->files, (options->numFiles + 1) * sizeof(char*));
+    options->files[options->numFiles++] = _strdup(path);
+}
+
+// adds every line of the file list as a path, "-" reads the list from stdin.
+// returns 0 on success, -1 if the list can not be read
+int readFileList(Options* options, const char* listPath) {
+    FILE* list = strcmp(listPath, "-") == 0 ? stdin : fopen(listPath, "r");
+    if (list == NULL) {
+        printf("could not open file list: %s\n", listPath);
+        return -1;
+    }
+
+    char line[2048];
+    while (fgets(line, sizeof(line), list) != NULL) {
+        // strip the line ending, windows line endings included
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len > 0) {
+            addFile(options, line);
+        }
+    }
+
+    if (list != stdin) {
+        fclose(list);
+    }
+    return 0;
+}
+
+// returns true if the option is followed by a value
+int takesValue(const char* arg) {
+    const char* valueOptions[] = { "-i", "--input", "-o", "--output", "-p", "--power", "--backend", "--threads",
+        "--file-list", "--readers", "--workers", "--writers", "--queue-depth", "--mem",
+        "--strip-size", "--png-level", "--jpeg-quality", "--jpeg-subsampling", "--preview", "--serve", "--connect",
+        "--metrics", "--trace" };
+    for (int i = 0; i < (int)(sizeof(valueOptions) / sizeof(valueOptions[0])); i++) {
+        if (strcmp(arg, valueOptions[i]) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// adds the comma separated powers in list to the powers of the options.
+// returns 0 on success, -1 if a power is invalid
+int parsePowers(Options* options, const char* list) {
+    const char* start = list;
+    while (1) {
+        char* end;
+        double power = strtod(start, &end);
+        if (end == start || (*end != ',' && *end != '\0') || power < .1 || power > 15) {
+            printf("power must be a number from .1 to 15: %s\n", list);
+            return -1;
+        }
+        if (options->numPowers == MAX_POWERS) {
+            printf("at most %d powers can be given\n", MAX_POWERS);
+            return -1;
+        }
+
+        // the power is part of the output name with one decimal, so powers that
+        // round to the same name would overwrite each other
+        char name[16];
+        sprintf(name, "%04.1f", power);
+        for (int i = 0; i < options->numPowers; i++) {
+            char otherName[16];
+            sprintf(otherName, "%04.1f", options->powers[i]);
+            if (strcmp(name, otherName) == 0) {
+                printf("powers %g and %g have the same output name\n", options->powers[i], power);
+                return -1;
+            }
+        }
+        options->powers[options->numPowers++] = power;
+
+        if (*end == '\0') {
+            return 0;
+        }
+        start = end + 1;
+    }
+}
+
+// returns true if str is a whole number, sets value to it
+int parseInt(const char* str, int* value) {
+    char* end;
+    long result = strtol(str, &end, 10);
+    if (end == str || *end != '\0') {
+        return 0;
+    }
+
+    *value = (int)result;
+    return 1;
+}
+
+// fills in options from the command line, printing why an argument is invalid.
+// returns 0 on success, -1 if the arguments are invalid
+int parseOptions(int argc, char** argv, Options* options) {
+    memset(options, 0, sizeof(Options));
+    options->backend = BACKEND_AUTO;
+    options->pngLevel = 6;
+    options->jpegQuality = 95;
+    options->jpegSubsampling = SUBSAMPLING_444;
+    options->previewScale = 1;
+    getDefaultPipelineConfig(&options->pipeline);
+
+    for (int i = 1; i < argc; i++) {
+        char* arg = argv[i];
+        if (takesValue(arg) && i + 1 >= argc) {
+            printf("missing value for %s\n", arg);
+            return -1;
+        }
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            options->help = 1;
+        }
+        else if (strcmp(arg, "--gui") == 0) {
+            options->gui = 1;
+        }
+        else if (strcmp(arg, "--incremental") == 0) {
+            options->incremental = 1;
+        }
+        else if (strcmp(arg, "--watch") == 0) {
+            options->watch = 1;
+        }
+        else if (strcmp(arg, "--stream") == 0) {
+            options->stream = 1;
+        }
+        else if (strcmp(arg, "--serve") == 0) {
+            free(options->serveSocket);
+            options->serveSocket = _strdup(argv[++i]);
+        }
+        else if (strcmp(arg, "--metrics") == 0) {
+            free(options->metricsPath);
+            options->metricsPath = _strdup(argv[++i]);
+        }
+        else if (strcmp(arg, "--counters") == 0) {
+            options->counters = 1;
+        }
+        else if (strcmp(arg, "--trace") == 0) {
+            free(options->tracePath);
+            options->tracePath = _strdup(argv[++i]);
+        }
+        else if (strcmp(arg, "--connect") == 0) {
+            free(options->connectSocket);
+            options->connectSocket = _strdup(argv[++i]);
+        }
+        else if (strcmp(arg, "-i") == 0 || strcmp(arg, "--input") == 0) {
+            options->inputDir = _strdup(argv[++i]);
+        }
+        else if (strcmp(arg, "-r") == 0 || strcmp(arg, "--recursive") == 0) {
+            options->recursive = 1;
+        }
+        else if (strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) {
+            options->outputDir = _strdup(argv[++i]);
+        }
+        else if (strcmp(arg, "-p") == 0 || strcmp(arg, "--power") == 0) {
+            if (parsePowers(options, argv[++i]) != 0) {
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--backend") == 0) {
+            if (parseBackend(argv[++i], &options->backend) != 0) {
+                printf("unknown backend: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--threads") == 0) {
+            if (!parseInt(argv[++i], &options->numThreads) || options->numThreads <= 0) {
+                printf("invalid number of threads: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--readers") == 0 || strcmp(arg, "--workers") == 0 || strcmp(arg, "--writers") == 0
+            || strcmp(arg, "--queue-depth") == 0) {
+            int value;
+            if (!parseInt(argv[++i], &value) || value <= 0) {
+                printf("invalid value for %s: %s\n", arg, argv[i]);
+                return -1;
+            }
+
+            if (strcmp(arg, "--readers") == 0) {
+                options->pipeline.numReaders = value;
+            }
+            else if (strcmp(arg, "--workers") == 0) {
+                options->pipeline.numWorkers = value;
+            }
+            else if (strcmp(arg, "--writers") == 0) {
+                options->pipeline.numWriters = value;
+            }
+            else {
+                options->pipeline.depth = value;
+            }
+        }
+        else if (strcmp(arg, "--file-list") == 0) {
+            if (readFileList(options, argv[++i]) != 0) {
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--mem") == 0) {
+            options->pipeline.memoryBudget = parseByteSize(argv[++i]);
+            if (options->pipeline.memoryBudget == 0) {
+                printf("invalid memory budget: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--strip-size") == 0) {
+            unsigned long long stripSize = parseByteSize(argv[++i]);
+            options->stripSize = (unsigned int)stripSize;
+            // strips are addressed with 32 bit offsets
+            if (stripSize == 0 || stripSize > 0xFFFFFFFFULL) {
+                printf("invalid strip size: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--png-level") == 0) {
+            if (!parseInt(argv[++i], &options->pngLevel) || options->pngLevel < 0 || options->pngLevel > 9) {
+                printf("invalid png compression level: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--jpeg-quality") == 0) {
+            if (!parseInt(argv[++i], &options->jpegQuality) || options->jpegQuality < 1 || options->jpegQuality > 100) {
+                printf("invalid jpeg quality: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--jpeg-subsampling") == 0) {
+            int subsampling = 0;
+            parseInt(argv[++i], &subsampling);
+            if (subsampling != SUBSAMPLING_444 && subsampling != SUBSAMPLING_422 && subsampling != SUBSAMPLING_420) {
+                printf("invalid jpeg subsampling: %s\n", argv[i]);
+                return -1;
+            }
+            options->jpegSubsampling = subsampling;
+        }
+        else if (strcmp(arg, "--preview") == 0) {
+            if (!parseInt(argv[++i], &options->previewScale)
+                || (options->previewScale != 2 && options->previewScale != 4 && options->previewScale != 8)) {
+                printf("invalid preview scale: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (arg[0] == '-' && arg[1] != '\0') {
+            printf("unknown option: %s\n", arg);
+            return -1;
+        }
+        else {
+            // anything else is an image to convert
+            addFile(options, arg);
+        }
+    }
+
+    return 0;
+}
+
+// prints how to use the command line options of the program
+void printUsage(const char* programName) {
+    printf("usage: %s -o <dir> -p <powers> [-i <dir>] [options] [images...]\n\n", programName);
+    printf("  -i, --input <dir>                 directory of images to convert\n");
+    printf("  -r, --recursive                   also convert the images in subdirectories of the input\n");
+    printf("                                    directory, into the same subdirectories of the output\n");
+    printf("  -o, --output <dir>                directory the converted images are written to\n");
+    printf("  -p, --power <.1-15>[,...]         how much colors move to gray, .1 is completely gray,\n");
+    printf("                                    15 is almost no change. Up to %d comma separated\n", MAX_POWERS);
+    printf("                                    powers write an output for each from a single decode.\n");
+    printf("  --file-list <file>                file with one image path per line, - reads stdin\n");
+    printf("  --backend <auto|cuda|cpu>         where images are processed. Default auto uses the\n");
+    printf("                                    gpu if there is one.\n");
+    printf("  --threads <n>                     number of threads used by the cpu backend and the\n");
+    printf("                                    encoders. Default one per core.\n");
+    printf("  --readers <n>                     threads loading the next images. Default 2, or one\n");
+    printf("                                    per core with --mem.\n");
+    printf("  --workers <n>                     threads processing loaded images. Default 1.\n");
+    printf("  --writers <n>                     threads saving processed images. Default 2.\n");
+    printf("  --queue-depth <n>                 images that may wait between two of these stages\n");
+    printf("                                    before the earlier stage pauses. Default 2, or one\n");
+    printf("                                    per core with --mem.\n");
+    printf("  --mem <bytes>                     memory the images being converted may take up, for\n");
+    printf("                                    example 8G. Images are estimated from their headers,\n");
+    printf("                                    loaded largest first and only while they fit.\n");
+    printf("  --strip-size <bytes>              rewrite output tiffs into strips of roughly this size,\n");
+    printf("                                    for example 256K or 8M. Default keeps the input layout.\n");
+    printf("  --png-level <0-9>                 png compression, 0 stores, 1 is fastest, 9 is smallest.\n");
+    printf("                                    Default 6.\n");
+    printf("  --jpeg-quality <1-100>            jpeg quality. Default 95.\n");
+    printf("  --jpeg-subsampling <444|422|420>  jpeg chroma subsampling. Default 444.\n");
+    printf("  --preview <2|4|8>                 decode jpegs at 1/2, 1/4 or 1/8 of their size for a\n");
+    printf("                                    quick preview run. Needs the libjpeg-turbo build.\n");
+    printf("  --incremental                     skip images converted by an earlier run with the same\n");
+    printf("                                    input, power and settings. Runs are recorded in a\n");
+    printf("                                    .colorcast-manifest file in the output directory.\n");
+    printf("  --watch                           keep running after the input directory is converted and\n");
+    printf("                                    convert every image written or moved into it, until\n");
+    printf("                                    interrupted. Linux only.\n");
+    printf("  --stream                          convert a single ppm, tiff or png read from stdin and\n");
+    printf("                                    write it to stdout, in bands as it arrives where the\n");
+    printf("                                    format allows. Needs a single power and no paths.\n");
+    printf("  --serve <socket>                  keep the backend warm and convert the images other\n");
+    printf("                                    processes send to this unix socket, until interrupted.\n");
+    printf("                                    No other paths or powers are needed.\n");
+    printf("  --connect <socket>                convert the images on the server listening on this\n");
+    printf("                                    unix socket, printing their status as it changes\n");
+    printf("  --metrics <file>                  write a record of every image with its size, format,\n");
+    printf("                                    time per step, bytes, memory and why it failed to\n");
+    printf("                                    this file. Csv if it ends in .csv, json lines otherwise.\n");
+    printf("  --trace <file>                    write what every thread did when to this file at exit,\n");
+    printf("                                    for chrome://tracing or Perfetto. Needs a build with\n");
+    printf("                                    COLORCAST_TRACE defined.\n");
+    printf("  --counters                        add the instructions per cycle and the cache and branch\n");
+    printf("                                    misses per pixel of decode, kernel and encode to the\n");
+    printf("                                    metrics, counted by the cpu. Linux only.\n");
+    printf("  --gui                             ask for missing folders and power with dialogs and\n");
+    printf("                                    report the result in a popup\n");
+    printf("  -h, --help                        show this message\n\n");
+    printf("exit codes: 0 every image converted, 1 some images failed, 2 invalid arguments,\n");
+    printf("            3 no images to convert or the backend is not available\n");
+}
+
+// frees the memory held by the options
+void freeOptions(Options* options) {
+    for (int i = 0; i < options->numFiles; i++) {
+        free(options->files[i]);
+    }
+
+    free(options->files);
+    free(options->inputDir);
+    free(options->outputDir);
+    free(options->serveSocket);
+    free(options->connectSocket);
+    free(options->metricsPath);
+    free(options->tracePath);
+}
@@ -0,0 +1,46 @@
+#ifndef COLORCAST_OPTIONS_H
+#define COLORCAST_OPTIONS_H
+
+#include "Backend.h"
+#include "Pipeline.h"
+
+// everything that can be set on the command line
+typedef struct {
+    char* inputDir;             // directory of images to convert, NULL if not given
+    int recursive;              // also search the subdirectories of inputDir
+    char* outputDir;            // directory the results are written to, NULL if not given
+    char** files;               // images given on the command line or in a file list
+    int numFiles;
+    double powers[MAX_POWERS];  // how much colors move to gray, every image is converted with each
+    int numPowers;              // 0 if not given
+    Backend backend;
+    int numThreads;             // 0 uses one thread per core
+    PipelineConfig pipeline;
+    unsigned int stripSize;     // 0 keeps the strip layout of input tiffs
+    int pngLevel;
+    int jpegQuality;
+    int jpegSubsampling;
+    int previewScale;           // 1 decodes jpegs at full size
+    int incremental;            // skip images whose input and settings did not change since the last run
+    int watch;                  // keep converting images written into inputDir until interrupted
+    int stream;                 // convert a single image from stdin to stdout
+    char* serveSocket;          // serve requests on this unix socket, NULL if not given
+    char* connectSocket;        // convert the images on the server at this unix socket, NULL if not given
+    char* metricsPath;          // file every converted image is recorded in, NULL if not given
+    char* tracePath;            // file the trace of every thread is written to at exit, NULL if not given
+    int counters;               // count cycles, instructions and misses of decode, kernel and encode
+    int gui;                    // ask for missing settings with dialogs and report with popups
+    int help;
+} Options;
+
+// fills in options from the command line, printing why an argument is invalid.
+// returns 0 on success, -1 if the arguments are invalid
+int parseOptions(int argc, char** argv, Options* options);
+
+// prints how to use the command line options of the program
+void printUsage(const char* programName);
+
+// frees the memory held by the options
+void freeOptions(Options* options);
+
+#endif //COLORCAST_OPTIONS_H
@@ -0,0 +1,585 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Backend.h"
+#include "Clock.h"
+#include "Failure.h"
+#include "Handle.h"
+#include "Hash.h"
+#include "Metrics.h"
+#include "Pipeline.h"
+#include "Platform.h"
+#include "Thread.h"
+#include "Trace.h"
+
+// an image submitted to the pipeline
+typedef struct {
+    Job job;
+    double powers[MAX_POWERS];
+    int* result;                        // set to the outcome if not NULL
+    unsigned long long* inputHash;      // filled in by the reader if not NULL
+    unsigned long long memoryEstimate;  // 0 without a memory budget
+    ImageCallback callback;
+    CancelCheck isCancelled;
+    void* context;
+    ImageTiming timing;
+    double submitTime;
+    char failure[MAX_FAILURE_LENGTH];   // why the job failed, kept for the metrics
+} PipelineJob;
+
+// a bounded queue of jobs between two stages
+typedef struct {
+    PipelineJob** jobs;     // ring buffer of capacity jobs
+    int capacity;
+    int head;
+    int count;
+    int numProducers;       // threads of the previous stage still running
+    Mutex lock;
+    Condition notEmpty;
+    Condition notFull;
+} JobQueue;
+
+// state shared by every thread of a pipeline
+struct Pipeline {
+    unsigned int stripSize;
+    JobQueue submitted;
+    JobQueue loaded;
+    JobQueue processed;
+    Thread* threads;
+    int numThreads;
+    Mutex statsLock;
+    PipelineStats stats;
+    int numFailed;
+    unsigned long long memoryBudget;
+    Metrics* metrics;                   // NULL if no metrics are recorded
+    unsigned long long memoryInUse;     // estimates of the jobs in flight
+    Mutex memoryLock;
+    Condition memoryFreed;
+};
+
+void initQueue(JobQueue* queue, int capacity, int numProducers) {
+    queue->jobs = malloc(capacity * sizeof(PipelineJob*));
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->numProducers = numProducers;
+    initMutex(&queue->lock);
+    initCondition(&queue->notEmpty);
+    initCondition(&queue->notFull);
+}
+
+void destroyQueue(JobQueue* queue) {
+    free(queue->jobs);
+    destroyMutex(&queue->lock);
+    destroyCondition(&queue->notEmpty);
+    destroyCondition(&queue->notFull);
+}
+
+// adds a job to the queue, waiting while it is full so a fast stage can not
+// run ahead of a slow one and fill up memory
+void pushJob(JobQueue* queue, PipelineJob* job) {
+    lockMutex(&queue->lock);
+    if (queue->count == queue->capacity) {
+        TRACE_BEGIN("wait for queue space", NULL);
+        while (queue->count == queue->capacity) {
+            waitCondition(&queue->notFull, &queue->lock);
+        }
+        TRACE_END("wait for queue space");
+    }
+
+    queue->jobs[(queue->head + queue->count) % queue->capacity] = job;
+    queue->count++;
+    signalCondition(&queue->notEmpty);
+    unlockMutex(&queue->lock);
+}
+
+// takes the oldest job from the queue, waiting while it is empty.
+// returns NULL once the queue is empty and every producer has finished
+PipelineJob* popJob(JobQueue* queue) {
+    lockMutex(&queue->lock);
+    if (queue->count == 0 && queue->numProducers > 0) {
+        TRACE_BEGIN("wait for job", NULL);
+        while (queue->count == 0 && queue->numProducers > 0) {
+            waitCondition(&queue->notEmpty, &queue->lock);
+        }
+        TRACE_END("wait for job");
+    }
+
+    PipelineJob* job = NULL;
+    if (queue->count > 0) {
+        job = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        signalCondition(&queue->notFull);
+    }
+    unlockMutex(&queue->lock);
+
+    return job;
+}
+
+// called by each producer when it has no more jobs, the last one wakes every consumer
+void finishProducing(JobQueue* queue) {
+    lockMutex(&queue->lock);
+    queue->numProducers--;
+    if (queue->numProducers == 0) {
+        broadcastCondition(&queue->notEmpty);
+    }
+    unlockMutex(&queue->lock);
+}
+
+// adds seconds to one of the stage times
+void addTime(Pipeline* pipeline, double* stageTime, double seconds) {
+    lockMutex(&pipeline->statsLock);
+    *stageTime += seconds;
+    unlockMutex(&pipeline->statsLock);
+}
+
+// waits until the job fits in the memory budget next to the jobs in flight. A job
+// larger than the whole budget runs once nothing else is in flight
+void reserveMemory(Pipeline* pipeline, PipelineJob* job) {
+    if (pipeline->memoryBudget == 0) {
+        return;
+    }
+
+    lockMutex(&pipeline->memoryLock);
+    if (pipeline->memoryInUse > 0 && pipeline->memoryInUse + job->memoryEstimate > pipeline->memoryBudget) {
+        TRACE_BEGIN("wait for memory", job->job.imagePath);
+        while (pipeline->memoryInUse > 0 && pipeline->memoryInUse + job->memoryEstimate > pipeline->memoryBudget) {
+            waitCondition(&pipeline->memoryFreed, &pipeline->memoryLock);
+        }
+        TRACE_END("wait for memory");
+    }
+
+    pipeline->memoryInUse += job->memoryEstimate;
+    if (pipeline->memoryInUse > pipeline->stats.peakMemory) {
+        pipeline->stats.peakMemory = pipeline->memoryInUse;
+    }
+    unlockMutex(&pipeline->memoryLock);
+}
+
+// returns 1 if whoever submitted the job no longer wants it
+int isJobCancelled(PipelineJob* job) {
+    return job->isCancelled != NULL && job->isCancelled(job->context);
+}
+
+// keeps why a stage of the job failed, or which stage it was if nothing said why
+void keepFailure(PipelineJob* job, const char* stage) {
+    if (takeFailure(job->failure, sizeof(job->failure)) != 0) {
+        sprintf(job->failure, "could not be %s", stage);
+    }
+}
+
+// records what is known about the job in the metrics
+void recordMetrics(Pipeline* pipeline, PipelineJob* job, ImageStatus status) {
+    ImageMetrics metrics;
+    memset(&metrics, 0, sizeof(ImageMetrics));
+    metrics.imagePath = job->job.imagePath;
+    if (job->job.image != NULL) {
+        metrics.width = job->job.image->width;
+        metrics.height = job->job.image->height;
+        metrics.bitsPerSample = job->job.image->bitsPerSample;
+    }
+    else if (job->job.tiff != NULL) {
+        metrics.width = getWidth(job->job.tiff);
+        metrics.height = getHeight(job->job.tiff);
+        metrics.bitsPerSample = job->job.tiff->bitsPerSample;
+        metrics.numStrips = job->job.tiff->numStrips;
+    }
+    metrics.status = status;
+    metrics.failure = status == IMAGE_CANCELLED ? "cancelled" : job->failure;
+    metrics.timing = &job->timing;
+    metrics.memoryEstimate = job->memoryEstimate;
+    writeMetrics(pipeline->metrics, &metrics);
+}
+
+// records the outcome of a job, returns its memory to the budget and frees it
+void finishJob(Pipeline* pipeline, PipelineJob* job, ImageStatus status) {
+    int result = status == IMAGE_WRITTEN ? 0 : -1;
+    if (job->result != NULL) {
+        *job->result = result;
+    }
+    job->timing.totalTime = getMonotonicTime() - job->submitTime;
+    if (job->callback != NULL) {
+        job->callback(job->context, status, &job->timing);
+    }
+    if (pipeline->metrics != NULL) {
+        recordMetrics(pipeline, job, status);
+    }
+    lockMutex(&pipeline->statsLock);
+    addStageTimes(&pipeline->stats.stages, &job->timing.stages);
+    if (result != 0) {
+        pipeline->numFailed++;
+    }
+    unlockMutex(&pipeline->statsLock);
+
+    if (pipeline->memoryBudget > 0) {
+        lockMutex(&pipeline->memoryLock);
+        pipeline->memoryInUse -= job->memoryEstimate;
+        broadcastCondition(&pipeline->memoryFreed);
+        unlockMutex(&pipeline->memoryLock);
+    }
+
+    freeJob(&job->job);
+    free(job->job.imagePath);
+    for (int i = 0; i < job->job.numPowers; i++) {
+        free(job->job.outputPaths[i]);
+    }
+    free(job->job.outputPaths);
+    free(job);
+}
+
+// loads submitted images until the pipeline is finished
+void readStage(void* arg) {
+    Pipeline* pipeline = (Pipeline*)arg;
+    PipelineJob* job;
+    TRACE_THREAD_NAME("reader");
+
+    while ((job = popJob(&pipeline->submitted)) != NULL) {
+        if (isJobCancelled(job)) {
+            finishJob(pipeline, job, IMAGE_CANCELLED);
+            continue;
+        }
+
+        reserveMemory(pipeline, job);
+        if (job->callback != NULL) {
+            job->callback(job->context, IMAGE_STARTED, &job->timing);
+        }
+        printf("working on file: %s\n", job->job.imagePath);
+        recordStages(&job->timing.stages);
+        clearFailure();
+        double start = getMonotonicTime();
+        // the file is hashed right before it is loaded so loading reads it from the cache
+        if (job->inputHash != NULL && hashFile(job->job.imagePath, job->inputHash) != 0) {
+            *job->inputHash = 0;
+        }
+        TRACE_BEGIN("read", job->job.imagePath);
+        int result = loadJob(&job->job, pipeline->stripSize);
+        TRACE_END("read");
+        job->timing.readTime = getMonotonicTime() - start;
+        recordStages(NULL);
+        addTime(pipeline, &pipeline->stats.readTime, job->timing.readTime);
+
+        if (result != 0) {
+            keepFailure(job, "loaded");
+            finishJob(pipeline, job, IMAGE_FAILED);
+            continue;
+        }
+        // the pixels of a file are only known once it is read
+        job->timing.stages.pixels[STAGE_READ] += getJobPixels(&job->job);
+
+        pushJob(&pipeline->loaded, job);
+    }
+
+    finishProducing(&pipeline->loaded);
+}
+
+// processes loaded images until the readers are done
+void processStage(void* arg) {
+    Pipeline* pipeline = (Pipeline*)arg;
+    PipelineJob* job;
+    TRACE_THREAD_NAME("worker");
+
+    while ((job = popJob(&pipeline->loaded)) != NULL) {
+        if (isJobCancelled(job)) {
+            finishJob(pipeline, job, IMAGE_CANCELLED);
+            continue;
+        }
+
+        recordStages(&job->timing.stages);
+        clearFailure();
+        double start = getMonotonicTime();
+        TRACE_BEGIN("process", job->job.imagePath);
+        int result = processJob(&job->job, job->powers);
+        TRACE_END("process");
+        job->timing.processTime = getMonotonicTime() - start;
+        recordStages(NULL);
+        addTime(pipeline, &pipeline->stats.processTime, job->timing.processTime);
+
+        if (result != 0) {
+            keepFailure(job, "processed");
+            finishJob(pipeline, job, IMAGE_FAILED);
+            continue;
+        }
+
+        pushJob(&pipeline->processed, job);
+    }
+
+    finishProducing(&pipeline->processed);
+}
+
+// writes processed images until the workers are done
+void writeStage(void* arg) {
+    Pipeline* pipeline = (Pipeline*)arg;
+    PipelineJob* job;
+    TRACE_THREAD_NAME("writer");
+
+    while ((job = popJob(&pipeline->processed)) != NULL) {
+        if (isJobCancelled(job)) {
+            finishJob(pipeline, job, IMAGE_CANCELLED);
+            continue;
+        }
+
+        recordStages(&job->timing.stages);
+        clearFailure();
+        double start = getMonotonicTime();
+        TRACE_BEGIN("write", job->job.imagePath);
+        int result = writeJob(&job->job);
+        TRACE_END("write");
+        double end = getMonotonicTime();
+        recordStages(NULL);
+        if (result != 0) {
+            keepFailure(job, "written");
+        }
+        job->timing.writeTime = end - start;
+        addTime(pipeline, &pipeline->stats.writeTime, job->timing.writeTime);
+
+        finishJob(pipeline, job, result == 0 ? IMAGE_WRITTEN : IMAGE_FAILED);
+    }
+}
+
+// fills in the configuration used when nothing is given on the command line
+void getDefaultPipelineConfig(PipelineConfig* config) {
+    memset(config, 0, sizeof(PipelineConfig));
+}
+
+// replaces the numbers left at 0 in config. Processing and encoding already use
+// every core, so one worker is enough and a second reader and writer keep the
+// disk busy. With a memory budget deciding how many images are in flight there
+// can be a reader and a waiting image per core
+void resolveConfig(PipelineConfig* config) {
+    int defaultCount = config->memoryBudget > 0 ? getNumCores() : 2;
+    if (defaultCount < 2) {
+        defaultCount = 2;
+    }
+
+    if (config->numReaders == 0) {
+        config->numReaders = defaultCount;
+    }
+    if (config->numWorkers == 0) {
+        config->numWorkers = 1;
+    }
+    if (config->numWriters == 0) {
+        config->numWriters = 2;
+    }
+    if (config->depth == 0) {
+        config->depth = defaultCount;
+    }
+}
+
+// sets the fields of the request that are optional to none
+void initImageRequest(ImageRequest* request) {
+    memset(request, 0, sizeof(ImageRequest));
+}
+
+// starts count threads running stage after those already started. returns how many started
+int startStage(Pipeline* pipeline, ThreadMain stage, int count) {
+    int numStarted = 0;
+    for (int i = 0; i < count; i++) {
+        if (startThread(&pipeline->threads[pipeline->numThreads], stage, pipeline) == 0) {
+            pipeline->numThreads++;
+            numStarted++;
+        }
+    }
+
+    if (numStarted < count) {
+        printf("WARNING: started %d of %d threads of a stage\n", numStarted, count);
+    }
+    return numStarted;
+}
+
+// sets how many threads produce into a queue, waking its consumers if none are left
+void setProducers(JobQueue* queue, int numProducers) {
+    lockMutex(&queue->lock);
+    queue->numProducers = numProducers;
+    if (queue->numProducers == 0) {
+        broadcastCondition(&queue->notEmpty);
+    }
+    unlockMutex(&queue->lock);
+}
+
+// starts the threads of a pipeline that converts every submitted image
+Pipeline* startPipeline(unsigned int stripSize, const PipelineConfig* givenConfig) {
+    PipelineConfig config = *givenConfig;
+    resolveConfig(&config);
+
+    Pipeline* pipeline = calloc(1, sizeof(Pipeline));
+    pipeline->stripSize = stripSize;
+    pipeline->memoryBudget = config.memoryBudget;
+    pipeline->metrics = config.metrics;
+    // whoever submits is the only producer of the first queue
+    initQueue(&pipeline->submitted, config.depth, 1);
+    initQueue(&pipeline->loaded, config.depth, config.numReaders);
+    initQueue(&pipeline->processed, config.depth, config.numWorkers);
+    initMutex(&pipeline->statsLock);
+    initMutex(&pipeline->memoryLock);
+    initCondition(&pipeline->memoryFreed);
+
+    // a stage runs on the threads that could be started, its queue waits for only those
+    pipeline->numThreads = 0;
+    pipeline->threads = malloc((config.numReaders + config.numWorkers + config.numWriters) * sizeof(Thread));
+    int numReaders = startStage(pipeline, readStage, config.numReaders);
+    setProducers(&pipeline->loaded, numReaders);
+    int numWorkers = startStage(pipeline, processStage, config.numWorkers);
+    setProducers(&pipeline->processed, numWorkers);
+    int numWriters = startStage(pipeline, writeStage, config.numWriters);
+
+    if (numReaders == 0 || numWorkers == 0 || numWriters == 0) {
+        printf("ERROR: can not start the threads of the pipeline\n");
+        PipelineStats stats;
+        finishPipeline(pipeline, &stats);
+        return NULL;
+    }
+
+    return pipeline;
+}
+
+// queues an image, waiting while the readers are behind
+void submitImage(Pipeline* pipeline, const ImageRequest* request) {
+    PipelineJob* job = calloc(1, sizeof(PipelineJob));
+    job->job.imagePath = _strdup(request->imagePath);
+    job->job.numPowers = request->numPowers;
+    job->job.outputPaths = malloc(request->numPowers * sizeof(char*));
+    for (int i = 0; i < request->numPowers; i++) {
+        job->job.outputPaths[i] = _strdup(request->outputPaths[i]);
+        job->powers[i] = request->powers[i];
+    }
+
+    // an image only succeeds once it has been written
+    job->result = request->result;
+    if (job->result != NULL) {
+        *job->result = -1;
+    }
+    job->inputHash = request->inputHash;
+    if (pipeline->memoryBudget > 0 && request->memoryEstimate != 0) {
+        job->memoryEstimate = request->memoryEstimate;
+    }
+    else if (pipeline->memoryBudget > 0) {
+        double start = getMonotonicTime();
+        job->memoryEstimate = estimateJobMemory(job->job.imagePath, pipeline->stripSize, request->numPowers);
+        job->timing.stages.seconds[STAGE_PROBE] = getMonotonicTime() - start;
+    }
+    job->callback = request->callback;
+    job->isCancelled = request->isCancelled;
+    job->context = request->context;
+    job->submitTime = getMonotonicTime();
+
+    pushJob(&pipeline->submitted, job);
+}
+
+// waits for every submitted image to be written, stops the threads and frees the
+// pipeline. returns the number of images that failed
+int finishPipeline(Pipeline* pipeline, PipelineStats* stats) {
+    finishProducing(&pipeline->submitted);
+    for (int i = 0; i < pipeline->numThreads; i++) {
+        joinThread(&pipeline->threads[i]);
+    }
+
+    int numFailed = pipeline->numFailed;
+    *stats = pipeline->stats;
+
+    free(pipeline->threads);
+    destroyQueue(&pipeline->submitted);
+    destroyQueue(&pipeline->loaded);
+    destroyQueue(&pipeline->processed);
+    destroyMutex(&pipeline->statsLock);
+    destroyMutex(&pipeline->memoryLock);
+    destroyCondition(&pipeline->memoryFreed);
+    free(pipeline);
+
+    return numFailed;
+}
+
+// the memory estimates of a batch, filled in by runParallel
+typedef struct {
+    char** imagePaths;
+    unsigned long long* memoryEstimates;
+    unsigned int stripSize;
+    int numPowers;
+} EstimateJob;
+
+// estimates the memory of one image
+void estimateTask(void* context, int index) {
+    EstimateJob* job = (EstimateJob*)context;
+    job->memoryEstimates[index] = estimateJobMemory(job->imagePaths[index], job->stripSize, job->numPowers);
+}
+
+// an image and its estimated memory, sorted to decide the order images are submitted in
+typedef struct {
+    unsigned long long memoryEstimate;
+    int index;
+} ScheduledJob;
+
+// orders images from the largest estimate to the smallest
+int compareEstimates(const void* a, const void* b) {
+    const ScheduledJob* jobA = (const ScheduledJob*)a;
+    const ScheduledJob* jobB = (const ScheduledJob*)b;
+    if (jobA->memoryEstimate != jobB->memoryEstimate) {
+        return jobA->memoryEstimate > jobB->memoryEstimate ? -1 : 1;
+    }
+
+    // keep the order of the input for equal sizes
+    return jobA->index - jobB->index;
+}
+
+// converts imagePaths[i] with every power, writing the result of powers[j] to
+// outputPaths[i * numPowers + j]. results[i] is set to 0 if the image was converted
+// and -1 if it failed. If inputHashes is not NULL readers also fill it in with the
+// hash of each input file. returns the number of failed images
+int runPipeline(char** imagePaths, char** outputPaths, int numImg, const double* powers, int numPowers,
+    unsigned int stripSize, const PipelineConfig* config, int* results, unsigned long long* inputHashes,
+    PipelineStats* stats) {
+    ScheduledJob* schedule = malloc(numImg * sizeof(ScheduledJob));
+    for (int i = 0; i < numImg; i++) {
+        schedule[i].memoryEstimate = 0;
+        schedule[i].index = i;
+    }
+
+    double probeTime = 0;
+    if (config->memoryBudget > 0) {
+        // the headers are probed in parallel, which matters on network file systems
+        double start = getMonotonicTime();
+        EstimateJob estimates;
+        estimates.imagePaths = imagePaths;
+        estimates.memoryEstimates = malloc(numImg * sizeof(unsigned long long));
+        estimates.stripSize = stripSize;
+        estimates.numPowers = numPowers;
+        runParallel(estimateTask, &estimates, numImg);
+        probeTime = getMonotonicTime() - start;
+
+        // the largest images go first so the small ones fill in the gaps at the end
+        for (int i = 0; i < numImg; i++) {
+            schedule[i].memoryEstimate = estimates.memoryEstimates[i];
+        }
+        qsort(schedule, numImg, sizeof(ScheduledJob), compareEstimates);
+        free(estimates.memoryEstimates);
+    }
+
+    Pipeline* pipeline = startPipeline(stripSize, config);
+    if (pipeline == NULL) {
+        for (int i = 0; i < numImg; i++) {
+            results[i] = -1;
+        }
+        free(schedule);
+        memset(stats, 0, sizeof(PipelineStats));
+        stats->stages.seconds[STAGE_PROBE] = probeTime;
+        return numImg;
+    }
+    for (int i = 0; i < numImg; i++) {
+        int index = schedule[i].index;
+        ImageRequest request;
+        initImageRequest(&request);
+        request.imagePath = imagePaths[index];
+        request.outputPaths = outputPaths + index * numPowers;
+        request.powers = powers;
+        request.numPowers = numPowers;
+        request.result = &results[index];
+        request.inputHash = inputHashes == NULL ? NULL : &inputHashes[index];
+        request.memoryEstimate = schedule[i].memoryEstimate;
+        submitImage(pipeline, &request);
+    }
+    free(schedule);
+
+    int numFailed = finishPipeline(pipeline, stats);
+    stats->stages.seconds[STAGE_PROBE] += probeTime;
+    return numFailed;
+}
@@ -0,0 +1,100 @@
+#ifndef COLORCAST_PIPELINE_H
+#define COLORCAST_PIPELINE_H
+
+#include "Stage.h"
+
+// images are converted by a pipeline of three stages connected by bounded queues:
+// readers load the next images while workers process and writers save earlier
+// ones, so disk and compute are busy at the same time.
+
+// how many threads run each stage and how many images may wait between stages.
+// 0 lets runPipeline choose
+typedef struct {
+    int numReaders;
+    int numWorkers;
+    int numWriters;
+    int depth;                          // a stage blocks once this many images wait for the next one
+    unsigned long long memoryBudget;    // bytes the images in flight may take up, 0 for no limit
+    struct Metrics* metrics;            // every finished image is recorded here, may be NULL
+} PipelineConfig;
+
+// seconds each stage was busy, summed over its threads
+typedef struct {
+    double readTime;
+    double processTime;
+    double writeTime;
+    unsigned long long peakMemory;  // most estimated bytes in flight at once
+    StageTimes stages;  // the steps within the stages summed over every image
+} PipelineStats;
+
+// a running pipeline, its threads wait for images until finishPipeline
+typedef struct Pipeline Pipeline;
+
+// how far a submitted image got
+typedef enum {
+    IMAGE_STARTED,      // a reader began loading it
+    IMAGE_WRITTEN,      // every output was written
+    IMAGE_FAILED,
+    IMAGE_CANCELLED
+} ImageStatus;
+
+// seconds a single image spent in each stage and from submission until it was done
+typedef struct {
+    double readTime;
+    double processTime;
+    double writeTime;
+    double totalTime;
+    StageTimes stages;  // the steps within the stages
+} ImageTiming;
+
+// called by a pipeline thread when an image changes status. IMAGE_WRITTEN,
+// IMAGE_FAILED and IMAGE_CANCELLED are final and reported exactly once
+typedef void (*ImageCallback)(void* context, ImageStatus status, const ImageTiming* timing);
+
+// called by pipeline threads before each stage, an image is dropped once it returns non zero
+typedef int (*CancelCheck)(void* context);
+
+// an image to convert and how the pipeline reports back on it
+typedef struct {
+    const char* imagePath;
+    char** outputPaths;                 // one per power
+    const double* powers;
+    int numPowers;
+    int* result;                        // set to 0 once written and -1 otherwise, may be NULL
+    unsigned long long* inputHash;      // filled in with the hash of the input file, may be NULL
+    unsigned long long memoryEstimate;  // 0 lets the pipeline estimate it when there is a budget
+    ImageCallback callback;             // may be NULL
+    CancelCheck isCancelled;            // may be NULL
+    void* context;                      // passed to callback and isCancelled
+} ImageRequest;
+
+// fills in the configuration used when nothing is given on the command line
+void getDefaultPipelineConfig(PipelineConfig* config);
+
+// sets the fields of the request that are optional to none
+void initImageRequest(ImageRequest* request);
+
+// starts the threads of a pipeline that converts every submitted image. returns NULL
+// if a stage could not start any thread
+Pipeline* startPipeline(unsigned int stripSize, const PipelineConfig* config);
+
+// queues an image, waiting while the readers are behind. The paths and powers of
+// the request are copied
+void submitImage(Pipeline* pipeline, const ImageRequest* request);
+
+// waits for every submitted image, stops the threads and frees the pipeline.
+// returns the number of failed images
+int finishPipeline(Pipeline* pipeline, PipelineStats* stats);
+
+// converts imagePaths[i] with every power, writing the result of powers[j] to
+// outputPaths[i * numPowers + j]. Each image is decoded once and processed for all
+// powers in one pass. results[i] is set to 0 if the image was converted and -1 if
+// it failed. With a memory budget the
+// largest images go first and an image is only loaded once it fits in the budget
+// next to those in flight. If inputHashes is not NULL readers also fill it in with
+// the hash of each input file. returns the number of failed images
+int runPipeline(char** imagePaths, char** outputPaths, int numImg, const double* powers, int numPowers,
+    unsigned int stripSize, const PipelineConfig* config, int* results, unsigned long long* inputHashes,
+    PipelineStats* stats);
+
+#endif //COLORCAST_PIPELINE_H
@@ -0,0 +1,19 @@
+#ifndef COLORCAST_PLATFORM_H
+#define COLORCAST_PLATFORM_H
+
+// small differences between the windows c runtime and posix
+
+#ifdef _WIN32
+#include <direct.h>
+#define PATH_SEPARATOR "\\"
+#else
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define _strdup strdup
+#define _getcwd getcwd
+#define _mkdir(path) mkdir(path, 0777)
+#define PATH_SEPARATOR "/"
+#endif
+
+#endif //COLORCAST_PLATFORM_H
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Buffer.h"
+#include "ByteOrdering.h"
+#include "Clock.h"
+#include "Deflate.h"
+#include "Failure.h"
+#include "Png.h"
+#include "Stage.h"
+#include "Thread.h"
+#include "Trace.h"
+
+// bands are made at least this large so the sync flushes between them cost little
+#define MIN_BAND_BYTES (128 * 1024)
+// number of bands per thread, more bands even out the work between threads
+#define BANDS_PER_THREAD 4
+
+// state shared by the threads writing one png
+typedef struct {
+    unsigned char* pix;
+    unsigned char* filtered;        // filter byte followed by the filtered row, for every row
+    unsigned int* crcTable;
+    int height;
+    size_t rowLen;                  // bytes in a row of pixels
+    int bytesPerPixel;
+    int swapBytes;                  // whether 16 bit samples must be swapped to big endian
+    int filter;
+    int level;
+    int rowsPerBand;
+    int numBands;
+    Buffer* bands;                  // compressed data of each band
+    unsigned int* adlers;           // adler-32 of the filtered bytes of each band
+    unsigned int* crcs;             // crc of the IDAT chunk holding each band
+} PngJob;
+
+// fills in the table used to compute crc-32 checksums
+void buildCrcTable(unsigned int* table) {
+    for (unsigned int n = 0; n < 256; n++) {
+        unsigned int c = n;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+    }
+}
+
+// updates a crc-32 checksum with the given bytes, start with a crc of 0
+unsigned int updateCrc(const unsigned int* table, unsigned int crc, const unsigned char* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+// the paeth predictor from the png specification
+unsigned char paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    if (pb <= pc) {
+        return b;
+    }
+    return c;
+}
+
+// copies a row of pixels into out with every 16 bit sample swapped to big endian
+void swapRow(PngJob* job, int row, unsigned char* out) {
+    unsigned char* cur = job->pix + row * job->rowLen;
+    for (size_t i = 0; i < job->rowLen; i += 2) {
+        out[i] = cur[i + 1];
+        out[i + 1] = cur[i];
+    }
+}
+
+// filters one row of pixels into out, the first byte of out is the filter type.
+// prev is the row above or NULL for the first row.
+void filterRow(PngJob* job, unsigned char* cur, unsigned char* prev, unsigned char* out) {
+    size_t bpp = job->bytesPerPixel;
+
+    out[0] = job->filter;
+    out++;
+
+    for (size_t i = 0; i < job->rowLen; i++) {
+        int left = i >= bpp ? cur[i - bpp] : 0;
+        int up = prev != NULL ? prev[i] : 0;
+        int upLeft = prev != NULL && i >= bpp ? prev[i - bpp] : 0;
+
+        switch (job->filter) {
+        case 1:
+            out[i] = cur[i] - left;
+            break;
+        case 4:
+            out[i] = cur[i] - paeth(left, up, upLeft);
+            break;
+        default:
+            out[i] = cur[i];
+            break;
+        }
+    }
+}
+
+// filters every row of a band
+void filterBand(void* context, int band) {
+    PngJob* job = context;
+    int firstRow = band * job->rowsPerBand;
+    int lastRow = firstRow + job->rowsPerBand > job->height ? job->height : firstRow + job->rowsPerBand;
+
+    TRACE_BEGIN("filter band", NULL);
+    if (!job->swapBytes) {
+        for (int row = firstRow; row < lastRow; row++) {
+            unsigned char* cur = job->pix + row * job->rowLen;
+            unsigned char* prev = row > 0 ? cur - job->rowLen : NULL;
+            filterRow(job, cur, prev, job->filtered + row * (job->rowLen + 1));
+        }
+        TRACE_END("filter band");
+        return;
+    }
+
+    // filters work on the bytes as stored in the file, so 16 bit rows are swapped
+    // to big endian first. This is where the only byte swap of the 16 bit path happens.
+    unsigned char* cur = malloc(job->rowLen);
+    unsigned char* prev = malloc(job->rowLen);
+    if (firstRow > 0) {
+        swapRow(job, firstRow - 1, prev);
+    }
+    for (int row = firstRow; row < lastRow; row++) {
+        swapRow(job, row, cur);
+        filterRow(job, cur, row > 0 ? prev : NULL, job->filtered + row * (job->rowLen + 1));
+
+        unsigned char* temp = prev;
+        prev = cur;
+        cur = temp;
+    }
+    free(cur);
+    free(prev);
+    TRACE_END("filter band");
+}
+
+// compresses the filtered rows of a band. Every band but the last ends with a
+// sync flush so the compressed bands can be written one after another.
+void compressBand(void* context, int band) {
+    PngJob* job = context;
+    size_t filteredRowLen = job->rowLen + 1;
+    size_t start = band * job->rowsPerBand * filteredRowLen;
+    size_t end = start + job->rowsPerBand * filteredRowLen;
+    size_t totalLen = job->height * filteredRowLen;
+    if (end > totalLen) {
+        end = totalLen;
+    }
+    int isLast = band == job->numBands - 1;
+
+    TRACE_BEGIN("compress band", NULL);
+    Buffer* out = &job->bands[band];
+    initBuffer(out, (end - start) / 2);
+    if (band == 0) {
+        // zlib header, deflate with a 32K window and the matching compression level flag
+        unsigned char levelFlags = job->level <= 1 ? 0x01 : job->level <= 5 ? 0x5e : job->level == 6 ? 0x9c : 0xda;
+        appendByte(out, 0x78);
+        appendByte(out, levelFlags);
+    }
+
+    deflateBand(job->filtered, start, end, job->level, isLast, out);
+    job->adlers[band] = adler32(1, job->filtered + start, end - start);
+
+    if (!isLast) {
+        // the last band still needs the adler-32 of the whole stream appended
+        job->crcs[band] = updateCrc(job->crcTable, updateCrc(job->crcTable, 0, (unsigned char*)"IDAT", 4), out->data, out->len);
+    }
+    TRACE_END("compress band");
+}
+
+// writes a 4 byte big endian integer
+void writeInt(FILE* file, unsigned int value) {
+    unsigned char bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+    fwrite(bytes, 1, 4, file);
+}
+
+// writes a png chunk of the given type, crc is the checksum of the type and data
+void writeChunk(FILE* file, const char* type, const unsigned char* data, size_t len, unsigned int crc) {
+    writeInt(file, len);
+    fwrite(type, 1, 4, file);
+    fwrite(data, 1, len, file);
+    writeInt(file, crc);
+}
+
+// writes 8 or 16 bit rgb pixels as a png to an open file. 16 bit samples are in the
+// byte order of the machine. returns 0 on success, -1 on failure
+int writePngFile(FILE* file, unsigned char* pix, int width, int height, int bitDepth, int level) {
+    CounterValues startCounts;
+    readCounters(&startCounts);
+    double start = getMonotonicTime();
+    unsigned int crcTable[256];
+    buildCrcTable(crcTable);
+
+    PngJob job;
+    job.pix = pix;
+    job.height = height;
+    job.bytesPerPixel = 3 * bitDepth / 8;
+    job.swapBytes = bitDepth == 16 && isHostLittleEndian();
+    job.rowLen = (size_t)width * job.bytesPerPixel;
+    job.level = level < 0 ? 0 : level > 9 ? 9 : level;
+    job.crcTable = crcTable;
+    // stored data gains nothing from filtering, for the fast levels the cheap sub
+    // filter is used and paeth for the rest, which does best on photos. Trying
+    // every filter for every row is not worth the time.
+    job.filter = job.level == 0 ? 0 : job.level <= 3 ? 1 : 4;
+
+    int rowsPerBand = (height + getNumThreads() * BANDS_PER_THREAD - 1) / (getNumThreads() * BANDS_PER_THREAD);
+    int minRows = (int)(MIN_BAND_BYTES / (job.rowLen + 1)) + 1;
+    job.rowsPerBand = rowsPerBand < minRows ? minRows : rowsPerBand;
+    job.numBands = (height + job.rowsPerBand - 1) / job.rowsPerBand;
+    if (job.numBands == 0) {
+        job.numBands = 1;
+    }
+
+    job.filtered = malloc(height * (job.rowLen + 1));
+    job.bands = malloc(job.numBands * sizeof(Buffer));
+    job.adlers = malloc(job.numBands * sizeof(unsigned int));
+    job.crcs = malloc(job.numBands * sizeof(unsigned int));
+    if (job.filtered == NULL || job.bands == NULL || job.adlers == NULL || job.crcs == NULL) {
+        reportFailure("not enough memory to write png");
+        free(job.filtered);
+        free(job.bands);
+        free(job.adlers);
+        free(job.crcs);
+        return -1;
+    }
+
+    // every band needs the filtered bytes of the band before it as dictionary,
+    // so all rows are filtered before compression starts
+    runParallel(filterBand, &job, job.numBands);
+    runParallel(compressBand, &job, job.numBands);
+
+    // finish the zlib stream with the adler-32 of all filtered bytes
+    unsigned int adler = job.adlers[0];
+    size_t bandLen = job.rowsPerBand * (job.rowLen + 1);
+    for (int i = 1; i < job.numBands; i++) {
+        size_t len = i == job.numBands - 1 ? height * (job.rowLen + 1) - i * bandLen : bandLen;
+        adler = adler32Combine(adler, job.adlers[i], len);
+    }
+    Buffer* last = &job.bands[job.numBands - 1];
+    unsigned char adlerBytes[4] = { adler >> 24, adler >> 16, adler >> 8, adler };
+    appendBytes(last, adlerBytes, 4);
+    job.crcs[job.numBands - 1] = updateCrc(crcTable, updateCrc(crcTable, 0, (unsigned char*)"IDAT", 4), last->data, last->len);
+
+    double encoded = getMonotonicTime();
+    addStageTime(STAGE_ENCODE, encoded - start, height * job.rowLen, (unsigned long long)width * height);
+    addStageCounters(STAGE_ENCODE, &startCounts);
+
+    int result = 0;
+    // the signature, the 12 bytes around every chunk and the 13 bytes of the header
+    size_t fileLen = 8 + 12 * (job.numBands + 2) + 13;
+    const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    fwrite(signature, 1, 8, file);
+
+    // width, height, bit depth, color type (rgb), compression, filter and interlace method
+    unsigned char header[17] = { 'I', 'H', 'D', 'R', width >> 24, width >> 16, width >> 8, width,
+        height >> 24, height >> 16, height >> 8, height, bitDepth, 2, 0, 0, 0 };
+    writeChunk(file, "IHDR", header + 4, 13, updateCrc(crcTable, 0, header, 17));
+
+    // each band is its own IDAT chunk, together they form one zlib stream
+    for (int i = 0; i < job.numBands; i++) {
+        writeChunk(file, "IDAT", job.bands[i].data, job.bands[i].len, job.crcs[i]);
+        fileLen += job.bands[i].len;
+    }
+
+    writeChunk(file, "IEND", NULL, 0, updateCrc(crcTable, 0, (unsigned char*)"IEND", 4));
+
+    if (fflush(file) != 0 || ferror(file)) {
+        reportFailure("could not write png");
+        result = -1;
+    }
+    addStageTime(STAGE_WRITE, getMonotonicTime() - encoded, fileLen, (unsigned long long)width * height);
+
+    for (int i = 0; i < job.numBands; i++) {
+        freeBuffer(&job.bands[i]);
+    }
+    free(job.filtered);
+    free(job.bands);
+    free(job.adlers);
+    free(job.crcs);
+
+    return result;
+}
+
+// writes 8 or 16 bit rgb pixels to a png file. 16 bit samples are in the byte order
+// of the machine. returns 0 on success, -1 on failure
+int writePng(char* path, unsigned char* pix, int width, int height, int bitDepth, int level) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        reportFailure("could not open output file");
+        return -1;
+    }
+
+    int result = writePngFile(file, pix, width, height, bitDepth, level);
+    fclose(file);
+    return result;
+}
@@ -0,0 +1,17 @@
+#ifndef COLORCAST_PNG_H
+#define COLORCAST_PNG_H
+
+#include <stdio.h>
+
+// writes 8 or 16 bit rgb pixels to a png file, 16 bit samples are in the byte
+// order of the machine. level 0 stores the pixels uncompressed, 1 is the fastest
+// and 9 the smallest compression. The rows are filtered and compressed in bands
+// on multiple threads, joined into a single zlib stream.
+// returns 0 on success, -1 on failure
+int writePng(char* path, unsigned char* pix, int width, int height, int bitDepth, int level);
+
+// like writePng, but writes the png to a file that is already open
+// returns 0 on success, -1 on failure
+int writePngFile(FILE* file, unsigned char* pix, int width, int height, int bitDepth, int level);
+
+#endif //COLORCAST_PNG_H
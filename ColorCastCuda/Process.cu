@@ -1,15 +1,25 @@
 #include <cuda_runtime.h>
 #include <cuda.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "device_launch_parameters.h"
 #include "cudart_platform.h"
 
 
 extern "C" {
-    #include "Image.h"
-    #include "Tiff.h"
+    #include "Backend.h"
+    #include "Clock.h"
+    #include "Failure.h"
+    #include "Process.h"
+    #include "Stage.h"
 }
 
+// the powers of one pass of the kernel, passed to it by value
+typedef struct {
+    double values[MAX_POWERS];
+    int count;
+} PowerList;
+
 // code adapted from: https://stackoverflow.com/questions/5731863/mapping-a-numeric-range-onto-another
 // maps a given value in one range into another range
 __device__ double mapDouble(double input, double input_start, double input_end, double output_start, double output_end) {
@@ -46,11 +56,13 @@ __device__ int dampenColor(int col, double avg, double grayness, double power) {
     return col + (int) rint(change);
 }
 
-// thread responsible for processing one pixel of the image
+// thread responsible for processing one pixel of the image once for every power. The result of
+// power i is written to data + i * outputStride, so the first power is processed in place.
 // bytesPerChannel specifies whether file store rgb values in 8 or 16 bit integers.
 // max is the pointer 1 after the end of the pixel data. Becaue each thread block has a fixed number of threads
 // there is one block that will have excces threads. It is necessary to make sure these threads do nothing. 
-__global__ void processPixel(unsigned char* data, unsigned int offset, double power, int bytesPerChannel, int isLittle, unsigned int max) {
+__global__ void processPixel(unsigned char* data, size_t outputStride, PowerList powers, unsigned int offset,
+    int bytesPerChannel, int isLittle, unsigned int max) {
     unsigned int pixelNum = threadIdx.x + blockIdx.x * blockDim.x;
     unsigned int startPtr = offset + (pixelNum * 3 * bytesPerChannel);
     // check to make sure startPtr is a valid pointer to pixel data
@@ -95,194 +107,232 @@ __global__ void processPixel(unsigned char* data, unsigned int offset, double po
         
         // calculates the average rgb value of the color
         double avg = (double) (red + green + blue) / 3;
-        // returns the nomalized color by "dampening" the rgb values individually
-        red = dampenColor(red, avg, grayness, power);
-        green = dampenColor(green, avg, grayness, power);
-        blue = dampenColor(blue, avg, grayness, power);
-        // set processed rgb values back out to gpu global memory
-        if (bytesPerChannel == 1) {
-            data[startPtr] = red;
-            data[startPtr + bytesPerChannel] = green;
-            data[startPtr + (bytesPerChannel * 2)] = blue;
-        }
-        else if (isLittle) {
-            // little endian 16 bit
-            data[startPtr] = red;
-            data[startPtr + 1] = red >> 8;
-            data[startPtr + 2] = green;
-            data[startPtr + 3] = green >> 8;
-            data[startPtr + 4] = blue;
-            data[startPtr + 5] = blue >> 8;
+        // the grayness and average are shared by every power, only the dampening differs
+        for (int i = 0; i < powers.count; i++) {
+            // returns the nomalized color by "dampening" the rgb values individually
+            int r = dampenColor(red, avg, grayness, powers.values[i]);
+            int g = dampenColor(green, avg, grayness, powers.values[i]);
+            int b = dampenColor(blue, avg, grayness, powers.values[i]);
+            unsigned char* out = data + (size_t)i * outputStride;
+            // set processed rgb values back out to gpu global memory
+            if (bytesPerChannel == 1) {
+                out[startPtr] = r;
+                out[startPtr + 1] = g;
+                out[startPtr + 2] = b;
+            }
+            else if (isLittle) {
+                // little endian 16 bit
+                out[startPtr] = r;
+                out[startPtr + 1] = r >> 8;
+                out[startPtr + 2] = g;
+                out[startPtr + 3] = g >> 8;
+                out[startPtr + 4] = b;
+                out[startPtr + 5] = b >> 8;
+            }
+            else {
+                // big endian 16 bit
+                out[startPtr] = r >> 8;
+                out[startPtr + 1] = r;
+                out[startPtr + 2] = g >> 8;
+                out[startPtr + 3] = g;
+                out[startPtr + 4] = b >> 8;
+                out[startPtr + 5] = b;
+            }
         }
-        else {
-            // big endian 16 bit
-            data[startPtr] = red >> 8;
-            data[startPtr + 1] = red;
-            data[startPtr + 2] = green >> 8;
-            data[startPtr + 3] = green;
-            data[startPtr + 4] = blue >> 8;
-            data[startPtr + 5] = blue;
-        }
-        
     }
 }
 
-// processes any image on the gpu that is not a tiff
-// copies over pixel data to gpu and creates a thread for every pixel
-int handleImage(char* imagePath, char* outputPath, double power) {
-    // load in the image
-    Image* img = getImage(imagePath);
-    const int NUM_CHANNELS = 3;
-    if (img == NULL) {
-        return -1;
+// returns the powers as the kernel takes them
+PowerList getPowerList(const double* powers, int numPowers) {
+    PowerList list;
+    list.count = numPowers;
+    for (int i = 0; i < numPowers; i++) {
+        list.values[i] = powers[i];
     }
 
-    unsigned char* d_pix;
-    unsigned int numPix = img->width * img->height;
-    // allocate memory on the gpu
-    cudaError_t err = cudaMalloc(&d_pix, numPix * NUM_CHANNELS * sizeof(char));
-    if (err != cudaSuccess) {
-        printf("Error on malloc %s\n", cudaGetErrorString(err));
-        return -1;
-    }
-    // copy over pixel data to gpu 
-    err = cudaMemcpy(d_pix, img->pix, numPix * NUM_CHANNELS * sizeof(char), cudaMemcpyHostToDevice);
-    if (err != cudaSuccess) {
-        printf("Error on memcopy htd %s\n", cudaGetErrorString(err));
-        return -1;
-    }
+    return list;
+}
 
-    int threadsPerBlock = 256;
-    int blocksPerGrid = (numPix + threadsPerBlock - 1) / threadsPerBlock;
-    // create threads on gpu to process each individual pixel
-    processPixel <<<blocksPerGrid, threadsPerBlock>>> (d_pix, 0, power, 1, 1, numPix * 3);
-    err = cudaGetLastError();
-    if (err != cudaSuccess) {
-        printf("Error on process pixels %s\n", cudaGetErrorString(err));
-        return -1;
-    }
-    // copy over pixel data from gpu to cpu
-    err = cudaMemcpy(img->pix, d_pix, numPix * NUM_CHANNELS * sizeof(char), cudaMemcpyDeviceToHost);
-    if (err != cudaSuccess) {
-        printf("Error on memcopy dth %s\n", cudaGetErrorString(err));
-        return -1;
-    }
-    // free memory on the gpu
-    err = cudaFree(d_pix);
-    if (err != cudaSuccess) {
-        printf("Error on free in main %s\n", cudaGetErrorString(err));
-        return -1;
+// copies every output of the kernel, each holding numPixels pixels, from the gpu into outputs
+int copyOutputs(unsigned char* d_pix, unsigned long outputLen, unsigned long long numPixels, unsigned char** outputs,
+    int numPowers) {
+    double start = getMonotonicTime();
+    for (int i = 0; i < numPowers; i++) {
+        cudaError_t err = cudaMemcpy(outputs[i], d_pix + (size_t)i * outputLen, outputLen, cudaMemcpyDeviceToHost);
+        if (err != cudaSuccess) {
+            reportFailure("could not copy the outputs from the gpu: %s", cudaGetErrorString(err));
+            return -1;
+        }
     }
-    // write image to output file
-    writeImage(img, outputPath);
-    // return 0 indicating success
+    addStageTime(STAGE_DOWNLOAD, getMonotonicTime() - start, (unsigned long long)outputLen * numPowers,
+        numPixels * numPowers);
+
     return 0;
 }
 
-// handles a single strip tiff. Copies over just the pixel data to the gpu
-// creates gpu thread for each pixel
-int handleSingleStrip(Tiff* tiff, double power, char* outputPath) {
-    unsigned long numPixels = getWidth(tiff) * getHeight(tiff);
-    unsigned long pixelStartOffset = tiff->stripOffsets[0];
-    unsigned int numBytes = tiff->bytesPerStrip[0];
+// returns true if there is a cuda capable gpu the kernel can run on
+int cudaIsAvailable() {
+    int numDevices = 0;
+    cudaError_t err = cudaGetDeviceCount(&numDevices);
+    return err == cudaSuccess && numDevices > 0;
+}
+
+// allocates numPowers copies of len bytes on the gpu, the first holding the input and
+// every one an output. returns NULL if they add up to more than the gpu has
+unsigned char* allocateOutputs(unsigned long len, int numPowers) {
+    size_t freeMem = 0;
+    size_t totalMem = 0;
+    // unsigned long is 32 bits on windows, so the total is computed in size_t and
+    // checked before it can wrap around into a short buffer
+    if (len > SIZE_MAX / numPowers || (cudaMemGetInfo(&freeMem, &totalMem) == cudaSuccess
+        && (size_t)len * numPowers > totalMem)) {
+        reportFailure("%d outputs of %lu bytes do not fit in the memory of the gpu", numPowers, len);
+        return NULL;
+    }
+
     unsigned char* d_pix;
-    // allocate space on gpu for pixel data of tiff
-    cudaError_t err = cudaMalloc(&d_pix, tiff->bytesPerStrip[0] * sizeof(char));
+    cudaError_t err = cudaMalloc(&d_pix, (size_t)len * numPowers);
     if (err != cudaSuccess) {
-        printf("Error on malloc %s\n", cudaGetErrorString(err));
-        return -1;
+        reportFailure("could not allocate memory on the gpu: %s", cudaGetErrorString(err));
+        return NULL;
     }
+
+    return d_pix;
+}
+
+// runs the kernel over the pixel data already in d_pix and copies back every output
+int processBufferOnDevice(unsigned char* d_pix, unsigned char* data, unsigned long numBytes, const double* powers,
+    unsigned char** outputs, int numPowers, int bytesPerChannel, int isLittle, double start) {
+    unsigned long numPixels = numBytes / (3 * bytesPerChannel);
     // copy over pixel data to gpu
-    err = cudaMemcpy(d_pix, tiff->data + pixelStartOffset, numBytes, cudaMemcpyHostToDevice);
+    cudaError_t err = cudaMemcpy(d_pix, data, numBytes, cudaMemcpyHostToDevice);
     if (err != cudaSuccess) {
-        printf("Error on memcopy htd %s\n", cudaGetErrorString(err));
+        reportFailure("could not copy the image to the gpu: %s", cudaGetErrorString(err));
         return -1;
     }
+    double uploaded = getMonotonicTime();
+    addStageTime(STAGE_UPLOAD, uploaded - start, numBytes, numPixels);
 
     int threadsPerBlock = 256;
     // creates enough blockes so there is one thread per pixel
     int blocksPerGrid = (numPixels + threadsPerBlock - 1) / threadsPerBlock;
-    int bytesPerChannel = tiff->bitsPerSample / 8;
-    int isLittle = tiff->isLittle;
     // create threads on gpu
-    processPixel <<<blocksPerGrid, threadsPerBlock>>> (d_pix, 0, power, bytesPerChannel, isLittle, numBytes);
-    // check for error on threads in gpu
+    processPixel <<<blocksPerGrid, threadsPerBlock>>> (d_pix, numBytes, getPowerList(powers, numPowers), 0,
+        bytesPerChannel, isLittle, numBytes);
+    // check for error on threads in gpu, waiting for the kernel so its time is its own
     err = cudaGetLastError();
+    if (err == cudaSuccess) {
+        err = cudaDeviceSynchronize();
+    }
     if (err != cudaSuccess) {
-        printf("Error on process pixels %s\n", cudaGetErrorString(err));
+        reportFailure("the kernel failed: %s", cudaGetErrorString(err));
         return -1;
     }
+    addStageTime(STAGE_KERNEL, getMonotonicTime() - uploaded, numBytes, numPixels);
     // copy processed pixel data from gpu to cpu
-    err = cudaMemcpy(tiff->data + pixelStartOffset, d_pix, numBytes * sizeof(char), cudaMemcpyDeviceToHost);
-    if (err != cudaSuccess) {
-        printf("Error on memcopy dth %s\n", cudaGetErrorString(err));
+    return copyOutputs(d_pix, numBytes, numPixels, outputs, numPowers);
+}
+
+// processes numBytes of contiguous rgb pixel data on the gpu once for every power. Copies
+// over just the pixel data to the gpu and creates a thread for every pixel
+int cudaProcessBuffer(unsigned char* data, unsigned long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle) {
+    double start = getMonotonicTime();
+    // space on gpu for the pixel data and one output per power, the first output is
+    // processed in place
+    unsigned char* d_pix = allocateOutputs(numBytes, numPowers);
+    if (d_pix == NULL) {
         return -1;
     }
-    // free memory on gpu
-    err = cudaFree(d_pix);
+
+    // the gpu memory is freed however processing ends, a server would run out of it otherwise
+    int result = processBufferOnDevice(d_pix, data, numBytes, powers, outputs, numPowers, bytesPerChannel, isLittle,
+        start);
+    cudaError_t err = cudaFree(d_pix);
     if (err != cudaSuccess) {
-        printf("Error on free in main %s\n", cudaGetErrorString(err));
+        reportFailure("could not free memory on the gpu: %s", cudaGetErrorString(err));
         return -1;
     }
-    // write tiff to output file
-    writeTiff(tiff, outputPath);
-    // return 0 indicating success
-    return 0;
+    return result;
 }
 
-// the handeling of multi stripped tiffs is handled separately because there is no guarantee that the strips will be 
-// placed continuously throughout the file so it faster to copy the entire file all at once to the gpu than copy over
-// each strip. This not does not make sense for singely stripped tiffs, where the pixels are guaranteed to be stored 
-// continuously in the file. creates thread for each pixel.
-int handleMultiStrips(Tiff* tiff, double power, char* outputPath) {
-    unsigned char* d_pix;
-
-    // malloc enough gpu memory for the entire tiff file
-    cudaError_t err = cudaMalloc(&d_pix, tiff->dataLen);
-    if (err != cudaSuccess) {
-        printf("Error on malloc %s\n", cudaGetErrorString(err));
-        return -1;
-    }
+// runs the kernel over every strip of the file already in d_pix and copies back every output
+int processStripsOnDevice(unsigned char* d_pix, unsigned char* data, unsigned long dataLen, unsigned int numStrips,
+    unsigned int* stripOffsets, unsigned int* bytesPerStrip, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle, double start) {
     // copy over entire tiff file to gpu
-    err = cudaMemcpy(d_pix, tiff->data, tiff->dataLen, cudaMemcpyHostToDevice);
+    cudaError_t err = cudaMemcpy(d_pix, data, dataLen, cudaMemcpyHostToDevice);
     if (err != cudaSuccess) {
-        printf("Error on memcopy htd %s\n", cudaGetErrorString(err));
+        reportFailure("could not copy the image to the gpu: %s", cudaGetErrorString(err));
         return -1;
     }
+    // the other copies start out as the file so everything but the strips is kept
+    for (int i = 1; i < numPowers; i++) {
+        err = cudaMemcpy(d_pix + (size_t)i * dataLen, d_pix, dataLen, cudaMemcpyDeviceToDevice);
+        if (err != cudaSuccess) {
+            reportFailure("could not copy on the gpu: %s", cudaGetErrorString(err));
+            return -1;
+        }
+    }
+    double uploaded = getMonotonicTime();
+    unsigned long long numBytes = 0;
+    for (int i = 0; i < numStrips; i++) {
+        numBytes += bytesPerStrip[i];
+    }
+    unsigned long long numPixels = numBytes / (3 * bytesPerChannel);
+    addStageTime(STAGE_UPLOAD, uploaded - start, dataLen, numPixels);
+
+    PowerList powerList = getPowerList(powers, numPowers);
     
-    int isLittle = tiff->isLittle;
-    int bytesPerChannel = tiff->bitsPerSample / 8;
     int threadsPerBlock = 256;
     // loop through each strip of the tiff 
-    for (int i = 0; i < tiff->numStrips; i++) {
-        int numPixelsInStrip = tiff->bytesPerStrip[i] / (3 * bytesPerChannel);
+    for (int i = 0; i < numStrips; i++) {
+        int numPixelsInStrip = bytesPerStrip[i] / (3 * bytesPerChannel);
         int blocksPerGrid = (numPixelsInStrip + threadsPerBlock - 1) / threadsPerBlock;
         // max pointer value of the strip
-        unsigned int max = tiff->stripOffsets[i] + tiff->bytesPerStrip[i];
+        unsigned int max = stripOffsets[i] + bytesPerStrip[i];
         // processPixel is an async call so the next strip can be setup relatively quickly
-        processPixel << <blocksPerGrid, threadsPerBlock >> > (d_pix, tiff->stripOffsets[i], power, bytesPerChannel, isLittle, max);
+        processPixel << <blocksPerGrid, threadsPerBlock >> > (d_pix, dataLen, powerList, stripOffsets[i], bytesPerChannel,
+            isLittle, max);
         // check for error while processing pixels
         err = cudaGetLastError();
         if (err != cudaSuccess) {
-            printf("Error on process pixels %s\n", cudaGetErrorString(err));
+            reportFailure("the kernel failed: %s", cudaGetErrorString(err));
             return -1;
         }
     }
-    // copy tiff file from gpu to cpu
-    err = cudaMemcpy(tiff->data, d_pix, tiff->dataLen, cudaMemcpyDeviceToHost);
+    // wait for the last strip so the kernel time is its own
+    err = cudaDeviceSynchronize();
     if (err != cudaSuccess) {
-        printf("Error on memcopy dth %s\n", cudaGetErrorString(err));
+        reportFailure("the kernel failed: %s", cudaGetErrorString(err));
         return -1;
     }
+    addStageTime(STAGE_KERNEL, getMonotonicTime() - uploaded, numBytes, numPixels);
+    // copy the tiff file of every power from gpu to cpu
+    return copyOutputs(d_pix, dataLen, numPixels, outputs, numPowers);
+}
+
+// the handeling of multi stripped tiffs is handled separately because there is no guarantee that the strips will be 
+// placed continuously throughout the file so it faster to copy the entire file all at once to the gpu than copy over
+// each strip. This not does not make sense for singely stripped tiffs, where the pixels are guaranteed to be stored 
+// continuously in the file. creates thread for each pixel.
+int cudaProcessStrips(unsigned char* data, unsigned long dataLen, unsigned int numStrips, unsigned int* stripOffsets,
+    unsigned int* bytesPerStrip, const double* powers, unsigned char** outputs, int numPowers, int bytesPerChannel,
+    int isLittle) {
+    double start = getMonotonicTime();
+    // enough gpu memory for a copy of the entire tiff file per power
+    unsigned char* d_pix = allocateOutputs(dataLen, numPowers);
+    if (d_pix == NULL) {
+        return -1;
+    }
+
+    int result = processStripsOnDevice(d_pix, data, dataLen, numStrips, stripOffsets, bytesPerStrip, powers, outputs,
+        numPowers, bytesPerChannel, isLittle, start);
     // free gpu memory
-    err = cudaFree(d_pix);
+    cudaError_t err = cudaFree(d_pix);
     if (err != cudaSuccess) {
-        printf("Error on free in main %s\n", cudaGetErrorString(err));
+        reportFailure("could not free memory on the gpu: %s", cudaGetErrorString(err));
         return -1;
     }
-    // write the tiff to the output file
-    writeTiff(tiff, outputPath);
-    // return 0 indicating success
-    return 0;
+    return result;
 }
-
@@ -0,0 +1,22 @@
+#ifndef COLORCAST_PROCESS_H
+#define COLORCAST_PROCESS_H
+
+// functions in Process.cu that run the color cast kernel on the gpu.
+// All of them return 0 on success and -1 on failure.
+
+// returns true if there is a cuda capable gpu the kernel can run on
+int cudaIsAvailable();
+
+// processes numBytes of contiguous rgb pixel data once for every power, writing
+// the result of powers[i] to outputs[i]
+int cudaProcessBuffer(unsigned char* data, unsigned long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle);
+
+// processes every strip of a file once for every power, writing the result of
+// powers[i] to the copy of the file outputs[i]. The whole file is copied to the gpu
+// at once because the strips are not guaranteed to be contiguous.
+int cudaProcessStrips(unsigned char* data, unsigned long dataLen, unsigned int numStrips, unsigned int* stripOffsets,
+    unsigned int* bytesPerStrip, const double* powers, unsigned char** outputs, int numPowers, int bytesPerChannel,
+    int isLittle);
+
+#endif //COLORCAST_PROCESS_H
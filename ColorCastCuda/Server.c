@@ -0,0 +1,690 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "Backend.h"
+#include "File.h"
+#include "Platform.h"
+#include "Server.h"
+#include "Signal.h"
+#include "Thread.h"
+
+#ifndef _WIN32
+
+// longest request line a client may send
+#define MAX_LINE_LENGTH (64 * 1024)
+
+typedef struct Connection Connection;
+
+// an image a client asked for that is not done yet
+typedef struct ServerJob {
+    char* id;
+    int cancelled;
+    Connection* connection;
+    struct ServerJob* next;
+} ServerJob;
+
+// a connected client, served by its own thread reading its requests
+struct Connection {
+    int fd;                     // -1 once closed
+    int reading;                // the thread is still reading requests
+    int dropped;                // the client stopped reading its statuses, none are sent
+    ServerJob* jobs;            // images not done yet
+    Mutex lock;                 // guards everything above and writing to fd
+    Thread thread;
+    struct Server* server;
+    struct Connection* next;
+};
+
+typedef struct Server {
+    Pipeline* pipeline;
+    int stopping;               // set once the server is asked to stop, guarded by lock
+    Connection* connections;
+    Mutex lock;
+} Server;
+
+// fills in the address of a socket path. returns -1 if the path is too long
+int getSocketAddress(const char* socketPath, struct sockaddr_un* address) {
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address->sun_path)) {
+        printf("ERROR: socket path is too long: %s\n", socketPath);
+        return -1;
+    }
+
+    strcpy(address->sun_path, socketPath);
+    return 0;
+}
+
+// sends a formatted line to the client, which is dropped if the client is gone.
+// The line is sent without waiting, as the pipeline threads report through it, and a
+// client whose socket is full is disconnected. The lock of the connection must be held
+void sendLine(Connection* connection, const char* format, ...) {
+    if (connection->fd < 0 || connection->dropped) {
+        return;
+    }
+
+    char line[1024];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (length < 0 || length > (int)sizeof(line) - 2) {
+        length = (int)sizeof(line) - 2;
+    }
+    line[length++] = '\n';
+
+    ssize_t written = send(connection->fd, line, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (written == length) {
+        return;
+    }
+
+    // the reading thread sees the connection end and cancels the images left
+    printf("WARNING: disconnecting a client that does not read its statuses\n");
+    connection->dropped = 1;
+    shutdown(connection->fd, SHUT_RDWR);
+    for (ServerJob* job = connection->jobs; job != NULL; job = job->next) {
+        job->cancelled = 1;
+    }
+}
+
+// closes the connection once the client is gone and none of its images are left to
+// report on. The lock of the connection must be held
+void closeIfIdle(Connection* connection) {
+    if (!connection->reading && connection->jobs == NULL && connection->fd >= 0) {
+        close(connection->fd);
+        connection->fd = -1;
+    }
+}
+
+// reports a change of status of an image to the client that asked for it
+void reportImage(void* context, ImageStatus status, const ImageTiming* timing) {
+    ServerJob* job = (ServerJob*)context;
+    Connection* connection = job->connection;
+
+    lockMutex(&connection->lock);
+    switch (status) {
+    case IMAGE_STARTED:
+        sendLine(connection, "started\t%s", job->id);
+        unlockMutex(&connection->lock);
+        return;
+    case IMAGE_WRITTEN:
+    case IMAGE_FAILED:
+        sendLine(connection, "%s\t%s\t%.3f\t%.3f\t%.3f\t%.3f", status == IMAGE_WRITTEN ? "done" : "failed", job->id,
+            timing->readTime * 1000, timing->processTime * 1000, timing->writeTime * 1000, timing->totalTime * 1000);
+        break;
+    default:
+        sendLine(connection, "cancelled\t%s", job->id);
+        break;
+    }
+
+    // the status is final, the job is removed from the connection
+    ServerJob** link = &connection->jobs;
+    while (*link != job) {
+        link = &(*link)->next;
+    }
+    *link = job->next;
+    free(job->id);
+    free(job);
+
+    closeIfIdle(connection);
+    unlockMutex(&connection->lock);
+}
+
+// returns true if the client cancelled the image or went away
+int isImageCancelled(void* context) {
+    ServerJob* job = (ServerJob*)context;
+    lockMutex(&job->connection->lock);
+    int cancelled = job->cancelled;
+    unlockMutex(&job->connection->lock);
+
+    return cancelled;
+}
+
+// splits line at tabs in place into at most maxFields fields. returns the number of fields
+int splitFields(char* line, char** fields, int maxFields) {
+    int numFields = 0;
+    char* field = line;
+    while (numFields < maxFields) {
+        fields[numFields++] = field;
+        char* tab = strchr(field, '\t');
+        if (tab == NULL) {
+            break;
+        }
+        *tab = '\0';
+        field = tab + 1;
+    }
+
+    return numFields;
+}
+
+// parses the comma separated powers of a request. returns the number of powers,
+// -1 if one is invalid
+int parseRequestPowers(const char* list, double* powers) {
+    int numPowers = 0;
+    const char* start = list;
+    while (1) {
+        char* end;
+        double power = strtod(start, &end);
+        if (end == start || (*end != ',' && *end != '\0') || power < .1 || power > 15 || numPowers == MAX_POWERS) {
+            return -1;
+        }
+        powers[numPowers++] = power;
+
+        if (*end == '\0') {
+            return numPowers;
+        }
+        start = end + 1;
+    }
+}
+
+// queues the image of a convert request, waiting while the pipeline is full
+void handleConvert(Connection* connection, const char* id, char** fields, int numFields) {
+    double powers[MAX_POWERS];
+    int numPowers = numFields >= 3 ? parseRequestPowers(fields[2], powers) : -1;
+
+    lockMutex(&connection->lock);
+    if (numPowers < 0) {
+        sendLine(connection, "error\t%s\tpowers must be up to %d comma separated numbers from .1 to 15",
+            id, MAX_POWERS);
+        unlockMutex(&connection->lock);
+        return;
+    }
+    if (numFields != 4 + numPowers) {
+        sendLine(connection, "error\t%s\texpected an input and %d outputs", id, numPowers);
+        unlockMutex(&connection->lock);
+        return;
+    }
+
+    ServerJob* job = malloc(sizeof(ServerJob));
+    job->id = _strdup(id);
+    job->cancelled = 0;
+    job->connection = connection;
+    job->next = connection->jobs;
+    connection->jobs = job;
+    sendLine(connection, "queued\t%s", id);
+    unlockMutex(&connection->lock);
+
+    ImageRequest request;
+    initImageRequest(&request);
+    request.imagePath = fields[3];
+    request.outputPaths = fields + 4;
+    request.powers = powers;
+    request.numPowers = numPowers;
+    request.callback = reportImage;
+    request.isCancelled = isImageCancelled;
+    request.context = job;
+    submitImage(connection->server->pipeline, &request);
+}
+
+// marks the images of the connection with the given id as cancelled, or all of
+// them if id is NULL. returns the number of images marked
+int cancelJobs(Connection* connection, const char* id) {
+    int numCancelled = 0;
+    lockMutex(&connection->lock);
+    for (ServerJob* job = connection->jobs; job != NULL; job = job->next) {
+        if (id == NULL || strcmp(job->id, id) == 0) {
+            job->cancelled = 1;
+            numCancelled++;
+        }
+    }
+    unlockMutex(&connection->lock);
+
+    return numCancelled;
+}
+
+// handles a single request line of a client
+void handleRequest(Connection* connection, char* line) {
+    char* fields[4 + MAX_POWERS + 1];
+    int numFields = splitFields(line, fields, 4 + MAX_POWERS + 1);
+    const char* id = numFields >= 2 ? fields[1] : "";
+
+    if (strcmp(fields[0], "convert") == 0) {
+        handleConvert(connection, id, fields, numFields);
+        return;
+    }
+
+    if (strcmp(fields[0], "cancel") == 0 && numFields == 2) {
+        if (cancelJobs(connection, id) == 0) {
+            lockMutex(&connection->lock);
+            sendLine(connection, "error\t%s\tno image with this id is waiting", id);
+            unlockMutex(&connection->lock);
+        }
+        return;
+    }
+
+    lockMutex(&connection->lock);
+    sendLine(connection, "error\t%s\tunknown request: %s", id, fields[0]);
+    unlockMutex(&connection->lock);
+}
+
+// reads the requests of a client until it closes the connection or the server stops
+void serveConnection(void* arg) {
+    Connection* connection = (Connection*)arg;
+    char* buffer = malloc(MAX_LINE_LENGTH);
+    int length = 0;
+
+    while (1) {
+        ssize_t numRead = read(connection->fd, buffer + length, MAX_LINE_LENGTH - length);
+        if (numRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (numRead <= 0) {
+            break;
+        }
+        length += (int)numRead;
+
+        // handle every complete line, keeping the start of the next one
+        char* lineStart = buffer;
+        char* newline;
+        while ((newline = memchr(lineStart, '\n', length - (lineStart - buffer))) != NULL) {
+            *newline = '\0';
+            if (newline > lineStart && newline[-1] == '\r') {
+                newline[-1] = '\0';
+            }
+            if (*lineStart != '\0') {
+                handleRequest(connection, lineStart);
+            }
+            lineStart = newline + 1;
+        }
+        length -= (int)(lineStart - buffer);
+        memmove(buffer, lineStart, length);
+
+        if (length == MAX_LINE_LENGTH) {
+            lockMutex(&connection->lock);
+            sendLine(connection, "error\t\trequest is longer than %d bytes", MAX_LINE_LENGTH);
+            unlockMutex(&connection->lock);
+            break;
+        }
+    }
+    free(buffer);
+
+    // a client that went away no longer wants its images, when the server stops
+    // the images already queued are still finished
+    lockMutex(&connection->server->lock);
+    int stopping = connection->server->stopping;
+    unlockMutex(&connection->server->lock);
+    if (!stopping) {
+        cancelJobs(connection, NULL);
+    }
+
+    lockMutex(&connection->lock);
+    connection->reading = 0;
+    closeIfIdle(connection);
+    unlockMutex(&connection->lock);
+}
+
+// returns true once the thread of the connection is done and all its images are reported
+int isConnectionDone(Connection* connection) {
+    lockMutex(&connection->lock);
+    int done = !connection->reading && connection->fd < 0;
+    unlockMutex(&connection->lock);
+
+    return done;
+}
+
+// frees a connection whose thread has been joined
+void freeConnection(Connection* connection) {
+    if (connection->fd >= 0) {
+        close(connection->fd);
+    }
+    destroyMutex(&connection->lock);
+    free(connection);
+}
+
+// joins and frees the connections that are done
+void reapConnections(Server* server) {
+    Connection** link = &server->connections;
+    while (*link != NULL) {
+        Connection* connection = *link;
+        if (!isConnectionDone(connection)) {
+            link = &connection->next;
+            continue;
+        }
+
+        joinThread(&connection->thread);
+        *link = connection->next;
+        freeConnection(connection);
+    }
+}
+
+// opens a listening socket at socketPath. returns its file descriptor, -1 on failure
+int listenOnSocket(const char* socketPath) {
+    struct sockaddr_un address;
+    if (getSocketAddress(socketPath, &address) != 0) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        printf("ERROR: can not create a socket\n");
+        return -1;
+    }
+
+    // a socket file left behind by a server that was killed is replaced, one that
+    // still accepts connections belongs to a running server
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+        printf("ERROR: a server is already listening on %s\n", socketPath);
+        close(fd);
+        return -1;
+    }
+    unlink(socketPath);
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        printf("ERROR: can not listen on %s\n", socketPath);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// serves requests on socketPath until SIGINT or SIGTERM
+int runServer(const char* socketPath, Options* options) {
+    int listenFd = listenOnSocket(socketPath);
+    if (listenFd < 0) {
+        return -1;
+    }
+    int stopFd = catchStopSignals();
+    if (stopFd < 0) {
+        close(listenFd);
+        unlink(socketPath);
+        return -1;
+    }
+    // a client that disconnects while its status is written must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    if (warmUpBackend() != 0) {
+        printf("WARNING: the %s backend failed to warm up\n", getBackendName(getBackend()));
+    }
+
+    Server server;
+    server.pipeline = startPipeline(options->stripSize, &options->pipeline);
+    if (server.pipeline == NULL) {
+        close(listenFd);
+        unlink(socketPath);
+        releaseStopSignals();
+        return -1;
+    }
+    server.stopping = 0;
+    server.connections = NULL;
+    initMutex(&server.lock);
+    printf("Listening on %s, press Ctrl+C to stop\n", socketPath);
+
+    while (1) {
+        struct pollfd fds[2];
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = stopFd;
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        if (fds[0].revents == 0) {
+            continue;
+        }
+
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+
+        reapConnections(&server);
+        Connection* connection = calloc(1, sizeof(Connection));
+        connection->fd = fd;
+        connection->reading = 1;
+        connection->server = &server;
+        initMutex(&connection->lock);
+        if (startThread(&connection->thread, serveConnection, connection) != 0) {
+            close(fd);
+            destroyMutex(&connection->lock);
+            free(connection);
+            continue;
+        }
+        connection->next = server.connections;
+        server.connections = connection;
+    }
+
+    // stop reading requests but finish the images already queued
+    printf("\nStopping, finishing the queued images\n");
+    close(listenFd);
+    unlink(socketPath);
+    lockMutex(&server.lock);
+    server.stopping = 1;
+    unlockMutex(&server.lock);
+    for (Connection* connection = server.connections; connection != NULL; connection = connection->next) {
+        lockMutex(&connection->lock);
+        if (connection->fd >= 0) {
+            shutdown(connection->fd, SHUT_RD);
+        }
+        unlockMutex(&connection->lock);
+    }
+
+    // every thread that may submit is joined before the pipeline stops taking images
+    for (Connection* connection = server.connections; connection != NULL; connection = connection->next) {
+        joinThread(&connection->thread);
+    }
+    PipelineStats stats;
+    finishPipeline(server.pipeline, &stats);
+    while (server.connections != NULL) {
+        Connection* connection = server.connections;
+        server.connections = connection->next;
+        freeConnection(connection);
+    }
+    destroyMutex(&server.lock);
+    releaseStopSignals();
+
+    return 0;
+}
+
+// returns path made absolute against the current directory of the client. Only the
+// directory is resolved so outputs that are not written yet are resolved too
+char* getClientPath(const char* path) {
+    const char* name = getFileName(path);
+    if (*name == '\0') {
+        return _strdup(path);
+    }
+
+    char* dir = name == path ? _strdup(".") : _strdup(path);
+    if (name != path) {
+        dir[name - path] = '\0';
+    }
+    char* absoluteDir = getAbsolutePath(dir);
+    free(dir);
+    if (absoluteDir == NULL) {
+        return _strdup(path);
+    }
+
+    char* absolute = malloc(strlen(absoluteDir) + strlen(name) + 2);
+    sprintf(absolute, "%s" PATH_SEPARATOR "%s", absoluteDir, name);
+    free(absoluteDir);
+    return absolute;
+}
+
+// formats the convert request of image i into line, the id of a request is the index of its image
+void formatConvertRequest(char** line, size_t* lineCap, int i, const char* imagePath, char** outputPaths,
+    const double* powers, int numPowers) {
+    size_t length = strlen(imagePath) + 64 + numPowers * 32;
+    for (int j = 0; j < numPowers; j++) {
+        length += strlen(outputPaths[j]) + 1;
+    }
+    if (length > *lineCap) {
+        *lineCap = length;
+        *line = realloc(*line, length);
+    }
+
+    int offset = sprintf(*line, "convert\t%d\t", i);
+    for (int j = 0; j < numPowers; j++) {
+        offset += sprintf(*line + offset, j == 0 ? "%.17g" : ",%.17g", powers[j]);
+    }
+    offset += sprintf(*line + offset, "\t%s", imagePath);
+    for (int j = 0; j < numPowers; j++) {
+        offset += sprintf(*line + offset, "\t%s", outputPaths[j]);
+    }
+    sprintf(*line + offset, "\n");
+}
+
+// handles a status line from the server, printing it with the image path in place
+// of the id. returns 1 if the status of the image is final
+int handleStatus(char* line, char** imagePaths, int numImg, int* results, PipelineStats* stats) {
+    char* fields[6];
+    int numFields = splitFields(line, fields, 6);
+    char* end;
+    long id = numFields >= 2 ? strtol(fields[1], &end, 10) : -1;
+    if (numFields < 2 || end == fields[1] || id < 0 || id >= numImg) {
+        printf("%s\n", line);
+        return 0;
+    }
+
+    printf("%s\t%s", fields[0], imagePaths[id]);
+    for (int i = 2; i < numFields; i++) {
+        printf("\t%s", fields[i]);
+    }
+    printf("\n");
+
+    if (strcmp(fields[0], "done") == 0 || strcmp(fields[0], "failed") == 0) {
+        results[id] = strcmp(fields[0], "done") == 0 ? 0 : -1;
+        if (numFields == 6) {
+            stats->readTime += atof(fields[2]) / 1000;
+            stats->processTime += atof(fields[3]) / 1000;
+            stats->writeTime += atof(fields[4]) / 1000;
+        }
+        return 1;
+    }
+
+    return strcmp(fields[0], "cancelled") == 0 || strcmp(fields[0], "error") == 0;
+}
+
+// converts every image on the server at socketPath
+int runClient(const char* socketPath, char** imagePaths, char** outputPaths, int numImg, const double* powers,
+    int numPowers, int* results, PipelineStats* stats) {
+    memset(stats, 0, sizeof(PipelineStats));
+    for (int i = 0; i < numImg; i++) {
+        results[i] = -1;
+    }
+
+    struct sockaddr_un address;
+    if (getSocketAddress(socketPath, &address) != 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        printf("ERROR: no server is listening on %s\n", socketPath);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // requests are sent while statuses are read, so neither side blocks on a full socket
+    char* request = NULL;
+    size_t requestCap = 0;
+    size_t requestLength = 0;
+    size_t requestSent = 0;
+    int nextImage = 0;
+    char* clientOutputs[MAX_POWERS];
+    char* buffer = malloc(MAX_LINE_LENGTH);
+    int length = 0;
+    int numFinal = 0;
+
+    while (numFinal < numImg) {
+        if (requestSent == requestLength && nextImage < numImg) {
+            // the server runs in another directory, so it is sent absolute paths
+            char* imagePath = getClientPath(imagePaths[nextImage]);
+            for (int j = 0; j < numPowers; j++) {
+                clientOutputs[j] = getClientPath(outputPaths[nextImage * numPowers + j]);
+            }
+            formatConvertRequest(&request, &requestCap, nextImage, imagePath, clientOutputs, powers, numPowers);
+            free(imagePath);
+            for (int j = 0; j < numPowers; j++) {
+                free(clientOutputs[j]);
+            }
+            requestLength = strlen(request);
+            requestSent = 0;
+            nextImage++;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN | (requestSent < requestLength ? POLLOUT : 0);
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if ((pfd.revents & POLLOUT) != 0) {
+            ssize_t written = send(fd, request + requestSent, requestLength - requestSent, MSG_DONTWAIT);
+            if (written < 0 && errno != EAGAIN && errno != EINTR) {
+                break;
+            }
+            if (written > 0) {
+                requestSent += written;
+            }
+        }
+        if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+            continue;
+        }
+
+        ssize_t numRead = recv(fd, buffer + length, MAX_LINE_LENGTH - 1 - length, MSG_DONTWAIT);
+        if (numRead < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        if (numRead <= 0) {
+            printf("ERROR: the server closed the connection\n");
+            break;
+        }
+        length += (int)numRead;
+
+        char* lineStart = buffer;
+        char* newline;
+        while ((newline = memchr(lineStart, '\n', length - (lineStart - buffer))) != NULL) {
+            *newline = '\0';
+            numFinal += handleStatus(lineStart, imagePaths, numImg, results, stats);
+            lineStart = newline + 1;
+        }
+        length -= (int)(lineStart - buffer);
+        memmove(buffer, lineStart, length);
+    }
+
+    free(buffer);
+    free(request);
+    close(fd);
+
+    int numFailed = 0;
+    for (int i = 0; i < numImg; i++) {
+        if (results[i] != 0) {
+            numFailed++;
+        }
+    }
+    return numFailed;
+}
+
+#else
+
+// unix domain sockets are not used on windows
+int runServer(const char* socketPath, Options* options) {
+    printf("ERROR: serving on %s needs a unix system\n", socketPath);
+    return -1;
+}
+
+int runClient(const char* socketPath, char** imagePaths, char** outputPaths, int numImg, const double* powers,
+    int numPowers, int* results, PipelineStats* stats) {
+    printf("ERROR: connecting to %s needs a unix system\n", socketPath);
+    return -1;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef COLORCAST_SERVER_H
+#define COLORCAST_SERVER_H
+
+#include "Options.h"
+#include "Pipeline.h"
+
+// the server converts images for other processes over a unix domain socket, keeping
+// its pipeline threads and the backend warm between requests. Only on unix systems.
+//
+// A client sends one request per line with the fields separated by tabs:
+//   convert <id> <powers> <input> <output>...   one output per comma separated power
+//   cancel <id>
+// and receives a line for every change of status of its images:
+//   queued <id>
+//   started <id>
+//   done <id> <read ms> <process ms> <write ms> <total ms>
+//   failed <id> <read ms> <process ms> <write ms> <total ms>
+//   cancelled <id>
+//   error <id> <message>
+// Paths are resolved by the server, so clients send absolute ones. Closing the
+// connection cancels the images of the client that are not written yet, and a client
+// that stops reading its statuses is disconnected.
+
+// serves requests on socketPath until SIGINT or SIGTERM, then finishes the images
+// already queued. Encoder and pipeline settings come from options.
+// returns 0 on success, -1 if the socket can not be opened
+int runServer(const char* socketPath, Options* options);
+
+// converts imagePaths[i] with every power on the server at socketPath, writing the
+// result of powers[j] to outputPaths[i * numPowers + j]. Relative paths are made
+// absolute against the current directory before they are sent. results[i] is set to 0 if
+// the image was converted and -1 if it failed, and the times the server reports are
+// added up in stats. returns the number of failed images, -1 if the server can not
+// be reached
+int runClient(const char* socketPath, char** imagePaths, char** outputPaths, int numImg, const double* powers,
+    int numPowers, int* results, PipelineStats* stats);
+
+#endif //COLORCAST_SERVER_H
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+#include "Signal.h"
+
+#ifndef _WIN32
+
+// written to by the signal handler and read by whoever waits for a stop
+static int stopPipe[2] = { -1, -1 };
+
+// wakes up whoever waits for a stop, writing to a pipe is safe in a signal handler
+void stopOnSignal(int signal) {
+    (void)signal;
+    char byte = 0;
+    if (write(stopPipe[1], &byte, 1) < 0) {
+        // the pipe is full, so a stop is already pending
+    }
+}
+
+// makes SIGINT and SIGTERM readable on the returned file descriptor
+int catchStopSignals() {
+    if (stopPipe[0] < 0) {
+        if (pipe(stopPipe) != 0) {
+            printf("ERROR: can not catch signals\n");
+            return -1;
+        }
+        fcntl(stopPipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(stopPipe[1], F_SETFD, FD_CLOEXEC);
+        // a full pipe must not block the signal handler
+        fcntl(stopPipe[1], F_SETFL, O_NONBLOCK);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopOnSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    return stopPipe[0];
+}
+
+// restores the default handling of SIGINT and SIGTERM
+void releaseStopSignals() {
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
+
+#else
+
+// windows stops console programs on ctrl+c without signals to catch
+int catchStopSignals() {
+    return -1;
+}
+
+void releaseStopSignals() {
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef COLORCAST_SIGNAL_H
+#define COLORCAST_SIGNAL_H
+
+// long running modes stop cleanly on SIGINT and SIGTERM instead of being killed
+// halfway through writing an image. Only on unix systems
+
+// makes SIGINT and SIGTERM stop the program through the returned file descriptor,
+// which becomes readable once one of them arrives. returns -1 on failure
+int catchStopSignals();
+
+// restores the default handling of SIGINT and SIGTERM
+void releaseStopSignals();
+
+#endif //COLORCAST_SIGNAL_H
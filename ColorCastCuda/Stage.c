@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include "Stage.h"
+#include "Thread.h"
+#include "Trace.h"
+
+// every thread records into the times of the image it works on
+static THREAD_LOCAL StageTimes* currentTimes = NULL;
+
+// returns the name of a stage as printed in the summary
+const char* getStageName(Stage stage) {
+    static const char* names[NUM_STAGES] = {
+        "scan", "probe", "read", "decode", "H2D", "kernel", "D2H", "encode", "write"
+    };
+
+    return stage >= 0 && stage < NUM_STAGES ? names[stage] : "unknown";
+}
+
+// makes addStageTime on this thread add to times
+void recordStages(StageTimes* times) {
+    currentTimes = times;
+}
+
+// adds seconds, bytes and pixels to a stage of the times recorded on this thread
+void addStageTime(Stage stage, double seconds, unsigned long long bytes, unsigned long long pixels) {
+    TRACE_COMPLETE(getStageName(stage), seconds);
+    if (currentTimes != NULL) {
+        currentTimes->seconds[stage] += seconds;
+        currentTimes->bytes[stage] += bytes;
+        currentTimes->pixels[stage] += pixels;
+    }
+}
+
+// adds the counts since start to a stage of the times recorded on this thread
+void addStageCounters(Stage stage, const CounterValues* start) {
+    if (currentTimes == NULL || !isCounting()) {
+        return;
+    }
+
+    CounterValues now;
+    readCounters(&now);
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        currentTimes->counters[stage].values[i] += now.values[i] - start->values[i];
+    }
+}
+
+// adds every stage of times to total
+void addStageTimes(StageTimes* total, const StageTimes* times) {
+    for (int i = 0; i < NUM_STAGES; i++) {
+        total->seconds[i] += times->seconds[i];
+        total->bytes[i] += times->bytes[i];
+        total->pixels[i] += times->pixels[i];
+        for (int j = 0; j < NUM_COUNTERS; j++) {
+            total->counters[i].values[j] += times->counters[i].values[j];
+        }
+    }
+}
+
+// prints the summary table. Stages run on several threads at once, so their
+// seconds are busy time and can add up to more than the time the batch took
+void printStageTable(const StageTimes* times) {
+    double total = 0;
+    for (int i = 0; i < NUM_STAGES; i++) {
+        total += times->seconds[i];
+    }
+    if (total == 0) {
+        return;
+    }
+
+    printf("%-8s %10s %7s %10s %10s\n", "stage", "seconds", "share", "MPix/s", "MB/s");
+    for (int i = 0; i < NUM_STAGES; i++) {
+        double seconds = times->seconds[i];
+        if (seconds == 0) {
+            continue;
+        }
+        printf("%-8s %10.3f %6.1f%%", getStageName((Stage)i), seconds, 100 * seconds / total);
+        // scanning and probing look at files, not pixels
+        if (times->pixels[i] > 0) {
+            printf(" %10.1f", times->pixels[i] / seconds / 1e6);
+        }
+        else {
+            printf(" %10s", "-");
+        }
+        if (times->bytes[i] > 0) {
+            printf(" %10.1f\n", times->bytes[i] / seconds / (1024.0 * 1024.0));
+        }
+        else {
+            printf(" %10s\n", "-");
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef COLORCAST_STAGE_H
+#define COLORCAST_STAGE_H
+
+#include "Counters.h"
+
+// the steps a batch of images goes through, timed with the monotonic clock.
+// Upload, kernel and download are the copy to the gpu, the processing and the copy
+// back; the cpu backend only has a kernel.
+typedef enum {
+    STAGE_SCAN,         // finding the images to convert
+    STAGE_PROBE,        // reading headers to estimate the memory of each image
+    STAGE_READ,         // reading input files into memory
+    STAGE_DECODE,       // decoding jpgs and pngs into pixels, restriping tiffs
+    STAGE_UPLOAD,       // host to device
+    STAGE_KERNEL,
+    STAGE_DOWNLOAD,     // device to host
+    STAGE_ENCODE,       // compressing pngs and jpgs
+    STAGE_WRITE,        // writing output files
+    NUM_STAGES
+} Stage;
+
+// seconds spent in, bytes and pixels passed through and hardware counts of every
+// stage, for a single image or summed over a batch. Only decode, kernel and encode
+// are counted. A stage that runs once per output, like encode, counts the pixels of
+// every output
+typedef struct {
+    double seconds[NUM_STAGES];
+    unsigned long long bytes[NUM_STAGES];
+    unsigned long long pixels[NUM_STAGES];
+    CounterValues counters[NUM_STAGES];
+} StageTimes;
+
+// returns the name of a stage as printed in the summary
+const char* getStageName(Stage stage);
+
+// makes addStageTime on this thread add to times, until it is called with NULL
+void recordStages(StageTimes* times);
+
+// adds seconds, bytes and pixels to a stage of the times recorded on this thread,
+// does nothing if there are none
+void addStageTime(Stage stage, double seconds, unsigned long long bytes, unsigned long long pixels);
+
+// adds the counts of this thread since start, read with readCounters, to a stage
+// of the times recorded on this thread. does nothing if there are none
+void addStageCounters(Stage stage, const CounterValues* start);
+
+// adds every stage of times to total
+void addStageTimes(StageTimes* total, const StageTimes* times);
+
+// prints a table of the time, share of the total, MPix/s and MB/s of every
+// stage that was used
+void printStageTable(const StageTimes* times);
+
+#endif //COLORCAST_STAGE_H
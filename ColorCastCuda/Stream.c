@@ -0,0 +1,336 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "Backend.h"
+#include "Buffer.h"
+#include "ByteOrdering.h"
+#include "Png.h"
+#include "Stream.h"
+#include "Tiff.h"
+#include "stb_image.h"
+
+extern const int NUM_CHANNELS;
+
+// pixels are read, converted and written in bands of about this many bytes
+#define STREAM_BAND_SIZE (1 << 20)
+
+// part of a tiff stream that holds pixels, from start up to but not including stop
+typedef struct {
+    unsigned long long start;
+    unsigned long long stop;
+} PixelRange;
+
+// switches stdin and stdout to binary mode and points stdout at stderr,
+// returning a stream for the original stdout
+FILE* openImageStdio() {
+    fflush(stdout);
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    int fd = _dup(_fileno(stdout));
+    if (fd < 0 || _dup2(_fileno(stderr), _fileno(stdout)) != 0) {
+        printf("ERROR: can not write images to stdout\n");
+        return NULL;
+    }
+    _setmode(fd, _O_BINARY);
+    FILE* output = _fdopen(fd, "wb");
+#else
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        printf("ERROR: can not write images to stdout\n");
+        return NULL;
+    }
+    FILE* output = fdopen(fd, "wb");
+#endif
+    if (output == NULL) {
+        printf("ERROR: can not write images to stdout\n");
+    }
+
+    return output;
+}
+
+// appends up to len bytes read from input to the buffer. returns the number of bytes
+// read, which is only less than len at the end of the input
+size_t readBytes(FILE* input, Buffer* buffer, size_t len) {
+    unsigned char chunk[64 * 1024];
+    size_t total = 0;
+    while (total < len) {
+        size_t want = len - total < sizeof(chunk) ? len - total : sizeof(chunk);
+        size_t got = fread(chunk, 1, want, input);
+        appendBytes(buffer, chunk, got);
+        total += got;
+        if (got < want) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+// reads a number of a ppm header along with the whitespace and comments before it
+// and the single whitespace character after it. returns -1 if there is no number
+long readPpmNumber(FILE* input) {
+    int c = fgetc(input);
+    while (c == '#' || isspace(c)) {
+        // comments run to the end of the line
+        if (c == '#') {
+            while (c != '\n' && c != EOF) {
+                c = fgetc(input);
+            }
+        }
+        c = fgetc(input);
+    }
+
+    if (!isdigit(c)) {
+        return -1;
+    }
+    long value = 0;
+    while (isdigit(c)) {
+        value = value * 10 + (c - '0');
+        // far larger than any dimension or sample value
+        if (value > 1 << 24) {
+            return -1;
+        }
+        c = fgetc(input);
+    }
+
+    return isspace(c) ? value : -1;
+}
+
+// converts a binary ppm (P6) whose magic number was already read from input one band
+// of rows at a time. 16 bit samples are big endian
+int convertPpmStream(FILE* input, FILE* output, double power) {
+    long width = readPpmNumber(input);
+    long height = readPpmNumber(input);
+    long maxValue = readPpmNumber(input);
+    if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 65535) {
+        printf("ERROR: not a binary ppm\n");
+        return -1;
+    }
+
+    int bytesPerChannel = maxValue > 255 ? 2 : 1;
+    size_t rowLen = (size_t)width * NUM_CHANNELS * bytesPerChannel;
+    long rowsPerBand = (long)(STREAM_BAND_SIZE / rowLen);
+    if (rowsPerBand < 1) {
+        rowsPerBand = 1;
+    }
+    unsigned char* band = malloc(rowLen * rowsPerBand);
+    if (band == NULL) {
+        printf("ERROR: not enough memory to convert ppm\n");
+        return -1;
+    }
+
+    fprintf(output, "P6\n%ld %ld\n%ld\n", width, height, maxValue);
+    unsigned char* outputs[1] = { band };
+    int result = 0;
+    for (long row = 0; row < height && result == 0; row += rowsPerBand) {
+        long numRows = height - row < rowsPerBand ? height - row : rowsPerBand;
+        size_t len = rowLen * numRows;
+        if (fread(band, 1, len, input) != len) {
+            printf("ERROR: ppm ended after %ld of %ld rows\n", row, height);
+            result = -1;
+        }
+        else if (processBuffer(band, (unsigned long)len, &power, outputs, 1, bytesPerChannel, 0) != 0) {
+            result = -1;
+        }
+        else {
+            fwrite(band, 1, len, output);
+        }
+    }
+
+    free(band);
+    return result;
+}
+
+// sorts pixel ranges by where they start
+int comparePixelRanges(const void* a, const void* b) {
+    const PixelRange* first = (const PixelRange*)a;
+    const PixelRange* second = (const PixelRange*)b;
+    return first->start < second->start ? -1 : first->start > second->start;
+}
+
+// returns the pixels of every strip of the tiff as ranges sorted by where they
+// start, strips that follow each other directly are joined into one range.
+// sets numRanges and returns NULL if out of memory
+PixelRange* getPixelRanges(Tiff* tiff, int pixelSize, int* numRanges) {
+    PixelRange* ranges = malloc(tiff->numStrips * sizeof(PixelRange));
+    if (ranges == NULL) {
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < tiff->numStrips; i++) {
+        ranges[i].start = tiff->stripOffsets[i];
+        // a partial pixel at the end of a strip is left as it is
+        ranges[i].stop = ranges[i].start + tiff->bytesPerStrip[i] / pixelSize * pixelSize;
+    }
+    qsort(ranges, tiff->numStrips, sizeof(PixelRange), comparePixelRanges);
+
+    *numRanges = 0;
+    for (unsigned int i = 0; i < tiff->numStrips; i++) {
+        if (*numRanges > 0 && ranges[*numRanges - 1].stop == ranges[i].start) {
+            ranges[*numRanges - 1].stop = ranges[i].stop;
+        }
+        else {
+            ranges[(*numRanges)++] = ranges[i];
+        }
+    }
+
+    return ranges;
+}
+
+// converts a tiff whose first bytes are in buffer while the rest is read from input.
+// Everything up to the end of the directory has to be read before the first byte can
+// be written, after that the file is passed on a band at a time, converting the pixels
+// of the strips in it
+int convertTiffStream(FILE* input, FILE* output, Buffer* buffer, double power) {
+    unsigned long long directoryEnd;
+    while ((directoryEnd = getTiffDirectoryEnd(buffer->data, (unsigned long)buffer->len)) > buffer->len) {
+        if (readBytes(input, buffer, (size_t)(directoryEnd - buffer->len)) == 0) {
+            printf("ERROR: not a tiff!\n");
+            return -1;
+        }
+    }
+
+    Tiff* tiff = readTiff(buffer->data, (unsigned long)buffer->len);
+    if (tiff == NULL) {
+        return -1;
+    }
+    int result = 0;
+    int numRanges = 0;
+    PixelRange* ranges = NULL;
+    int bytesPerChannel = tiff->bitsPerSample / 8;
+    int pixelSize = NUM_CHANNELS * bytesPerChannel;
+    if (!isSupportedTiff(tiff)) {
+        result = -1;
+    }
+    else if (tiff->numStrips == 0 || tiff->stripOffsets == NULL || tiff->bytesPerStrip == NULL) {
+        printf("ERROR: tiff strips are missing or outside of the file\n");
+        result = -1;
+    }
+    else if ((ranges = getPixelRanges(tiff, pixelSize, &numRanges)) == NULL) {
+        printf("ERROR: not enough memory to convert tiff\n");
+        result = -1;
+    }
+    int isLittle = tiff->isLittle;
+    // the tiff points into the buffer, which moves as the stream is read
+    free(tiff->entries);
+    free(tiff->stripOffsets);
+    free(tiff->bytesPerStrip);
+    free(tiff);
+
+    // position in the stream of the first byte in the buffer
+    unsigned long long position = 0;
+    unsigned char* outputs[1];
+    int ended = 0;
+    while (result == 0) {
+        unsigned long long end = position + buffer->len;
+        // a pixel cut off at the end of the buffer waits for the rest of its bytes,
+        // at the end of the stream every strip has to be complete
+        unsigned long long ready = end;
+        for (int i = 0; i < numRanges; i++) {
+            if (ended && ranges[i].stop > end) {
+                printf("ERROR: tiff strips are missing or outside of the file\n");
+                result = -1;
+            }
+            else if (ranges[i].start < end && end < ranges[i].stop) {
+                ready = ranges[i].start + (end - ranges[i].start) / pixelSize * pixelSize;
+            }
+        }
+
+        for (int i = 0; i < numRanges && result == 0; i++) {
+            unsigned long long start = ranges[i].start > position ? ranges[i].start : position;
+            unsigned long long stop = ranges[i].stop < ready ? ranges[i].stop : ready;
+            if (start < stop) {
+                outputs[0] = buffer->data + (start - position);
+                result = processBuffer(outputs[0], (unsigned long)(stop - start), &power, outputs, 1,
+                    bytesPerChannel, isLittle);
+            }
+        }
+        if (result != 0) {
+            break;
+        }
+
+        size_t numReady = (size_t)(ready - position);
+        fwrite(buffer->data, 1, numReady, output);
+        memmove(buffer->data, buffer->data + numReady, buffer->len - numReady);
+        buffer->len -= numReady;
+        position = ready;
+        if (ended) {
+            break;
+        }
+        ended = readBytes(input, buffer, STREAM_BAND_SIZE) == 0;
+    }
+
+    free(ranges);
+    return result;
+}
+
+// converts a png whose first bytes are in buffer, it is read whole since it is
+// decoded from memory
+int convertPngStream(FILE* input, FILE* output, Buffer* buffer, double power, int pngLevel) {
+    while (readBytes(input, buffer, STREAM_BAND_SIZE) > 0) {
+    }
+
+    int width, height, channels;
+    int bitsPerSample = 8;
+    unsigned char* pixels;
+    if (stbi_is_16_bit_from_memory(buffer->data, (int)buffer->len)) {
+        pixels = (unsigned char*)stbi_load_16_from_memory(buffer->data, (int)buffer->len, &width, &height,
+            &channels, 3);
+        bitsPerSample = 16;
+    }
+    else {
+        pixels = stbi_load_from_memory(buffer->data, (int)buffer->len, &width, &height, &channels, 3);
+    }
+    if (pixels == NULL) {
+        printf("Failed to load image\n");
+        return -1;
+    }
+
+    unsigned long numBytes = (unsigned long)width * height * NUM_CHANNELS * (bitsPerSample / 8);
+    unsigned char* outputs[1] = { pixels };
+    int result = processBuffer(pixels, numBytes, &power, outputs, 1, bitsPerSample / 8, isHostLittleEndian());
+    if (result == 0) {
+        result = writePngFile(output, pixels, width, height, bitsPerSample, pngLevel);
+    }
+
+    stbi_image_free(pixels);
+    return result;
+}
+
+// tells the format of the stream from its first two bytes and converts it
+int convertStream(FILE* input, FILE* output, double power, int pngLevel) {
+    Buffer buffer;
+    initBuffer(&buffer, STREAM_BAND_SIZE);
+
+    int result = -1;
+    if (readBytes(input, &buffer, 2) != 2) {
+        printf("ERROR: no image on stdin\n");
+    }
+    else if (buffer.data[0] == 'P' && buffer.data[1] == '6') {
+        result = convertPpmStream(input, output, power);
+    }
+    else if ((buffer.data[0] == 'I' && buffer.data[1] == 'I') || (buffer.data[0] == 'M' && buffer.data[1] == 'M')) {
+        result = convertTiffStream(input, output, &buffer, power);
+    }
+    else if (buffer.data[0] == 137 && buffer.data[1] == 'P') {
+        result = convertPngStream(input, output, &buffer, power, pngLevel);
+    }
+    else {
+        printf("ERROR: the image on stdin is not a ppm, tiff or png\n");
+    }
+
+    if (result == 0 && (fflush(output) != 0 || ferror(output))) {
+        printf("ERROR: could not write the image to stdout\n");
+        result = -1;
+    }
+
+    freeBuffer(&buffer);
+    return result;
+}
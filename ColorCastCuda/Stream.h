@@ -0,0 +1,17 @@
+#ifndef COLORCAST_STREAM_H
+#define COLORCAST_STREAM_H
+
+#include <stdio.h>
+
+// makes stdin and stdout carry image data: both are switched to binary mode and
+// everything the program prints on stdout goes to stderr from now on. returns the
+// original stdout to write the image to, or NULL on failure
+FILE* openImageStdio();
+
+// converts a single ppm, tiff or png read from input with the given power and writes
+// it to output in the same format. Ppms, and tiffs whose directory comes before their
+// strips, are converted in bands while they are read so they never have to fit into
+// memory at once. Pngs are read whole. returns 0 on success, -1 on failure
+int convertStream(FILE* input, FILE* output, double power, int pngLevel);
+
+#endif //COLORCAST_STREAM_H
@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include "Thread.h"
+#include "Trace.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// number of threads used for parallel work, 0 means one per core
+int numThreadsSetting = 0;
+
+// state shared by the threads of one runParallel call
+typedef struct {
+    ParallelTask task;
+    void* context;
+    int numTasks;
+    int nextTask;
+    Mutex lock;
+} ParallelJob;
+
+// returns the number of logical cores of the machine
+int getNumCores() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+#endif
+}
+
+// sets the number of threads used for parallel work, 0 uses one thread per core
+void setNumThreads(int numThreads) {
+    numThreadsSetting = numThreads < 0 ? 0 : numThreads;
+}
+
+// returns the number of threads used for parallel work
+int getNumThreads() {
+    if (numThreadsSetting == 0) {
+        return getNumCores();
+    }
+
+    return numThreadsSetting;
+}
+
+// takes tasks from the job until there are none left
+void runTasks(ParallelJob* job) {
+    while (1) {
+        lockMutex(&job->lock);
+        int index = job->nextTask++;
+        unlockMutex(&job->lock);
+
+        if (index >= job->numTasks) {
+            return;
+        }
+
+        job->task(job->context, index);
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI workerMain(LPVOID arg) {
+    TRACE_THREAD_NAME("parallel");
+    runTasks((ParallelJob*)arg);
+    TRACE_THREAD_EXIT();
+    return 0;
+}
+#else
+void* workerMain(void* arg) {
+    TRACE_THREAD_NAME("parallel");
+    runTasks((ParallelJob*)arg);
+    TRACE_THREAD_EXIT();
+    return NULL;
+}
+#endif
+
+// runs task for every index from 0 to numTasks - 1 spread over getNumThreads()
+// threads and returns once all of them have completed. The calling thread
+// takes part in the work.
+void runParallel(ParallelTask task, void* context, int numTasks) {
+    ParallelJob job;
+    job.task = task;
+    job.context = context;
+    job.numTasks = numTasks;
+    job.nextTask = 0;
+    initMutex(&job.lock);
+
+    int numWorkers = getNumThreads() - 1;
+    if (numWorkers > numTasks - 1) {
+        numWorkers = numTasks - 1;
+    }
+    if (numWorkers < 0) {
+        numWorkers = 0;
+    }
+
+    // a worker that could not be started is not joined, the tasks it would have
+    // taken are left to the others and the calling thread
+    int numStarted = 0;
+#ifdef _WIN32
+    HANDLE* workers = malloc(numWorkers * sizeof(HANDLE));
+    for (int i = 0; workers != NULL && i < numWorkers; i++) {
+        workers[numStarted] = CreateThread(NULL, 0, workerMain, &job, 0, NULL);
+        if (workers[numStarted] == NULL) {
+            break;
+        }
+        numStarted++;
+    }
+#else
+    pthread_t* workers = malloc(numWorkers * sizeof(pthread_t));
+    for (int i = 0; workers != NULL && i < numWorkers; i++) {
+        if (pthread_create(&workers[numStarted], NULL, workerMain, &job) != 0) {
+            break;
+        }
+        numStarted++;
+    }
+#endif
+
+    runTasks(&job);
+
+    for (int i = 0; i < numStarted; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(workers[i], INFINITE);
+        CloseHandle(workers[i]);
+#else
+        pthread_join(workers[i], NULL);
+#endif
+    }
+
+    free(workers);
+    destroyMutex(&job.lock);
+}
+
+// what a thread started with startThread runs, freed by the thread
+typedef struct {
+    ThreadMain main;
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+DWORD WINAPI threadMain(LPVOID arg) {
+#else
+void* threadMain(void* arg) {
+#endif
+    ThreadStart start = *(ThreadStart*)arg;
+    free(arg);
+    start.main(start.arg);
+    TRACE_THREAD_EXIT();
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// starts a thread running main(arg). returns 0 on success, -1 on failure
+int startThread(Thread* thread, ThreadMain main, void* arg) {
+    ThreadStart* start = malloc(sizeof(ThreadStart));
+    start->main = main;
+    start->arg = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, threadMain, start, 0, NULL);
+    if (*thread == NULL) {
+#else
+    if (pthread_create(thread, NULL, threadMain, start) != 0) {
+#endif
+        free(start);
+        return -1;
+    }
+
+    return 0;
+}
+
+// waits for a thread started with startThread to return
+void joinThread(Thread* thread) {
+#ifdef _WIN32
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+#else
+    pthread_join(*thread, NULL);
+#endif
+}
+
+void initMutex(Mutex* mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void lockMutex(Mutex* mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void unlockMutex(Mutex* mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void destroyMutex(Mutex* mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void initCondition(Condition* condition) {
+#ifdef _WIN32
+    InitializeConditionVariable(condition);
+#else
+    pthread_cond_init(condition, NULL);
+#endif
+}
+
+void waitCondition(Condition* condition, Mutex* mutex) {
+#ifdef _WIN32
+    SleepConditionVariableCS(condition, mutex, INFINITE);
+#else
+    pthread_cond_wait(condition, mutex);
+#endif
+}
+
+void signalCondition(Condition* condition) {
+#ifdef _WIN32
+    WakeConditionVariable(condition);
+#else
+    pthread_cond_signal(condition);
+#endif
+}
+
+void broadcastCondition(Condition* condition) {
+#ifdef _WIN32
+    WakeAllConditionVariable(condition);
+#else
+    pthread_cond_broadcast(condition);
+#endif
+}
+
+void destroyCondition(Condition* condition) {
+#ifdef _WIN32
+    // windows condition variables hold no resources
+    (void)condition;
+#else
+    pthread_cond_destroy(condition);
+#endif
+}
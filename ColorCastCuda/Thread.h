@@ -0,0 +1,61 @@
+#ifndef COLORCAST_THREAD_H
+#define COLORCAST_THREAD_H
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Condition;
+#else
+#include <pthread.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+#endif
+
+// marks a global that every thread has its own copy of
+#ifdef _WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// a task run by runParallel, index is the number of the task from 0 to numTasks - 1
+typedef void (*ParallelTask)(void* context, int index);
+
+// the function a thread started with startThread runs
+typedef void (*ThreadMain)(void* arg);
+
+// returns the number of logical cores of the machine
+int getNumCores();
+
+// sets the number of threads used for parallel work, 0 uses one thread per core
+void setNumThreads(int numThreads);
+
+// returns the number of threads used for parallel work
+int getNumThreads();
+
+// runs task for every index from 0 to numTasks - 1 spread over getNumThreads()
+// threads and returns once all of them have completed. The calling thread
+// takes part in the work.
+void runParallel(ParallelTask task, void* context, int numTasks);
+
+// starts a thread running main(arg). returns 0 on success, -1 on failure
+int startThread(Thread* thread, ThreadMain main, void* arg);
+
+// waits for a thread started with startThread to return
+void joinThread(Thread* thread);
+
+void initMutex(Mutex* mutex);
+void lockMutex(Mutex* mutex);
+void unlockMutex(Mutex* mutex);
+void destroyMutex(Mutex* mutex);
+
+// a condition is always waited on while holding the mutex that guards the state it signals
+void initCondition(Condition* condition);
+void waitCondition(Condition* condition, Mutex* mutex);
+void signalCondition(Condition* condition);
+void broadcastCondition(Condition* condition);
+void destroyCondition(Condition* condition);
+
+#endif //COLORCAST_THREAD_H
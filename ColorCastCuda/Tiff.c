@@ -1,5 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "Clock.h"
+#include "Failure.h"
+#include "Stage.h"
 #include "Tiff.h"
 
 extern const int NUM_CHANNELS;
@@ -76,6 +80,12 @@ void setStripOffsets(Tiff* tiff, DirEntry dirEntry) {
             // type == 3 signifies 2 byte integer so set size to 2 bytes.
             size = 2;
         }
+        // the array must be inside the file
+        if ((unsigned long long)ptr + (unsigned long long)tiff->numStrips * size > tiff->dataLen) {
+            free(tiff->stripOffsets);
+            tiff->stripOffsets = NULL;
+            return;
+        }
         // set each strip offset
         for (int stripIndex = 0; stripIndex < tiff->numStrips; stripIndex++) {
             tiff->stripOffsets[stripIndex] = getInt(ptr, size, tiff->data, tiff->isLittle);
@@ -105,6 +115,12 @@ void setBytesPerStrip(Tiff* tiff, DirEntry dirEntry) {
             size = 2;
         }
 
+        // the array must be inside the file
+        if ((unsigned long long)ptr + (unsigned long long)tiff->numStrips * size > tiff->dataLen) {
+            free(tiff->bytesPerStrip);
+            tiff->bytesPerStrip = NULL;
+            return;
+        }
         for (int stripIndex = 0; stripIndex < tiff->numStrips; stripIndex++) {
             tiff->bytesPerStrip[stripIndex] = getInt(ptr, size, tiff->data, tiff->isLittle);
             ptr += size;
@@ -115,6 +131,7 @@ void setBytesPerStrip(Tiff* tiff, DirEntry dirEntry) {
 // set numStrips, stripOffsets, and bytesPerStrip variables in
 // the given tiff struct
 void setStripValues(Tiff* tiff) {
+    unsigned int numOffsets = 0;
     for (int i = 0; i < tiff->numEntries; i++) {
         DirEntry dirEntry = tiff->entries[i];
         // strip offsets tag, this if statement should always occur first
@@ -122,6 +139,7 @@ void setStripValues(Tiff* tiff) {
         // according to TIFF 6.0 specifications.
         if (dirEntry.tag == 273) {
             tiff->numStrips = dirEntry.count;
+            numOffsets = dirEntry.count;
             setStripOffsets(tiff, dirEntry);
         }
         // bytes per strip tag
@@ -130,39 +148,76 @@ void setStripValues(Tiff* tiff) {
             setBytesPerStrip(tiff, dirEntry);
         }
     }
+
+    // both arrays need an entry for every strip, isValidTiff rejects a tiff without strips
+    if (numOffsets != tiff->numStrips) {
+        tiff->numStrips = 0;
+    }
 }
 
-// opens tiff file and sets all variables in
-// tiff struct
-Tiff* openTiff(char* path, unsigned int fileLen) {
-    FILE* file = fopen(path, "rb");
-    if (file == NULL) {
-        printf("ERROR: could not open file\n");
+// parses a tiff already in memory and sets all variables in the tiff struct.
+// The tiff points into data without taking ownership of it
+Tiff* readTiff(unsigned char* data, unsigned long dataLen) {
+    // the header is 8 bytes, the endianness and magic number are checked first
+    if (dataLen < 8) {
+        reportFailure("not a tiff!");
         return NULL;
     }
 
     Tiff* tiff = malloc(sizeof(Tiff));
-
-    tiff->dataLen = fileLen;
-    tiff->data = (unsigned char*)malloc(fileLen * sizeof(char));
-    // read in file data into tiff->data
-    fread(tiff->data, fileLen, 1, file);
-    fclose(file);
+    tiff->dataLen = dataLen;
+    tiff->data = data;
     // determine whether tiff is little or big endian
     tiff->isLittle = isLittleEndian(tiff->data);
-    // make sure file has tiff magic number
-    if (!isTiffNum(tiff)) {
-        printf("ERROR: not a tiff!\n");
+    // BigTIFF has 8 byte offsets, which every reader below assumes are 4
+    if (getInt(2, 2, tiff->data, tiff->isLittle) == 43) {
+        reportFailure("BigTIFF is not supported");
+        free(tiff);
+        return NULL;
+    }
+    // make sure file has tiff magic number and the directory is inside the file
+    unsigned int pointer = getInt(4, 4, tiff->data, tiff->isLittle);
+    if (!isTiffNum(tiff) || pointer > dataLen - 2
+        || pointer + 2 + (unsigned long)getInt(pointer, 2, tiff->data, tiff->isLittle) * 12 > dataLen - 4) {
+        reportFailure("not a tiff!");
         free(tiff);
         return NULL;
     }
     // setup tiff values
+    tiff->numStrips = 0;
+    tiff->stripOffsets = NULL;
+    tiff->bytesPerStrip = NULL;
     setEntries(tiff);
     tiff->bitsPerSample = getBitsPerSample(tiff);
     setStripValues(tiff);
 
     return tiff;
 }
+
+// opens tiff file and sets all variables in
+// tiff struct
+Tiff* openTiff(char* path, unsigned int fileLen) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        reportFailure("could not open file");
+        return NULL;
+    }
+
+    double start = getMonotonicTime();
+    unsigned char* data = (unsigned char*)malloc(fileLen * sizeof(char));
+    // read in file data into tiff->data
+    fread(data, fileLen, 1, file);
+    fclose(file);
+    addStageTime(STAGE_READ, getMonotonicTime() - start, fileLen, 0);
+
+    Tiff* tiff = readTiff(data, fileLen);
+    if (tiff == NULL) {
+        free(data);
+    }
+
+    return tiff;
+}
+
 // returns 1 if the tiff is compressed
 int isCompressed(Tiff* tiff) {
     for (int i = 0; i < tiff->numEntries; i++) {
@@ -203,26 +258,92 @@ int isRGB(Tiff* tiff) {
     return 0;
 }
 
-// is used to determine if the tiff can be read by program
-int isValidTiff(Tiff* tiff) {
+// returns true if the tiff has strips and every one lies inside the file
+int hasValidStrips(Tiff* tiff) {
+    if (tiff->numStrips == 0 || tiff->stripOffsets == NULL || tiff->bytesPerStrip == NULL) {
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < tiff->numStrips; i++) {
+        if ((unsigned long long)tiff->stripOffsets[i] + tiff->bytesPerStrip[i] > tiff->dataLen) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// returns true if the channels of the tiff are stored in separate planes instead
+// of interleaved per pixel
+int isPlanar(Tiff* tiff) {
+    for (unsigned int i = 0; i < tiff->numEntries; i++) {
+        DirEntry entry = tiff->entries[i];
+        // tag for PlanarConfiguration, 1 is interleaved and the default
+        if (entry.tag == 284) {
+            return entry.valueOrOffset == 2;
+        }
+    }
+
+    return 0;
+}
+
+// returns true if the tiff stores its pixels in tiles instead of strips
+int isTiled(Tiff* tiff) {
+    for (unsigned int i = 0; i < tiff->numEntries; i++) {
+        // tags for TileWidth, TileLength, TileOffsets and TileByteCounts
+        unsigned int tag = tiff->entries[i].tag;
+        if (tag >= 322 && tag <= 325) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// determines from the directory alone if the pixels of the tiff can be converted
+int isSupportedTiff(Tiff* tiff) {
     if (isCompressed(tiff)) {
-        printf("ERROR: tiff is compressed\n");
+        reportFailure("tiff is compressed");
         return 0;
     }
 
     if (isMultiFiled(tiff)) {
-        printf("ERROR: tiff contains multiple Image File Directories\n"
-            "meaning it probably contains multiple images\n");
+        reportFailure("tiff contains multiple Image File Directories, "
+            "meaning it probably contains multiple images");
         return 0;
     }
 
     if (!isRGB(tiff)) {
-        printf("ERROR: tiff is not rgb\n");
+        reportFailure("tiff is not rgb");
+        return 0;
+    }
+
+    if (isTiled(tiff)) {
+        reportFailure("tiled tiffs are not supported");
+        return 0;
+    }
+
+    if (isPlanar(tiff)) {
+        reportFailure("tiff stores its channels in separate planes");
         return 0;
     }
 
     if (tiff->bitsPerSample == -1) {
-        printf("ERROR: not 3 channels per bit or samples per bit are not the same\n");
+        reportFailure("not 3 channels per bit or samples per bit are not the same");
+        return 0;
+    }
+
+    return 1;
+}
+
+// is used to determine if the tiff can be read by program
+int isValidTiff(Tiff* tiff) {
+    if (!isSupportedTiff(tiff)) {
+        return 0;
+    }
+
+    if (!hasValidStrips(tiff)) {
+        reportFailure("tiff strips are missing or outside of the file");
         return 0;
     }
 
@@ -300,14 +421,311 @@ void setPixel(Tiff* tiff, int* rgb, unsigned long pixIndex, unsigned long startO
 }
 
 // write the data stored in tiff struct to the output file
-void writeTiff(Tiff* tiff, char* path) {
+int writeTiff(Tiff* tiff, char* path) {
+    double start = getMonotonicTime();
     FILE* file = fopen(path, "wb+");
-    fwrite(tiff->data, sizeof(char), tiff->dataLen, file);
+    if (file == NULL) {
+        reportFailure("could not open output file");
+        return -1;
+    }
+    size_t written = fwrite(tiff->data, sizeof(char), tiff->dataLen, file);
 
-    fclose(file);
+    if (fclose(file) != 0 || written != tiff->dataLen) {
+        reportFailure("could not write tiff");
+        return -1;
+    }
+    addStageTime(STAGE_WRITE, getMonotonicTime() - start, tiff->dataLen,
+        (unsigned long long)getWidth(tiff) * getHeight(tiff));
+    return 0;
 }
 
 
 
 
 
+
+// returns the number of bytes a single value of the given tiff field type takes up
+unsigned int getTypeSize(unsigned int type) {
+    switch (type) {
+    case 3: // SHORT
+    case 8: // SSHORT
+        return 2;
+    case 4: // LONG
+    case 9: // SLONG
+    case 11: // FLOAT
+        return 4;
+    case 5: // RATIONAL
+    case 10: // SRATIONAL
+    case 12: // DOUBLE
+    case 16: // LONG8, BigTIFF only
+    case 17: // SLONG8
+    case 18: // IFD8
+        return 8;
+    default: // BYTE, ASCII, SBYTE, UNDEFINED
+        return 1;
+    }
+}
+
+// returns how many bytes from the start of the tiff are needed to parse it: the header,
+// the directory and every value the directory points to, but not the strips. Only the
+// first dataLen bytes of data are looked at, when they are too few to tell the result
+// is larger than dataLen and asking again with more bytes gives a larger answer
+unsigned long long getTiffDirectoryEnd(unsigned char* data, unsigned long dataLen) {
+    if (dataLen < 8) {
+        return 8;
+    }
+
+    int isLittle = isLittleEndian(data);
+    unsigned long long pointer = getInt(4, 4, data, isLittle);
+    if (dataLen < pointer + 2) {
+        return pointer + 2;
+    }
+
+    unsigned int numEntries = getInt((unsigned int)pointer, 2, data, isLittle);
+    // the pointer to the next directory follows the entries
+    unsigned long long end = pointer + 2 + numEntries * 12ULL + 4;
+    if (dataLen < end) {
+        return end;
+    }
+
+    for (unsigned int i = 0; i < numEntries; i++) {
+        DirEntry entry = getDirEntry(data, (unsigned int)pointer + 2 + i * 12, isLittle);
+        // values of up to 4 bytes are stored in the entry itself
+        unsigned long long size = (unsigned long long)entry.count * getTypeSize(entry.type);
+        if (size > 4 && entry.valueOrOffset + size > end) {
+            end = entry.valueOrOffset + size;
+        }
+    }
+
+    return end;
+}
+
+// returns true if the tag is one that restripeTiff regenerates
+int isStripTag(unsigned int tag) {
+    // StripOffsets, RowsPerStrip and StripByteCounts
+    return tag == 273 || tag == 278 || tag == 279;
+}
+
+// returns true if the tag points to another IFD. These can not be carried over
+// when the file is rebuilt because their contents are not copied.
+int isSubIfdTag(unsigned int tag) {
+    // SubIFDs, Exif IFD, GPS IFD and Interoperability IFD
+    return tag == 330 || tag == 34665 || tag == 34853 || tag == 40965;
+}
+
+// writes the byte order, magic number and pointer to the first directory of a
+// classic tiff, or of a BigTIFF with 8 byte offsets if isBig
+void writeTiffHeader(unsigned char* data, unsigned long long directoryPtr, int isBig, int isLittle) {
+    data[0] = data[1] = isLittle ? 'I' : 'M';
+    setInt(isBig ? 43 : 42, 2, 2, data, isLittle);
+    if (isBig) {
+        // bytes per offset, then a reserved 0 and the 8 byte pointer to the directory
+        setInt(8, 4, 2, data, isLittle);
+        setInt(0, 6, 2, data, isLittle);
+        setLong(directoryPtr, 8, 8, data, isLittle);
+    }
+    else {
+        setInt((unsigned int)directoryPtr, 4, 4, data, isLittle);
+    }
+}
+
+// returns how many bytes the directory and the values that do not fit in its entries take up
+unsigned long long getTiffDirectoryLength(const TiffEntry* entries, int numEntries, int isBig) {
+    unsigned int inlineSize = isBig ? 8 : 4;
+    unsigned long long len = isBig ? 8 + numEntries * 20ULL + 8 : 2 + numEntries * 12ULL + 4;
+
+    for (int i = 0; i < numEntries; i++) {
+        unsigned long long size = entries[i].count * getTypeSize(entries[i].type);
+        if (size > inlineSize) {
+            // values start on a word boundary
+            len += size + (size & 1);
+        }
+    }
+
+    return len;
+}
+
+// writes the directory at pointer followed by the values that do not fit in its entries,
+// with no directory after it
+void writeTiffDirectory(unsigned char* data, unsigned long long pointer, const TiffEntry* entries, int numEntries,
+    int isBig, int isLittle) {
+    unsigned int countSize = isBig ? 8 : 2;
+    unsigned int entrySize = isBig ? 20 : 12;
+    unsigned int inlineSize = isBig ? 8 : 4;
+
+    setLong(numEntries, (unsigned int)pointer, countSize, data, isLittle);
+    unsigned int entryPtr = (unsigned int)pointer + countSize;
+    unsigned int nextPtr = entryPtr + numEntries * entrySize;
+    unsigned int valuePtr = nextPtr + inlineSize;
+    // pointer to the next directory, there is none
+    setLong(0, nextPtr, inlineSize, data, isLittle);
+
+    for (int i = 0; i < numEntries; i++) {
+        const TiffEntry* entry = &entries[i];
+        unsigned int typeSize = getTypeSize(entry->type);
+        unsigned long long size = entry->count * typeSize;
+        setInt(entry->tag, entryPtr, 2, data, isLittle);
+        setInt(entry->type, entryPtr + 2, 2, data, isLittle);
+        setLong(entry->count, entryPtr + 4, isBig ? 8 : 4, data, isLittle);
+
+        // small values are stored left justified in the entry itself
+        unsigned int valuesAt = entryPtr + (isBig ? 12 : 8);
+        if (size > inlineSize) {
+            setLong(valuePtr, valuesAt, inlineSize, data, isLittle);
+            valuesAt = valuePtr;
+            valuePtr += (unsigned int)(size + (size & 1));
+        }
+
+        if (entry->bytes != NULL) {
+            memcpy(data + valuesAt, entry->bytes, (size_t)size);
+        }
+        else {
+            for (unsigned long long j = 0; j < entry->count; j++) {
+                unsigned long long value = entry->values != NULL ? entry->values[j] : entry->value;
+                setLong(value, valuesAt + (unsigned int)j * typeSize, typeSize, data, isLittle);
+            }
+        }
+        entryPtr += entrySize;
+    }
+}
+
+// rebuilds the tiff so the pixel data is split into strips of roughly targetStripSize
+// bytes (always at least one row per strip) placed contiguously after the IFD.
+// StripOffsets, RowsPerStrip and StripByteCounts are regenerated, every other tag
+// is copied over. Returns 0 on success, -1 if the tiff could not be restriped.
+int restripeTiff(Tiff* tiff, unsigned int targetStripSize) {
+    unsigned int width = getWidth(tiff);
+    unsigned int height = getHeight(tiff);
+    unsigned long bytesPerRow = (unsigned long)width * NUM_CHANNELS * (tiff->bitsPerSample / 8);
+    unsigned long imageLen = bytesPerRow * height;
+
+    if (bytesPerRow == 0 || targetStripSize == 0) {
+        reportFailure("can not restripe tiff");
+        return -1;
+    }
+
+    unsigned long stripDataLen = 0;
+    for (unsigned int i = 0; i < tiff->numStrips; i++) {
+        stripDataLen += tiff->bytesPerStrip[i];
+    }
+    if (stripDataLen < imageLen) {
+        reportFailure("strips do not contain the whole image");
+        return -1;
+    }
+
+    unsigned int rowsPerStrip = targetStripSize / bytesPerRow;
+    if (rowsPerStrip == 0) {
+        rowsPerStrip = 1;
+    }
+    if (rowsPerStrip > height) {
+        rowsPerStrip = height;
+    }
+    unsigned int numStrips = (height + rowsPerStrip - 1) / rowsPerStrip;
+
+    // the entries of the new IFD, every old one but the strip tags, which are written anew
+    unsigned int oldIfd = getInt(4, 4, tiff->data, tiff->isLittle);
+    TiffEntry* newEntries = malloc((tiff->numEntries + 3) * sizeof(TiffEntry));
+    unsigned long long* stripValues = malloc(numStrips * 2 * sizeof(unsigned long long));
+    if (newEntries == NULL || stripValues == NULL) {
+        free(newEntries);
+        free(stripValues);
+        reportFailure("not enough memory to restripe tiff");
+        return -1;
+    }
+    unsigned long long* offsetValues = stripValues;
+    unsigned long long* countValues = stripValues + numStrips;
+
+    unsigned int numEntries = 0;
+    for (unsigned int i = 0; i < tiff->numEntries; i++) {
+        DirEntry entry = tiff->entries[i];
+        if (isStripTag(entry.tag) || isSubIfdTag(entry.tag)) {
+            continue;
+        }
+
+        // copy the raw values so they keep their original byte layout
+        unsigned int oldEntryPtr = oldIfd + 2 + i * 12;
+        unsigned long size = (unsigned long)getTypeSize(entry.type) * entry.count;
+        unsigned int oldValuePtr = size > 4 ? entry.valueOrOffset : oldEntryPtr + 8;
+        newEntries[numEntries++] = (TiffEntry){ .tag = entry.tag, .type = entry.type, .count = entry.count,
+            .bytes = tiff->data + oldValuePtr };
+    }
+    newEntries[numEntries++] = (TiffEntry){ .tag = 273, .type = 4, .count = numStrips, .values = offsetValues };
+    newEntries[numEntries++] = (TiffEntry){ .tag = 278, .type = 4, .count = 1, .value = rowsPerStrip };
+    newEntries[numEntries++] = (TiffEntry){ .tag = 279, .type = 4, .count = numStrips, .values = countValues };
+
+    // the strip entries were appended at the end, sort the IFD so it is in
+    // ascending tag order again as required by TIFF 6.0
+    for (unsigned int i = 1; i < numEntries; i++) {
+        for (unsigned int j = i; j > 0 && newEntries[j - 1].tag > newEntries[j].tag; j--) {
+            TiffEntry temp = newEntries[j - 1];
+            newEntries[j - 1] = newEntries[j];
+            newEntries[j] = temp;
+        }
+    }
+
+    // layout of the new file: header | IFD | out of line values | strips
+    unsigned int ifdPtr = 8;
+    unsigned int pixelPtr = ifdPtr + (unsigned int)getTiffDirectoryLength(newEntries, numEntries, 0);
+    unsigned long newLen = pixelPtr + imageLen;
+
+    unsigned int* stripOffsets = malloc(numStrips * sizeof(unsigned int));
+    unsigned int* bytesPerStrip = malloc(numStrips * sizeof(unsigned int));
+    DirEntry* entries = malloc(numEntries * sizeof(DirEntry));
+    unsigned char* data = calloc(newLen, sizeof(char));
+    if (stripOffsets == NULL || bytesPerStrip == NULL || entries == NULL || data == NULL) {
+        free(newEntries);
+        free(stripValues);
+        free(stripOffsets);
+        free(bytesPerStrip);
+        free(entries);
+        free(data);
+        reportFailure("not enough memory to restripe tiff");
+        return -1;
+    }
+    int isLittle = tiff->isLittle;
+
+    for (unsigned int i = 0; i < numStrips; i++) {
+        unsigned int rows = rowsPerStrip;
+        if ((i + 1) * rowsPerStrip > height) {
+            rows = height - i * rowsPerStrip;
+        }
+        stripOffsets[i] = pixelPtr + i * rowsPerStrip * bytesPerRow;
+        bytesPerStrip[i] = rows * bytesPerRow;
+        offsetValues[i] = stripOffsets[i];
+        countValues[i] = bytesPerStrip[i];
+    }
+
+    writeTiffHeader(data, ifdPtr, 0, isLittle);
+    writeTiffDirectory(data, ifdPtr, newEntries, numEntries, 0, isLittle);
+    for (unsigned int i = 0; i < numEntries; i++) {
+        entries[i] = getDirEntry(data, ifdPtr + 2 + i * 12, isLittle);
+    }
+    free(newEntries);
+    free(stripValues);
+
+    // copy the old strips one after another into the contiguous pixel area
+    unsigned long copied = 0;
+    for (unsigned int i = 0; i < tiff->numStrips && copied < imageLen; i++) {
+        unsigned long len = tiff->bytesPerStrip[i];
+        if (copied + len > imageLen) {
+            len = imageLen - copied;
+        }
+        memcpy(data + pixelPtr + copied, tiff->data + tiff->stripOffsets[i], len);
+        copied += len;
+    }
+
+    free(tiff->data);
+    free(tiff->entries);
+    free(tiff->stripOffsets);
+    free(tiff->bytesPerStrip);
+
+    tiff->data = data;
+    tiff->dataLen = newLen;
+    tiff->entries = entries;
+    tiff->numEntries = numEntries;
+    tiff->numStrips = numStrips;
+    tiff->stripOffsets = stripOffsets;
+    tiff->bytesPerStrip = bytesPerStrip;
+
+    return 0;
+}
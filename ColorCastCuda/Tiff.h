@@ -16,14 +16,53 @@ typedef struct {
     unsigned int* stripOffsets;     // offset (pointer) of each strip in file
 } Tiff;
 
+// a directory entry before it is written. bytes holds the count values already in the
+// byte order of the file if it is set, otherwise values does, or value if all are the same
+typedef struct {
+    unsigned int tag;
+    unsigned int type;
+    unsigned long long count;
+    unsigned long long value;
+    const unsigned long long* values;
+    const unsigned char* bytes;
+} TiffEntry;
+
+// parses a tiff already in memory, returns null if data does not start with a
+// tiff header. The tiff points into data and does not take ownership of it
+Tiff* readTiff(unsigned char* data, unsigned long dataLen);
+
 // returns a tiff struct, returns null if cannot
 // open file or file does not have tif magic number
 Tiff* openTiff(char* path, unsigned int fileLen);
 
+// determines from the directory alone if this program can convert the tif,
+// without checking that the strips are inside data. prints why it can not
+int isSupportedTiff(Tiff* tiff);
+
 // determines in this program can read tif
 // prints why tif is invalid
 int isValidTiff(Tiff* tiff);
 
+// returns how many bytes from the start of a tiff are needed to parse it with
+// readTiff, everything but the strips. Looks at the first dataLen bytes only, while
+// they are too few the result is larger than dataLen and grows as more are given
+unsigned long long getTiffDirectoryEnd(unsigned char* data, unsigned long dataLen);
+
+// returns the number of bytes a single value of the given tiff field type takes up
+unsigned int getTypeSize(unsigned int type);
+
+// writes the byte order, magic number and pointer to the first directory of a
+// classic tiff, or of a BigTIFF with 8 byte offsets if isBig
+void writeTiffHeader(unsigned char* data, unsigned long long directoryPtr, int isBig, int isLittle);
+
+// returns how many bytes writeTiffDirectory writes for the entries
+unsigned long long getTiffDirectoryLength(const TiffEntry* entries, int numEntries, int isBig);
+
+// writes a directory of entries, which must be sorted by tag, at pointer followed by the
+// values that do not fit in the entries themselves, with no directory after it
+void writeTiffDirectory(unsigned char* data, unsigned long long pointer, const TiffEntry* entries, int numEntries,
+    int isBig, int isLittle);
+
 // returns width of image
 unsigned int getWidth(Tiff* tiff);
 
@@ -38,6 +77,11 @@ int* getPixel(Tiff* tiff, unsigned long pixIndex, unsigned long startOffset);
 void setPixel(Tiff* tiff, int* rgb, unsigned long pixIndex, unsigned long startOffset);
 
 // writes the tiff data to the output file
-void writeTiff(Tiff* tiff, char* path);
+// returns 0 on success, -1 on failure
+int writeTiff(Tiff* tiff, char* path);
+
+// rebuilds the tiff so its pixel data is stored in contiguous strips of roughly
+// targetStripSize bytes. returns 0 on success, -1 on failure
+int restripeTiff(Tiff* tiff, unsigned int targetStripSize);
 
 #endif //COLORCAST_TIFF_H
@@ -0,0 +1,238 @@
+#include "Trace.h"
+
+#ifdef COLORCAST_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Clock.h"
+#include "Thread.h"
+
+// longest detail kept with an event, longer ones keep their end, which for
+// paths is the file name
+#define TRACE_DETAIL_LENGTH 40
+
+typedef struct {
+    double start;                       // microseconds since the trace started
+    double duration;                    // microseconds, complete events only
+    const char* name;
+    char phase;                         // 'B'egin, 'E'nd or 'X' for complete
+    char detail[TRACE_DETAIL_LENGTH];
+} TraceEvent;
+
+// the events of one thread. Buffers of threads that ended are reused by new threads
+// of the same name, so short lived threads of runParallel share a few timelines
+typedef struct {
+    TraceEvent* events;                 // ring of TRACE_BUFFER_EVENTS
+    unsigned long long count;           // events ever recorded
+    int id;
+    const char* threadName;
+    int inUse;
+} TraceBuffer;
+
+static int isTracing = 0;
+static double traceStart;
+static char* tracePath;
+static Mutex bufferLock;                // guards the list of buffers, not their events
+static TraceBuffer** buffers;
+static int numBuffers;
+static THREAD_LOCAL TraceBuffer* threadBuffer = NULL;
+
+// writes a string with the quoting of json
+void writeTraceString(FILE* file, const char* str) {
+    fputc('"', file);
+    for (const unsigned char* c = (const unsigned char*)str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        }
+        else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        }
+        else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// writes every buffer to the trace file, called when the program exits
+void writeTrace() {
+    FILE* file = fopen(tracePath, "w");
+    if (file == NULL) {
+        printf("ERROR: could not write trace to %s\n", tracePath);
+        return;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int isFirst = 1;
+    lockMutex(&bufferLock);
+    for (int i = 0; i < numBuffers; i++) {
+        TraceBuffer* buffer = buffers[i];
+        if (buffer->threadName != NULL) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                isFirst ? "" : ",\n", buffer->id);
+            writeTraceString(file, buffer->threadName);
+            fprintf(file, "}}");
+            isFirst = 0;
+        }
+
+        // a full ring has lost its oldest events
+        unsigned long long first = buffer->count > TRACE_BUFFER_EVENTS ? buffer->count - TRACE_BUFFER_EVENTS : 0;
+        for (unsigned long long j = first; j < buffer->count; j++) {
+            TraceEvent* event = &buffer->events[j % TRACE_BUFFER_EVENTS];
+            fprintf(file, "%s{\"name\":", isFirst ? "" : ",\n");
+            writeTraceString(file, event->name);
+            fprintf(file, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", event->phase, event->start, buffer->id);
+            if (event->phase == 'X') {
+                fprintf(file, ",\"dur\":%.3f", event->duration);
+            }
+            if (event->detail[0] != '\0') {
+                fprintf(file, ",\"args\":{\"detail\":");
+                writeTraceString(file, event->detail);
+                fputc('}', file);
+            }
+            fputc('}', file);
+            isFirst = 0;
+        }
+    }
+    unlockMutex(&bufferLock);
+    fprintf(file, "\n]}\n");
+
+    if (ferror(file)) {
+        printf("ERROR: could not write trace to %s\n", tracePath);
+    }
+    fclose(file);
+}
+
+// starts recording, the trace is written when the program exits
+int startTrace(const char* path) {
+    // make sure the file can be written before anything is recorded
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("ERROR: could not create trace file %s\n", path);
+        return -1;
+    }
+    fclose(file);
+
+    tracePath = malloc(strlen(path) + 1);
+    strcpy(tracePath, path);
+    initMutex(&bufferLock);
+    traceStart = getMonotonicTime();
+    isTracing = 1;
+    atexit(writeTrace);
+    traceThreadName("main");
+    return 0;
+}
+
+// returns 1 if two thread names, which may be NULL, are the same
+int isSameThreadName(const char* a, const char* b) {
+    return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+// returns the buffer of this thread, the first time the thread records taking a free
+// one of a thread with the same name or making a new one. returns NULL if nothing is recorded
+TraceBuffer* getTraceBuffer(const char* threadName) {
+    if (threadBuffer != NULL || !isTracing) {
+        return threadBuffer;
+    }
+
+    lockMutex(&bufferLock);
+    for (int i = 0; i < numBuffers && threadBuffer == NULL; i++) {
+        if (!buffers[i]->inUse && isSameThreadName(buffers[i]->threadName, threadName)) {
+            threadBuffer = buffers[i];
+        }
+    }
+    if (threadBuffer == NULL) {
+        TraceBuffer* buffer = calloc(1, sizeof(TraceBuffer));
+        TraceBuffer** grown = realloc(buffers, (numBuffers + 1) * sizeof(TraceBuffer*));
+        if (buffer != NULL && grown != NULL) {
+            buffer->events = malloc(TRACE_BUFFER_EVENTS * sizeof(TraceEvent));
+            buffer->id = numBuffers;
+            buffer->threadName = threadName;
+            buffers = grown;
+        }
+        if (buffer != NULL && buffer->events != NULL) {
+            buffers[numBuffers++] = buffer;
+            threadBuffer = buffer;
+        }
+        else {
+            free(buffer);
+        }
+    }
+    if (threadBuffer != NULL) {
+        threadBuffer->inUse = 1;
+    }
+    unlockMutex(&bufferLock);
+
+    return threadBuffer;
+}
+
+// appends an event to the buffer of this thread
+void addTraceEvent(char phase, const char* name, const char* detail, double start, double duration) {
+    TraceBuffer* buffer = getTraceBuffer(NULL);
+    if (buffer == NULL) {
+        return;
+    }
+
+    TraceEvent* event = &buffer->events[buffer->count % TRACE_BUFFER_EVENTS];
+    event->phase = phase;
+    event->name = name;
+    event->start = start;
+    event->duration = duration;
+    event->detail[0] = '\0';
+    if (detail != NULL) {
+        size_t len = strlen(detail);
+        const char* tail = len < TRACE_DETAIL_LENGTH ? detail : detail + len - (TRACE_DETAIL_LENGTH - 1);
+        strcpy(event->detail, tail);
+    }
+    buffer->count++;
+}
+
+// returns the microseconds since the trace started
+double getTraceTime() {
+    return (getMonotonicTime() - traceStart) * 1e6;
+}
+
+// begins a span on this thread
+void traceBegin(const char* name, const char* detail) {
+    if (isTracing) {
+        addTraceEvent('B', name, detail, getTraceTime(), 0);
+    }
+}
+
+// ends the last span begun on this thread
+void traceEnd(const char* name) {
+    if (isTracing) {
+        addTraceEvent('E', name, NULL, getTraceTime(), 0);
+    }
+}
+
+// records a span that lasted seconds and ended now
+void traceComplete(const char* name, double seconds) {
+    if (isTracing) {
+        double end = getTraceTime();
+        addTraceEvent('X', name, NULL, end - seconds * 1e6, seconds * 1e6);
+    }
+}
+
+// names the timeline of this thread, best called before it records anything
+void traceThreadName(const char* name) {
+    TraceBuffer* buffer = getTraceBuffer(name);
+    if (buffer != NULL) {
+        buffer->threadName = name;
+    }
+}
+
+// frees the buffer of this thread for the next thread that starts
+void traceThreadExit() {
+    if (threadBuffer == NULL) {
+        return;
+    }
+
+    lockMutex(&bufferLock);
+    threadBuffer->inUse = 0;
+    unlockMutex(&bufferLock);
+    threadBuffer = NULL;
+}
+
+#endif
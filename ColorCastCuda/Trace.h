@@ -0,0 +1,51 @@
+#ifndef COLORCAST_TRACE_H
+#define COLORCAST_TRACE_H
+
+// records what every thread works on and when, written at exit as a trace_event json
+// file that chrome://tracing and Perfetto open, to see how the stages overlap and where
+// they stall. Only built with COLORCAST_TRACE defined, otherwise every TRACE_ macro is
+// empty and nothing is recorded. Each thread records into a ring buffer of its own
+// without locking, keeping the last TRACE_BUFFER_EVENTS events.
+
+#ifdef COLORCAST_TRACE
+
+#define TRACE_BUFFER_EVENTS (1 << 16)
+
+// starts recording, the trace is written to path when the program exits.
+// returns 0 on success, -1 if the file can not be created
+int startTrace(const char* path);
+
+// begins a span named name on this thread. name must be a string literal, detail
+// is copied and may be NULL
+void traceBegin(const char* name, const char* detail);
+
+// ends the last span begun on this thread
+void traceEnd(const char* name);
+
+// records a span named name that lasted seconds and ended now
+void traceComplete(const char* name, double seconds);
+
+// names the timeline of this thread, called before it records anything so it can
+// continue the timeline of an ended thread of the same name
+void traceThreadName(const char* name);
+
+// hands the buffer of this thread, which is about to end, to the next thread started
+void traceThreadExit();
+
+#define TRACE_BEGIN(name, detail) traceBegin(name, detail)
+#define TRACE_END(name) traceEnd(name)
+#define TRACE_COMPLETE(name, seconds) traceComplete(name, seconds)
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+#define TRACE_THREAD_EXIT() traceThreadExit()
+
+#else
+
+#define TRACE_BEGIN(name, detail)
+#define TRACE_END(name)
+#define TRACE_COMPLETE(name, seconds)
+#define TRACE_THREAD_NAME(name)
+#define TRACE_THREAD_EXIT()
+
+#endif
+
+#endif //COLORCAST_TRACE_H
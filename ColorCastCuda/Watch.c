@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+#include "Platform.h"
+#include "Signal.h"
+#include "Watch.h"
+
+#ifdef __linux__
+
+// room for many events, each name is at most NAME_MAX bytes
+#define WATCH_BUFFER_SIZE (64 * 1024)
+
+struct Watch {
+    char* dir;
+    int fd;                     // inotify instance
+    int stopFd;                 // readable once the program is asked to stop
+    char buffer[WATCH_BUFFER_SIZE];
+    int length;                 // bytes of events in buffer
+    int offset;                 // next event in buffer
+};
+
+// starts reporting the files written or moved into dir
+Watch* startWatch(const char* dir) {
+    Watch* watch = calloc(1, sizeof(Watch));
+    watch->fd = inotify_init1(IN_CLOEXEC);
+    if (watch->fd < 0) {
+        printf("ERROR: can not watch %s\n", dir);
+        free(watch);
+        return NULL;
+    }
+
+    // IN_CLOSE_WRITE fires once a writer closes the file, so images are never read half
+    // written. IN_MOVED_TO catches tools that write a temporary file and rename it
+    if (inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0) {
+        printf("ERROR: can not watch %s\n", dir);
+        close(watch->fd);
+        free(watch);
+        return NULL;
+    }
+
+    watch->stopFd = catchStopSignals();
+    if (watch->stopFd < 0) {
+        close(watch->fd);
+        free(watch);
+        return NULL;
+    }
+    watch->dir = _strdup(dir);
+
+    return watch;
+}
+
+// waits for the next file finished writing into the directory. returns 1 for a file,
+// 0 once stopped and -1 if the directory can no longer be watched
+int nextWatchedFile(Watch* watch, char** path) {
+    while (1) {
+        while (watch->offset < watch->length) {
+            struct inotify_event* event = (struct inotify_event*)(watch->buffer + watch->offset);
+            watch->offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                printf("WARNING: too many files at once in %s, some were missed\n", watch->dir);
+            }
+            // the directory was deleted, moved away or unmounted
+            if (event->mask & IN_IGNORED) {
+                printf("ERROR: %s can no longer be watched\n", watch->dir);
+                return -1;
+            }
+            if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                continue;
+            }
+
+            *path = malloc(strlen(watch->dir) + strlen(event->name) + 2);
+            sprintf(*path, "%s" PATH_SEPARATOR "%s", watch->dir, event->name);
+            return 1;
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = watch->fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = watch->stopFd;
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("ERROR: can not wait for files in %s\n", watch->dir);
+            return -1;
+        }
+        if (fds[1].revents != 0) {
+            return 0;
+        }
+
+        ssize_t length = read(watch->fd, watch->buffer, sizeof(watch->buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            printf("ERROR: can not read the files written into %s\n", watch->dir);
+            return -1;
+        }
+        watch->length = (int)length;
+        watch->offset = 0;
+    }
+}
+
+// stops watching and frees the watch
+void stopWatch(Watch* watch) {
+    releaseStopSignals();
+    close(watch->fd);
+    free(watch->dir);
+    free(watch);
+}
+
+#else
+
+// inotify is only on linux
+Watch* startWatch(const char* dir) {
+    printf("ERROR: watching %s needs linux\n", dir);
+    return NULL;
+}
+
+int nextWatchedFile(Watch* watch, char** path) {
+    (void)watch;
+    (void)path;
+    return 0;
+}
+
+void stopWatch(Watch* watch) {
+    (void)watch;
+}
+
+#endif
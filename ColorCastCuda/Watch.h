@@ -0,0 +1,19 @@
+#ifndef COLORCAST_WATCH_H
+#define COLORCAST_WATCH_H
+
+// a directory watched for files that are completely written into it, only on linux
+typedef struct Watch Watch;
+
+// starts reporting the files written or moved into dir and makes SIGINT and SIGTERM
+// stop the watch instead of the program. returns NULL if dir can not be watched
+Watch* startWatch(const char* dir);
+
+// waits for the next file finished writing into the directory and sets path to its
+// full path, which the caller frees. returns 1 for a file, 0 once the watch is
+// stopped by a signal and -1 if the directory can no longer be watched
+int nextWatchedFile(Watch* watch, char** path);
+
+// stops watching and frees the watch
+void stopWatch(Watch* watch);
+
+#endif //COLORCAST_WATCH_H
@@ -1,85 +1,176 @@
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
-#include <sys/stat.h>
 
 extern "C" {
-	#include "Image.h"
-	#include "Tiff.h"
+	#include "Backend.h"
+	#include "Clock.h"
+	#include "Counters.h"
 	#include "File.h"
+	#include "Hash.h"
+	#include "Image.h"
+	#include "Manifest.h"
+	#include "Metrics.h"
+	#include "Options.h"
+	#include "Pipeline.h"
+	#include "Platform.h"
+	#include "Server.h"
+	#include "Stage.h"
+	#include "Stream.h"
+	#include "Thread.h"
+	#include "Trace.h"
+	#include "Watch.h"
 }
 
 extern "C" const int NUM_CHANNELS = 3;
-// functions in Process.cu that process images on the gpu and write out to output file
-extern int handleImage(char* imagePath, char* outputPath, double power);
-extern int handleSingleStrip(Tiff* tiff, double power, char* outputPath);
-extern int handleMultiStrips(Tiff* tiff, double power, char* outputPath);
 
-// returns the length of the given file in bytes
-// -1 if cannot get length
-unsigned int getFileSize(char* filename) {
-	struct stat discriptor;
+// exit codes so scripts can tell what went wrong
+#define EXIT_ALL_CONVERTED 0
+#define EXIT_SOME_FAILED 1
+#define EXIT_USAGE 2
+#define EXIT_NO_IMAGES 3
 
-	if (stat(filename, &discriptor) == 0) {
-		return discriptor.st_size;
-	}
+// returns a hash of the settings that change the output other than the power
+unsigned long long getSettingsHash(Options* options) {
+	char settings[256];
+	sprintf(settings, "strip-size=%u png-level=%d jpeg-quality=%d jpeg-subsampling=%d preview=%d",
+		options->stripSize, options->pngLevel, options->jpegQuality, options->jpegSubsampling, options->previewScale);
 
-	return -1;
+	return hashBytes((const unsigned char*)settings, (unsigned long)strlen(settings), 0);
 }
 
-// determines in a tiff is valid, if it processes the tif
-// and saves it to the output file path
-// return 0 for success, -1 for failure
-int handleTiff(char* imagePath, char* outputPath, double power) {
-	unsigned int fileLen = getFileSize(imagePath);
-	if (fileLen == -1) {
-		printf("could not find file\n");
-		return -1;
+// returns 1 if the output of the input described by current exists and was made
+// from the same contents with the same power, kernel and settings. Comparing size
+// and modification time is enough for most files, the contents are only hashed
+// when the modification time changed but the size did not
+int isUnchanged(Manifest* manifest, ManifestEntry* current, char* outputPath) {
+	ManifestEntry* entry = findManifestEntry(manifest, current->path, current->power);
+	if (entry == NULL || entry->kernelVersion != current->kernelVersion || entry->settings != current->settings
+		|| entry->size != current->size) {
+		return 0;
 	}
 
-	Tiff* tiff = openTiff(imagePath, fileLen);
-	if (tiff == NULL) {
-		return -1;
+	unsigned long long outputSize;
+	long long outputMtime;
+	if (getFileInfo(outputPath, &outputSize, &outputMtime) != 0) {
+		return 0;
+	}
+	if (entry->mtime == current->mtime) {
+		return 1;
+	}
+
+	// the file was touched or copied, it is unchanged if its contents are. The hash
+	// is kept in current for the other powers of the image
+	if (current->hash == 0 && hashFile(current->path, &current->hash) != 0) {
+		return 0;
 	}
+	if (current->hash != entry->hash) {
+		return 0;
+	}
+	entry->mtime = current->mtime;
+	return 1;
+}
+
+// removes the images that are unchanged for every power since they were last
+// converted from imgPaths and outputPaths, and fills in inputs with what the
+// remaining ones are converted from. Inputs are recorded by their absolute path so
+// runs from another directory or through a symbolic link find them.
+// returns the number of images skipped
+int skipUnchangedImages(Manifest* manifest, Options* options, char** imgPaths, char** outputPaths,
+	ManifestEntry* inputs, int* numImg) {
+	unsigned long long settings = getSettingsHash(options);
+	int numPowers = options->numPowers;
+	int numKept = 0;
+
+	for (int i = 0; i < *numImg; i++) {
+		ManifestEntry current;
+		current.path = getAbsolutePath(imgPaths[i]);
+		current.hash = 0;
+		current.kernelVersion = KERNEL_VERSION;
+		current.settings = settings;
+
+		// an image that can not be read is kept so it is reported as failed
+		int unchanged = current.path != NULL && getFileInfo(current.path, &current.size, &current.mtime) == 0;
+		for (int j = 0; j < numPowers && unchanged; j++) {
+			current.power = options->powers[j];
+			unchanged = isUnchanged(manifest, &current, outputPaths[i * numPowers + j]);
+		}
+
+		if (unchanged) {
+			free(current.path);
+			free(imgPaths[i]);
+			for (int j = 0; j < numPowers; j++) {
+				free(outputPaths[i * numPowers + j]);
+			}
+			continue;
+		}
 
-	int result = 0;
-	// isValidTiff will print the reason why the tiff is not valid
-	if (isValidTiff(tiff)) {
-		// handle tif according how many strips it has
-		if (tiff->numStrips == 1) {
-			result = handleSingleStrip(tiff, power, outputPath);
+		imgPaths[numKept] = imgPaths[i];
+		for (int j = 0; j < numPowers; j++) {
+			outputPaths[numKept * numPowers + j] = outputPaths[i * numPowers + j];
 		}
-		else {
-			result = handleMultiStrips(tiff, power, outputPath);
+		inputs[numKept] = current;
+		numKept++;
+	}
+
+	int numSkipped = *numImg - numKept;
+	*numImg = numKept;
+	return numSkipped;
+}
+
+// orders the pointers to paths by the paths for qsort
+int compareOutputPaths(const void* a, const void* b) {
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// returns 1 and prints the first output path that more than one image would be
+// written to, 0 if every output path is different
+int hasCollidingOutputs(char** outputPaths, int numOutputs) {
+	char** sorted = (char**) malloc(numOutputs * sizeof(char*));
+	memcpy(sorted, outputPaths, numOutputs * sizeof(char*));
+	qsort(sorted, numOutputs, sizeof(char*), compareOutputPaths);
+
+	int collides = 0;
+	for (int i = 1; i < numOutputs && !collides; i++) {
+		if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+			printf("more than one image would be written to %s\n", sorted[i]);
+			collides = 1;
 		}
 	}
-	else {
-		result = -1;
-	}
-	// free all data related to the tif
-	free(tiff->data);
-	free(tiff->entries);
-	free(tiff->stripOffsets);
-	free(tiff->bytesPerStrip);
-	free(tiff);
-	
-	return result;
+
+	free(sorted);
+	return collides;
 }
 
-// prints out timing info for program, notifies user if any images failed
-// and lets the user know conversion has completed
-void notifyUserAtEnd(double timeInSec, int numImg, int numFailedFiles, char errorCode[]) {
+// prints out timing info for program and the images that failed. In gui
+// mode the user is also notified with popups
+void notifyUserAtEnd(double timeInSec, int numImg, int numFailedFiles, char errorCode[], PipelineStats* stats, int gui) {
 	// print out time information of program
 	printf("\n------------------------------------------------------\n\n");
 	printf("Time to complete: %.3f %s\n", timeInSec, "seconds");
-	printf("Average time per image: %.3f\n", timeInSec / numImg);
+	if (numImg > 0) {
+		printf("Average time per image: %.3f\n", timeInSec / numImg);
+	}
+	printf("Busy time per pipeline stage: read %.3f, process %.3f, write %.3f seconds\n",
+		stats->readTime, stats->processTime, stats->writeTime);
+	printf("Jpegs decoded with %s, time per step summed over threads:\n", getJpegDecoderName());
+	printStageTable(&stats->stages);
+	if (stats->peakMemory > 0) {
+		printf("Peak estimated memory in flight: %.1f MB\n", stats->peakMemory / (1024.0 * 1024.0));
+	}
+	printf("Converted %d of %d images on the %s backend\n", numImg - numFailedFiles, numImg, getBackendName(getBackend()));
 
+	if (numFailedFiles > 0) {
+		printf("%s\n", errorCode);
+	}
+
+	if (!gui) {
+		return;
+	}
 
 	// notify user of failed images
 	if (numFailedFiles > 0) {
-		char msg[30];
+		char msg[40];
 		sprintf(msg, "Failed to convert %d images", numFailedFiles);
 		sendWarningPopup("WARNING", msg);
 		sendWarningPopup("WARNING", errorCode);
@@ -88,71 +179,378 @@ void notifyUserAtEnd(double timeInSec, int numImg, int numFailedFiles, char erro
 	sendPopup("", "Conversion has completed!");
 }
 
-int main() {
-	// get the paths for the input and output folders
-	char* inputPath = getDir("Please select the folder of images you want to convert.");
-	char* outputDirPath = getDir("Please select the folder where you want to save the output images.");
-	// get the power from the user to specify how much the program should correct
-	// to true gray
-	double power = getPower();
-	// start the clock
-	clock_t start = clock();
-	// get the number of tifs in the input directory
-	int numImg = getNumImgInDir(_strdup(inputPath));
+// tells the user about an error, with a popup in gui mode
+void reportError(const char* msg, int gui) {
+	printf("%s\n", msg);
+	if (gui) {
+		sendPopup("Error", msg);
+	}
+}
 
-	if (numImg == 0) {
-		sendPopup("Error", "There are no supported images in the input directory you chose. Exiting program.");
-		exit(0);
+// returns 1 if dir is parent or a directory below it, comparing where they resolve to so
+// other spellings and symbolic links of the same directory are caught. A dir that does
+// not exist yet is judged by the closest of its parents that does
+int isInsideDirectory(const char* dir, const char* parent) {
+	char* existing = _strdup(dir);
+	char* dirPath = getAbsolutePath(existing);
+	while (dirPath == NULL) {
+		char* separator = strrchr(existing, PATH_SEPARATOR[0]);
+		if (separator == NULL) {
+			// a relative dir with a single name is in the current directory
+			dirPath = getAbsolutePath(".");
+			break;
+		}
+		*separator = '\0';
+		dirPath = getAbsolutePath(separator == existing ? PATH_SEPARATOR : existing);
 	}
+	free(existing);
 
-	char errorCode[2048] = "";
-	int numFailedFiles = 0;
+	char* parentPath = getAbsolutePath(parent);
+	int inside = 0;
+	if (dirPath != NULL && parentPath != NULL) {
+		size_t length = strlen(parentPath);
+		// the root ends in a separator and contains everything
+		inside = strncmp(dirPath, parentPath, length) == 0 && (dirPath[length] == '\0'
+			|| dirPath[length] == PATH_SEPARATOR[0] || parentPath[length - 1] == PATH_SEPARATOR[0]);
+	}
 
-	// allocate array for tif paths and set them
-	char** imgPaths = (char**) malloc(numImg * sizeof(char *));
-	setImagePaths(imgPaths, inputPath);
-	// loop through each tif file and process it
-	for (int i = 0; i < numImg; i++) {
-		char* outputFile = getOutputFilePath(imgPaths[i], outputDirPath, power);
-		printf("working on file: %s\n", imgPaths[i]);
-		int result;
-		if (isExtension(imgPaths[i], "jpg") || isExtension(imgPaths[i], "png")) {
-			result = handleImage(imgPaths[i], outputFile, power);
-		}
-		else {
-			result = handleTiff(imgPaths[i], outputFile, power);
-		}
-
-		free(outputFile);
-		// if result of handleImage or handleTiff is -1, then it failed to process
-		// the image, add to counter and add file name to list of failed images
-		if (result == -1) {
-			numFailedFiles++;
-			char fileName[400];
-			char ext[10];
-			_splitpath(imgPaths[i], NULL, NULL, fileName, ext);
-			if (2048 - strlen(errorCode) - strlen(fileName) - 20 > 0) {
-				strcat(errorCode, "\nFailed to convert: ");
-				strcat(errorCode, fileName);
-				strcat(errorCode, ".");
-				strcat(errorCode, ext);
+	free(dirPath);
+	free(parentPath);
+	return inside;
+}
+
+// converts every image written into the watched input directory with pipeline threads
+// and a backend that stay warm between images, until the watch is stopped by a
+// signal. returns the number of images that failed, or -1 if the directory could not be
+// watched until then
+int convertWatchedImages(Watch* watch, Options* options) {
+	if (warmUpBackend() != 0) {
+		printf("WARNING: the %s backend failed to warm up\n", getBackendName(getBackend()));
+	}
+
+	int numPowers = options->numPowers;
+	Pipeline* pipeline = startPipeline(options->stripSize, &options->pipeline);
+	if (pipeline == NULL) {
+		return -1;
+	}
+	printf("\nWatching %s for new images, press Ctrl+C to stop\n", options->inputDir);
+
+	char** outputPaths = (char**) malloc(numPowers * sizeof(char*));
+	int numImg = 0;
+	char* imagePath;
+	int watched;
+	while ((watched = nextWatchedFile(watch, &imagePath)) == 1) {
+		// outputs copied back into the input directory are not converted again
+		if (isSupportedImage(imagePath) && !isOutputFile(imagePath)) {
+			for (int j = 0; j < numPowers; j++) {
+				outputPaths[j] = getOutputFilePath(imagePath, options->inputDir, options->outputDir, options->powers[j]);
+			}
+			ImageRequest request;
+			initImageRequest(&request);
+			request.imagePath = imagePath;
+			request.outputPaths = outputPaths;
+			request.powers = options->powers;
+			request.numPowers = numPowers;
+			submitImage(pipeline, &request);
+			for (int j = 0; j < numPowers; j++) {
+				free(outputPaths[j]);
 			}
-		
+			numImg++;
 		}
+		free(imagePath);
 	}
 
-	double timeInSec = (double)(clock() - start) / 1000;
-	notifyUserAtEnd(timeInSec, numImg, numFailedFiles, errorCode);
+	PipelineStats stats;
+	int numFailedFiles = finishPipeline(pipeline, &stats);
+	printf("\nConverted %d of %d watched images\n", numImg - numFailedFiles, numImg);
+	printStageTable(&stats.stages);
 
-	for (int i = 0; i < numImg; i++) {
-		free(imgPaths[i]);
+	free(outputPaths);
+	return watched < 0 ? -1 : numFailedFiles;
+}
+
+// opens the metrics file of the options, if one was given, for the pipeline to record
+// every image in. returns 0 on success, -1 if it can not be created
+int startMetrics(Options* options) {
+	if (options->metricsPath == NULL) {
+		return 0;
 	}
 
-	free(imgPaths);
-	free(inputPath);
-	free(outputDirPath); 
+	options->pipeline.metrics = openMetrics(options->metricsPath);
+	return options->pipeline.metrics == NULL ? -1 : 0;
+}
 
-	return 0;
+// closes the metrics file started by startMetrics, if any
+void finishMetrics(Options* options) {
+	if (options->pipeline.metrics != NULL) {
+		closeMetrics(options->pipeline.metrics);
+		options->pipeline.metrics = NULL;
+	}
 }
 
+int main(int argc, char** argv) {
+	Options options;
+	if (parseOptions(argc, argv, &options) != 0) {
+		printf("run %s --help for usage\n", argv[0]);
+		return EXIT_USAGE;
+	}
+
+	if (options.help) {
+		printUsage(argv[0]);
+		freeOptions(&options);
+		return EXIT_ALL_CONVERTED;
+	}
+
+#ifdef _WIN32
+	// started without arguments, most likely by double clicking the exe
+	if (argc == 1) {
+		options.gui = 1;
+	}
+#endif
+
+	// the image goes to stdout, so from here on everything else printed goes to stderr
+	FILE* imageOutput = NULL;
+	if (options.stream) {
+		if (options.numPowers != 1 || options.inputDir != NULL || options.outputDir != NULL || options.numFiles != 0
+			|| options.watch || options.serveSocket != NULL || options.connectSocket != NULL) {
+			printf("--stream converts stdin to stdout with a single power and takes no paths\n");
+			freeOptions(&options);
+			return EXIT_USAGE;
+		}
+		imageOutput = openImageStdio();
+		if (imageOutput == NULL) {
+			freeOptions(&options);
+			return EXIT_USAGE;
+		}
+	}
+
+	if (options.tracePath != NULL) {
+#ifdef COLORCAST_TRACE
+		if (startTrace(options.tracePath) != 0) {
+			freeOptions(&options);
+			return EXIT_USAGE;
+		}
+#else
+		printf("this build records no trace, build with COLORCAST_TRACE defined to use --trace\n");
+#endif
+	}
+
+	// without counters the metrics leave their columns empty, everything else works the same
+	if (options.counters && startCounters() != 0) {
+		printf("--counters ignored\n");
+	}
+
+	setPngCompressionLevel(options.pngLevel);
+	setJpegQuality(options.jpegQuality);
+	setJpegSubsampling(options.jpegSubsampling);
+	setNumThreads(options.numThreads);
+	if (setJpegPreviewScale(options.previewScale) != 0) {
+		freeOptions(&options);
+		return EXIT_USAGE;
+	}
+
+	if (setBackend(options.backend) != 0) {
+		reportError("The selected backend is not available on this machine.", options.gui);
+		freeOptions(&options);
+		return EXIT_NO_IMAGES;
+	}
+
+	if (imageOutput != NULL) {
+		int result = convertStream(stdin, imageOutput, options.powers[0], options.pngLevel);
+		fclose(imageOutput);
+		freeOptions(&options);
+		return result == 0 ? EXIT_ALL_CONVERTED : EXIT_SOME_FAILED;
+	}
+
+	// a server takes its paths and powers from the requests of its clients
+	if (options.serveSocket != NULL) {
+		int result = startMetrics(&options) == 0 ? runServer(options.serveSocket, &options) : -1;
+		finishMetrics(&options);
+		freeOptions(&options);
+		return result == 0 ? EXIT_ALL_CONVERTED : EXIT_USAGE;
+	}
+
+	if (options.connectSocket != NULL && (options.watch || options.incremental || options.metricsPath != NULL)) {
+		printf("--watch, --incremental and --metrics convert locally and can not be combined with --connect\n");
+		freeOptions(&options);
+		return EXIT_USAGE;
+	}
+
+	if (options.gui) {
+		// ask for everything that was not given on the command line
+		if (options.inputDir == NULL && options.numFiles == 0) {
+			options.inputDir = getDir("Please select the folder of images you want to convert.");
+		}
+		if (options.outputDir == NULL) {
+			options.outputDir = getDir("Please select the folder where you want to save the output images.");
+		}
+		// get the power from the user to specify how much the program should correct
+		// to true gray
+		if (options.numPowers == 0) {
+			options.powers[0] = getPower();
+			options.numPowers = 1;
+		}
+	}
+
+	if ((options.inputDir == NULL && options.numFiles == 0) || options.outputDir == NULL || options.numPowers == 0) {
+		printf("an input directory or images, an output directory and a power are required\n");
+		printUsage(argv[0]);
+		freeOptions(&options);
+		return EXIT_USAGE;
+	}
+
+	if (options.watch && (options.inputDir == NULL || isInsideDirectory(options.outputDir, options.inputDir))) {
+		printf("--watch needs an input directory that does not contain the output directory\n");
+		freeOptions(&options);
+		return EXIT_USAGE;
+	}
+
+	if (startMetrics(&options) != 0) {
+		freeOptions(&options);
+		return EXIT_USAGE;
+	}
+
+	// the watch starts before the directory is listed so no image written in between
+	// is missed, one written during the first run may be converted twice
+	Watch* watch = NULL;
+	if (options.watch) {
+		watch = startWatch(options.inputDir);
+		if (watch == NULL) {
+			finishMetrics(&options);
+			freeOptions(&options);
+			return EXIT_USAGE;
+		}
+	}
+
+	double start = getMonotonicTime();
+	// the images given on the command line come first, then those in the input directory
+	PathList imgPaths;
+	initPathList(&imgPaths);
+	for (int i = 0; i < options.numFiles; i++) {
+		addPath(&imgPaths, options.files[i]);
+	}
+	if (options.inputDir != NULL) {
+		findImages(options.inputDir, options.recursive, &imgPaths);
+	}
+	int numImg = imgPaths.count;
+	double scanTime = getMonotonicTime() - start;
+
+	if (numImg == 0 && watch == NULL) {
+		reportError("There are no supported images in the input directory you chose. Exiting program.", options.gui);
+		freePathList(&imgPaths);
+		finishMetrics(&options);
+		freeOptions(&options);
+		return EXIT_NO_IMAGES;
+	}
 
+	// every image has an output per power
+	int numPowers = options.numPowers;
+	char** outputPaths = (char**) malloc(numImg * numPowers * sizeof(char*));
+	int* results = (int*) malloc(numImg * sizeof(int));
+	for (int i = 0; i < numImg; i++) {
+		for (int j = 0; j < numPowers; j++) {
+			outputPaths[i * numPowers + j] = getOutputFilePath(imgPaths.paths[i], options.inputDir, options.outputDir,
+				options.powers[j]);
+		}
+	}
+
+	// two images with the same name outside the input directory would write the same output,
+	// and subdirectories of the input directory are mirrored under the output directory
+	int outputsReady = !hasCollidingOutputs(outputPaths, numImg * numPowers);
+	for (int i = 0; i < numImg && outputsReady; i++) {
+		outputsReady = makeParentDirectories(outputPaths[i * numPowers]) == 0;
+	}
+	if (!outputsReady) {
+		for (int i = 0; i < numImg * numPowers; i++) {
+			free(outputPaths[i]);
+		}
+		free(outputPaths);
+		free(results);
+		freePathList(&imgPaths);
+		finishMetrics(&options);
+		freeOptions(&options);
+		return EXIT_USAGE;
+	}
+
+	// with --incremental, images converted before from the same input and settings are skipped
+	Manifest* manifest = NULL;
+	ManifestEntry* inputs = NULL;
+	unsigned long long* inputHashes = NULL;
+	int numSkipped = 0;
+	if (options.incremental) {
+		manifest = loadManifest(options.outputDir);
+		inputs = (ManifestEntry*) malloc(numImg * sizeof(ManifestEntry));
+		inputHashes = (unsigned long long*) calloc(numImg, sizeof(unsigned long long));
+		numSkipped = skipUnchangedImages(manifest, &options, imgPaths.paths, outputPaths, inputs, &numImg);
+		imgPaths.count = numImg;
+		printf("Skipping %d unchanged images\n", numSkipped);
+	}
+
+	// convert every image in a pipeline that overlaps reading, processing and writing,
+	// or hand them to a server that already has one running
+	PipelineStats stats;
+	int numFailedFiles;
+	if (options.connectSocket != NULL) {
+		numFailedFiles = runClient(options.connectSocket, imgPaths.paths, outputPaths, numImg, options.powers,
+			numPowers, results, &stats);
+		if (numFailedFiles < 0) {
+			numFailedFiles = numImg;
+		}
+	}
+	else {
+		numFailedFiles = runPipeline(imgPaths.paths, outputPaths, numImg, options.powers, numPowers,
+			options.stripSize, &options.pipeline, results, inputHashes, &stats);
+	}
+
+	// record the converted images so the next run can skip them
+	if (manifest != NULL) {
+		for (int i = 0; i < numImg; i++) {
+			if (results[i] != 0 || inputs[i].path == NULL) {
+				continue;
+			}
+			inputs[i].hash = inputHashes[i];
+			for (int j = 0; j < numPowers; j++) {
+				inputs[i].power = options.powers[j];
+				setManifestEntry(manifest, &inputs[i]);
+			}
+		}
+		saveManifest(manifest);
+		freeManifest(manifest);
+		for (int i = 0; i < numImg; i++) {
+			free(inputs[i].path);
+		}
+		free(inputs);
+		free(inputHashes);
+	}
+
+	// add the file names of the images that failed to the list of failed images
+	char errorCode[2048] = "";
+	for (int i = 0; i < numImg; i++) {
+		const char* fileName = getFileName(imgPaths.paths[i]);
+		if (results[i] != 0 && strlen(errorCode) + strlen(fileName) + 21 < sizeof(errorCode)) {
+			strcat(errorCode, "\nFailed to convert: ");
+			strcat(errorCode, fileName);
+		}
+		for (int j = 0; j < numPowers; j++) {
+			free(outputPaths[i * numPowers + j]);
+		}
+	}
+
+	stats.stages.seconds[STAGE_SCAN] += scanTime;
+	double timeInSec = getMonotonicTime() - start;
+	notifyUserAtEnd(timeInSec, numImg, numFailedFiles, errorCode, &stats, options.gui);
+
+	if (watch != NULL) {
+		int numWatchedFailed = convertWatchedImages(watch, &options);
+		numFailedFiles += numWatchedFailed < 0 ? 1 : numWatchedFailed;
+		stopWatch(watch);
+	}
+
+	free(outputPaths);
+	free(results);
+	freePathList(&imgPaths);
+	finishMetrics(&options);
+	freeOptions(&options);
+
+	return numFailedFiles > 0 ? EXIT_SOME_FAILED : EXIT_ALL_CONVERTED;
+}
@@ -0,0 +1,531 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#include <psapi.h>
+#define NULL_DEVICE "NUL"
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+#include "Batch.h"
+#include "Clock.h"
+#include "Corpus.h"
+#include "Thread.h"
+
+// the power every image is converted with
+#define BATCH_POWER "5"
+
+// first line of a baseline written by saveBaseline
+#define BASELINE_HEADER "# colorcast batch baseline 2"
+
+// most fields and longest line read from a metrics file
+#define MAX_CSV_FIELDS 64
+#define MAX_CSV_LINE 8192
+
+// a way the pipeline of the program can be run. arguments is a format given the number
+// of cores, passed to the program after the paths
+typedef struct {
+    const char* name;
+    const char* arguments;
+} BatchMode;
+
+// every mode, add new ones here. Serial has one thread in each stage and one image
+// between them, pipelined is how the program runs by default with the kernel and
+// encoders on every core, parallel converts an image per core side by side
+static const BatchMode batchModes[] = {
+    { "serial", "--readers 1 --workers 1 --writers 1 --queue-depth 1 --threads 1" },
+    { "pipelined", "" },
+    { "parallel", "--workers %d --threads 1" }
+};
+#define NUM_BATCH_MODES (int)(sizeof(batchModes) / sizeof(batchModes[0]))
+
+// what a run of a mode measured
+typedef struct {
+    double filesPerSecond;
+    double mbPerSecond;
+    unsigned long long peakMemory;  // most the program held at once, in bytes, measured from outside
+    double p50;                     // per file latency from submission until written, in ms
+    double p99;
+    int numWritten;
+} BatchResult;
+
+// what a baseline was measured on and the files per second of every mode in it
+typedef struct {
+    int numFiles;
+    int width;
+    int height;
+    unsigned int seed;
+    int numCores;
+    double filesPerSecond[NUM_BATCH_MODES];    // 0 for a mode that is not in the baseline
+} BatchBaseline;
+
+// fills in the options used when nothing is given on the command line
+void getDefaultBatchOptions(BatchOptions* options) {
+    memset(options, 0, sizeof(BatchOptions));
+    options->workDir = "batch-benchmark";
+    options->numFiles = 30;
+    options->width = 1024;
+    options->height = 768;
+    options->seed = 1;
+    options->numRuns = 3;
+    options->tolerance = 0.1;
+}
+
+// creates a directory, it is fine if it already exists
+void makeDirectory(const char* path) {
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0777);
+#endif
+}
+
+// removes the files in a directory, leaving its subdirectories. returns 0 on success,
+// -1 if one can not be removed
+int emptyDirectory(const char* path) {
+    size_t pathLength = strlen(path);
+    char* filePath = malloc(pathLength + 512);
+    int result = 0;
+#ifdef _WIN32
+    sprintf(filePath, "%s\\*", path);
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(filePath, &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        free(filePath);
+        return 0;
+    }
+    do {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 && strlen(data.cFileName) < 500) {
+            sprintf(filePath, "%s\\%s", path, data.cFileName);
+            if (remove(filePath) != 0) {
+                printf("ERROR: could not remove %s\n", filePath);
+                result = -1;
+            }
+        }
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        free(filePath);
+        return 0;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strlen(entry->d_name) >= 500) {
+            continue;
+        }
+        sprintf(filePath, "%s/%s", path, entry->d_name);
+        struct stat info;
+        if (stat(filePath, &info) == 0 && !S_ISDIR(info.st_mode) && remove(filePath) != 0) {
+            printf("ERROR: could not remove %s\n", filePath);
+            result = -1;
+        }
+    }
+    closedir(dir);
+#endif
+
+    free(filePath);
+    return result;
+}
+
+// splits a line of a csv file into fields in place, removing the quotes around them
+// and the doubling of quotes within. returns the number of fields
+int splitCsvLine(char* line, char** fields, int maxFields) {
+    int numFields = 0;
+    char* read = line;
+    while (numFields < maxFields) {
+        char* write = read;
+        fields[numFields++] = write;
+        int isQuoted = *read == '"';
+        if (isQuoted) {
+            read++;
+        }
+
+        while (*read != '\0' && *read != '\n' && *read != '\r') {
+            if (isQuoted && *read == '"') {
+                if (read[1] != '"') {
+                    isQuoted = 0;
+                    read++;
+                    continue;
+                }
+                read++;
+            }
+            else if (!isQuoted && *read == ',') {
+                break;
+            }
+            *write++ = *read++;
+        }
+
+        int isLast = *read != ',';
+        *write = '\0';
+        if (isLast) {
+            break;
+        }
+        read++;
+    }
+
+    return numFields;
+}
+
+// returns the index of the field called name in the header of a metrics file, or -1
+int findField(char** fields, int numFields, const char* name) {
+    for (int i = 0; i < numFields; i++) {
+        if (strcmp(fields[i], name) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// sorts latencies in ascending order for qsort
+int compareLatencies(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// returns the latency that fraction of the sorted latencies are at or below
+double getPercentile(const double* sorted, int count, double fraction) {
+    if (count == 0) {
+        return 0;
+    }
+    int index = (int)(fraction * count + 0.999999) - 1;
+    return sorted[index < 0 ? 0 : index];
+}
+
+// fills in the bytes and latencies of result from the metrics csv the
+// program wrote. returns 0 on success, -1 if the file can not be read
+int readBatchMetrics(const char* path, BatchResult* result, unsigned long long* bytesRead) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("ERROR: the program wrote no metrics to %s\n", path);
+        return -1;
+    }
+
+    char* line = malloc(MAX_CSV_LINE);
+    char* fields[MAX_CSV_FIELDS];
+    int statusField = -1;
+    int bytesField = -1;
+    int totalField = -1;
+    if (fgets(line, MAX_CSV_LINE, file) != NULL) {
+        int numFields = splitCsvLine(line, fields, MAX_CSV_FIELDS);
+        statusField = findField(fields, numFields, "status");
+        bytesField = findField(fields, numFields, "bytesRead");
+        totalField = findField(fields, numFields, "totalMs");
+    }
+    if (statusField < 0 || bytesField < 0 || totalField < 0) {
+        printf("ERROR: %s is missing fields of the metrics\n", path);
+        free(line);
+        fclose(file);
+        return -1;
+    }
+
+    int capacity = 64;
+    double* latencies = malloc(capacity * sizeof(double));
+    while (fgets(line, MAX_CSV_LINE, file) != NULL) {
+        int numFields = splitCsvLine(line, fields, MAX_CSV_FIELDS);
+        if (numFields <= statusField || numFields <= bytesField || numFields <= totalField) {
+            continue;
+        }
+
+        if (strcmp(fields[statusField], "written") != 0) {
+            continue;
+        }
+
+        *bytesRead += strtoull(fields[bytesField], NULL, 10);
+        if (result->numWritten == capacity) {
+            capacity *= 2;
+            latencies = realloc(latencies, capacity * sizeof(double));
+        }
+        latencies[result->numWritten++] = atof(fields[totalField]);
+    }
+
+    qsort(latencies, result->numWritten, sizeof(double), compareLatencies);
+    result->p50 = getPercentile(latencies, result->numWritten, 0.5);
+    result->p99 = getPercentile(latencies, result->numWritten, 0.99);
+
+    free(latencies);
+    free(line);
+    fclose(file);
+    return 0;
+}
+
+// runs command and waits for it to exit, filling in the most memory in bytes it held
+// at once. That is measured from outside, so it counts every allocation up to the exit.
+// returns the exit status of the command, -1 if it could not be run
+int runMeasured(char* command, unsigned long long* peakMemory) {
+    *peakMemory = 0;
+#ifdef _WIN32
+    // the program is started directly with its output going to NUL, so the process
+    // measured is the program and not a cmd around it
+    SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    HANDLE nullOutput = CreateFileA(NULL_DEVICE, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &security,
+        OPEN_EXISTING, 0, NULL);
+    STARTUPINFOA startup;
+    memset(&startup, 0, sizeof(STARTUPINFOA));
+    startup.cb = sizeof(STARTUPINFOA);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    startup.hStdOutput = nullOutput;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    PROCESS_INFORMATION process;
+    if (!CreateProcessA(NULL, command, NULL, NULL, TRUE, 0, NULL, NULL, &startup, &process)) {
+        CloseHandle(nullOutput);
+        return -1;
+    }
+
+    WaitForSingleObject(process.hProcess, INFINITE);
+    DWORD exitCode = 0;
+    GetExitCodeProcess(process.hProcess, &exitCode);
+    // the counters of an exited process stay readable while a handle to it is open
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(process.hProcess, &counters, sizeof(counters))) {
+        *peakMemory = counters.PeakWorkingSetSize;
+    }
+
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    CloseHandle(nullOutput);
+    return (int)exitCode;
+#else
+    pid_t child = fork();
+    if (child < 0) {
+        return -1;
+    }
+    if (child == 0) {
+        execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+        _exit(127);
+    }
+
+    // the usage of a child includes that of the children it waited for, so the
+    // shell passes on the peak of the program
+    int status;
+    struct rusage usage;
+    while (wait4(child, &status, 0, &usage) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    // linux reports kilobytes
+    *peakMemory = (unsigned long long)usage.ru_maxrss * 1024;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+// runs the program once over the corpus in a mode, converting every image to the
+// output directory. returns 0 on success, -1 if the metrics can not be read
+int runBatchMode(const BatchOptions* options, const BatchMode* mode, BatchResult* result) {
+    char arguments[256];
+    sprintf(arguments, mode->arguments, getNumCores());
+
+    size_t dirLength = strlen(options->workDir);
+    char* metricsPath = malloc(dirLength + 64);
+    sprintf(metricsPath, "%s/metrics-%s.csv", options->workDir, mode->name);
+    char* command = malloc(strlen(options->program) + 3 * dirLength + strlen(arguments) + 256);
+    // windows starts the program without a shell, runMeasured sends its output to NUL
+#ifdef _WIN32
+    sprintf(command, "\"%s\" -i \"%s/input\" -o \"%s/output\" -p " BATCH_POWER " --metrics \"%s\" %s",
+        options->program, options->workDir, options->workDir, metricsPath, arguments);
+#else
+    sprintf(command, "\"%s\" -i \"%s/input\" -o \"%s/output\" -p " BATCH_POWER " --metrics \"%s\" %s > " NULL_DEVICE,
+        options->program, options->workDir, options->workDir, metricsPath, arguments);
+#endif
+    remove(metricsPath);
+
+    memset(result, 0, sizeof(BatchResult));
+    double start = getMonotonicTime();
+    unsigned long long peakMemory;
+    int status = runMeasured(command, &peakMemory);
+    double seconds = getMonotonicTime() - start;
+    if (status != 0) {
+        printf("WARNING: %s exited with status %d in %s mode\n", options->program, status, mode->name);
+    }
+
+    unsigned long long bytesRead = 0;
+    int readResult = readBatchMetrics(metricsPath, result, &bytesRead);
+    result->peakMemory = peakMemory;
+    result->filesPerSecond = result->numWritten / seconds;
+    result->mbPerSecond = bytesRead / seconds / 1e6;
+
+    free(command);
+    free(metricsPath);
+    return readResult;
+}
+
+// reads a baseline written by saveBaseline. returns 0 on success, -1 if the file can
+// not be read or is not a baseline
+int readBaseline(const char* path, BatchBaseline* baseline) {
+    memset(baseline, 0, sizeof(BatchBaseline));
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[256];
+    if (fgets(line, sizeof(line), file) == NULL || strncmp(line, BASELINE_HEADER, strlen(BASELINE_HEADER)) != 0) {
+        fclose(file);
+        return -1;
+    }
+
+    // the corpus and cores come first, then a line of files/s and MB/s per mode
+    int hasCorpus = 0;
+    int hasCores = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char name[64];
+        double files;
+        double mb;
+        if (sscanf(line, "corpus %d %dx%d %u", &baseline->numFiles, &baseline->width, &baseline->height,
+            &baseline->seed) == 4) {
+            hasCorpus = 1;
+        }
+        else if (sscanf(line, "cores %d", &baseline->numCores) == 1) {
+            hasCores = 1;
+        }
+        else if (sscanf(line, "%63s %lf %lf", name, &files, &mb) == 3) {
+            for (int m = 0; m < NUM_BATCH_MODES; m++) {
+                if (strcmp(name, batchModes[m].name) == 0) {
+                    baseline->filesPerSecond[m] = files;
+                }
+            }
+        }
+    }
+
+    fclose(file);
+    return hasCorpus && hasCores ? 0 : -1;
+}
+
+// returns 1 if the baseline was measured on the corpus of options on as many cores
+// as there are now, printing how they differ if not
+int isComparableBaseline(const BatchBaseline* baseline, const BatchOptions* options) {
+    if (baseline->numFiles == options->numFiles && baseline->width == options->width
+        && baseline->height == options->height && baseline->seed == options->seed
+        && baseline->numCores == getNumCores()) {
+        return 1;
+    }
+
+    printf("ERROR: the baseline was measured on %d files of %dx%d with seed %u on %d cores, this run has "
+        "%d files of %dx%d with seed %u on %d cores\n", baseline->numFiles, baseline->width, baseline->height,
+        baseline->seed, baseline->numCores, options->numFiles, options->width, options->height, options->seed,
+        getNumCores());
+    return 0;
+}
+
+// writes the results of every mode, to be compared with by a later run.
+// returns 0 on success, -1 on failure
+int saveBaseline(const char* path, const BatchOptions* options, const BatchResult* results) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("ERROR: could not create baseline %s\n", path);
+        return -1;
+    }
+
+    // what was measured is data, so a run on another corpus or machine is refused
+    fprintf(file, "%s\n", BASELINE_HEADER);
+    fprintf(file, "corpus %d %dx%d %u\n", options->numFiles, options->width, options->height, options->seed);
+    fprintf(file, "cores %d\n", getNumCores());
+    fprintf(file, "# mode files/s MB/s\n");
+    for (int m = 0; m < NUM_BATCH_MODES; m++) {
+        fprintf(file, "%s %.4f %.4f\n", batchModes[m].name, results[m].filesPerSecond, results[m].mbPerSecond);
+    }
+
+    int result = ferror(file) ? -1 : 0;
+    if (fclose(file) != 0 || result != 0) {
+        printf("ERROR: could not write baseline %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// runs the end to end benchmark
+int runBatchBenchmark(const BatchOptions* options) {
+    // a missing baseline is an error rather than a silent pass, and so is one of a
+    // different corpus or number of cores, whose speed says nothing about this run
+    BatchBaseline baseline;
+    if (options->baselinePath != NULL && readBaseline(options->baselinePath, &baseline) != 0) {
+        printf("ERROR: %s is not a baseline of this benchmark\n", options->baselinePath);
+        return 1;
+    }
+    if (options->baselinePath != NULL && !isComparableBaseline(&baseline, options)) {
+        return 1;
+    }
+
+    char* inputDir = malloc(strlen(options->workDir) + 16);
+    char* outputDir = malloc(strlen(options->workDir) + 16);
+    sprintf(inputDir, "%s/input", options->workDir);
+    sprintf(outputDir, "%s/output", options->workDir);
+    makeDirectory(options->workDir);
+    makeDirectory(inputDir);
+    makeDirectory(outputDir);
+    // files left by an earlier run with more files or another layout would be converted too
+    int isCorpusWritten = emptyDirectory(inputDir) == 0 && emptyDirectory(outputDir) == 0
+        && writeBatchCorpus(inputDir, options->numFiles, options->width, options->height, options->seed) == 0;
+    free(inputDir);
+    free(outputDir);
+    if (!isCorpusWritten) {
+        return 1;
+    }
+
+    printf("%d files of %dx%d, fastest of %d runs of %s on %d cores\n", options->numFiles, options->width,
+        options->height, options->numRuns, options->program, getNumCores());
+    printf("%-10s %8s %8s %9s %8s %8s %9s\n", "mode", "files/s", "MB/s", "peak MB", "p50 ms", "p99 ms", "baseline");
+
+    int failed = 0;
+    BatchResult results[NUM_BATCH_MODES];
+    for (int m = 0; m < NUM_BATCH_MODES; m++) {
+        const BatchMode* mode = &batchModes[m];
+        BatchResult* best = &results[m];
+        memset(best, 0, sizeof(BatchResult));
+        int fewestWritten = options->numFiles;
+        for (int run = 0; run < options->numRuns; run++) {
+            BatchResult result;
+            if (runBatchMode(options, mode, &result) != 0 || result.numWritten < fewestWritten) {
+                fewestWritten = result.numWritten;
+            }
+            if (run == 0 || result.filesPerSecond > best->filesPerSecond) {
+                *best = result;
+            }
+        }
+
+        char comparison[64] = "";
+        if (options->baselinePath != NULL && baseline.filesPerSecond[m] > 0) {
+            double change = best->filesPerSecond / baseline.filesPerSecond[m] - 1;
+            int isSlower = change < -options->tolerance;
+            sprintf(comparison, "%+8.1f%%%s", change * 100, isSlower ? " SLOWER" : "");
+            failed |= isSlower;
+        }
+        else if (options->baselinePath != NULL) {
+            strcpy(comparison, "     none");
+        }
+
+        printf("%-10s %8.2f %8.1f %9.1f %8.1f %8.1f %s\n", mode->name, best->filesPerSecond, best->mbPerSecond,
+            best->peakMemory / (1024.0 * 1024.0), best->p50, best->p99, comparison);
+        if (fewestWritten < options->numFiles) {
+            printf("%-10s converted only %d of %d images in a run\n", mode->name, fewestWritten, options->numFiles);
+            failed = 1;
+        }
+        fflush(stdout);
+    }
+
+    if (options->savePath != NULL && saveBaseline(options->savePath, options, results) != 0) {
+        failed = 1;
+    }
+    if (failed) {
+        printf("FAILED: an image was not converted or a mode is more than %.0f%% slower than the baseline\n",
+            options->tolerance * 100);
+    }
+    else if (options->baselinePath != NULL) {
+        printf("PASSED: no mode is more than %.0f%% slower than the baseline\n", options->tolerance * 100);
+    }
+
+    return failed;
+}
@@ -0,0 +1,29 @@
+#ifndef COLORCAST_BATCH_H
+#define COLORCAST_BATCH_H
+
+// measures the whole program converting a synthetic batch of jpegs, pngs and tiffs in
+// each way it can run its pipeline, and compares the result with an earlier run
+
+// what the end to end benchmark runs and compares against
+typedef struct {
+    const char* program;        // the executable of the program to measure
+    const char* workDir;        // the corpus, outputs and metrics are written here
+    int numFiles;
+    int width;
+    int height;
+    unsigned int seed;
+    int numRuns;                // runs of every mode, the fastest is kept
+    const char* baselinePath;   // results to compare with, NULL for none
+    const char* savePath;       // the results are written here as the next baseline, NULL for none
+    double tolerance;           // fraction of the files per second of the baseline a mode may lose
+} BatchOptions;
+
+// fills in the options used when nothing is given on the command line
+void getDefaultBatchOptions(BatchOptions* options);
+
+// writes the corpus, runs the program on it in every mode and prints files/s, MB/s,
+// peak memory and per file latency. returns 0 if every image was converted and no
+// mode is slower than the baseline allows, 1 otherwise
+int runBatchBenchmark(const BatchOptions* options);
+
+#endif //COLORCAST_BATCH_H
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Backend.h"
+#include "Batch.h"
+#include "ByteOrdering.h"
+#include "Clock.h"
+#include "Corpus.h"
+#include "CpuProcess.h"
+#include "Thread.h"
+#include "Verify.h"
+
+// measures how fast every variant of the color cast kernel processes synthetic pixels
+// of every bit depth and byte order, from buffers that fit in the L1 cache to ones many
+// times the size of the last level cache, next to memcpy of the same buffer as the
+// fastest anything reading and writing that many bytes can be
+
+// the corpus writes tiffs with Tiff.c, which needs to know the channels like the program does
+const int NUM_CHANNELS = 3;
+
+// the power every variant runs with, in the middle of what the program accepts
+#define BENCHMARK_POWER 5.0
+
+// most bytes handed to a kernel at once, the kernels take the length as an unsigned
+// long which is 32 bits on windows. A multiple of 6 so no pixel is split
+#define MAX_CALL_BYTES (1024UL * 1024 * 1020)
+
+// pixels per row the array kernel is given, so its rows are spread over the threads
+#define ARRAY_WIDTH 4096
+
+// sizes of the input buffer, each ends up in a different level of the memory
+static const unsigned long long bufferSizes[] = {
+    16ULL * 1024,           // L1
+    192ULL * 1024,          // L2
+    4ULL * 1024 * 1024,     // L3
+    64ULL * 1024 * 1024,
+    1024ULL * 1024 * 1024,
+    4096ULL * 1024 * 1024
+};
+#define NUM_BUFFER_SIZES (int)(sizeof(bufferSizes) / sizeof(bufferSizes[0]))
+
+// how the channels of the synthetic pixels are stored
+typedef struct {
+    const char* name;
+    int bytesPerChannel;
+    int isLittle;
+} PixelFormat;
+
+static const PixelFormat pixelFormats[] = {
+    { "8 bit", 1, 1 },
+    { "16 bit LE", 2, 1 },
+    { "16 bit BE", 2, 0 }
+};
+#define NUM_PIXEL_FORMATS (int)(sizeof(pixelFormats) / sizeof(pixelFormats[0]))
+
+// runs a variant over numBytes of input, writing the same number of bytes to output.
+// returns 0 on success, -1 on failure
+typedef int (*RunVariant)(unsigned char* input, unsigned char* output, unsigned long long numBytes,
+    const PixelFormat* format);
+
+// returns true if the variant can process the format
+typedef int (*SupportsFormat)(const PixelFormat* format);
+
+// a way of processing pixels that is measured
+typedef struct {
+    const char* name;
+    int numThreads;             // passed to setNumThreads, 0 for one per core
+    Backend backend;
+    RunVariant run;
+    SupportsFormat supports;    // NULL if it supports every format
+} Variant;
+
+// copies the input, what the kernels are compared to
+int runMemcpy(unsigned char* input, unsigned char* output, unsigned long long numBytes, const PixelFormat* format) {
+    (void)format;
+    memcpy(output, input, (size_t)numBytes);
+    return 0;
+}
+
+// runs the kernel of the backend selected for the variant on contiguous pixels,
+// the way tiffs are processed
+int runBuffer(unsigned char* input, unsigned char* output, unsigned long long numBytes, const PixelFormat* format) {
+    double power = BENCHMARK_POWER;
+    for (unsigned long long offset = 0; offset < numBytes; offset += MAX_CALL_BYTES) {
+        unsigned long len = (unsigned long)(numBytes - offset < MAX_CALL_BYTES ? numBytes - offset : MAX_CALL_BYTES);
+        unsigned char* outputs[1] = { output + offset };
+        if (processBuffer(input + offset, len, &power, outputs, 1, format->bytesPerChannel, format->isLittle) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// runs the strided kernel of the library and the python module on rows of ARRAY_WIDTH pixels
+int runArray(unsigned char* input, unsigned char* output, unsigned long long numBytes, const PixelFormat* format) {
+    ptrdiff_t pixelStride = 3 * format->bytesPerChannel;
+    ChannelType type = format->bytesPerChannel == 2 ? CHANNEL_UINT16 : CHANNEL_UINT8;
+    unsigned long long numPixels = numBytes / pixelStride;
+    unsigned long long pixelsPerCall = MAX_CALL_BYTES / 6 / ARRAY_WIDTH * ARRAY_WIDTH;
+
+    for (unsigned long long first = 0; first < numPixels; first += pixelsPerCall) {
+        unsigned long long count = numPixels - first < pixelsPerCall ? numPixels - first : pixelsPerCall;
+        int height = (int)(count / ARRAY_WIDTH);
+        int lastWidth = (int)(count % ARRAY_WIDTH);
+
+        PixelArray in = { input + first * pixelStride, ARRAY_WIDTH * pixelStride, pixelStride, format->bytesPerChannel };
+        PixelArray out = { output + first * pixelStride, ARRAY_WIDTH * pixelStride, pixelStride, format->bytesPerChannel };
+        if (cpuProcessArray(&in, &out, height, ARRAY_WIDTH, type, BENCHMARK_POWER) != 0) {
+            return -1;
+        }
+
+        // the pixels that do not fill a whole row
+        in.data += (ptrdiff_t)height * in.rowStride;
+        out.data += (ptrdiff_t)height * out.rowStride;
+        if (cpuProcessArray(&in, &out, 1, lastWidth, type, BENCHMARK_POWER) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// the array kernel reads 16 bit channels in the byte order of the machine
+int isHostOrder(const PixelFormat* format) {
+    return format->bytesPerChannel == 1 || format->isLittle == isHostLittleEndian();
+}
+
+// every variant, add new kernels here. The cuda variant includes the copies to and
+// from the gpu, which is what processing an image costs
+static const Variant variants[] = {
+    { "memcpy", 1, BACKEND_CPU, runMemcpy, NULL },
+    { "cpu 1 thread", 1, BACKEND_CPU, runBuffer, NULL },
+    { "cpu all threads", 0, BACKEND_CPU, runBuffer, NULL },
+    { "array 1 thread", 1, BACKEND_CPU, runArray, isHostOrder },
+    { "array all threads", 0, BACKEND_CPU, runArray, isHostOrder },
+#ifndef COLORCAST_NO_CUDA
+    { "cuda", 0, BACKEND_CUDA, runBuffer, NULL },
+#endif
+};
+#define NUM_VARIANTS (int)(sizeof(variants) / sizeof(variants[0]))
+
+// set for the variants whose backend is available on this machine
+static int isVariantAvailable[NUM_VARIANTS];
+
+// fills the buffer with pixels from a fixed pseudo random sequence, so every run
+// and every variant sees the same mix of gray and colorful pixels
+void fillSynthetic(unsigned char* data, unsigned long long numBytes) {
+    unsigned int state = 12345;
+    for (unsigned long long i = 0; i < numBytes; i++) {
+        state = state * 1103515245 + 12345;
+        data[i] = (unsigned char)(state >> 16);
+    }
+}
+
+// runs the variant until minTime has passed and at least 3 times, after a first run
+// that warms up the caches and the backend. returns the fastest run in seconds, or
+// a negative number if the variant failed
+double timeVariant(const Variant* variant, unsigned char* input, unsigned char* output, unsigned long long numBytes,
+    const PixelFormat* format, double minTime) {
+    if (variant->run(input, output, numBytes, format) != 0) {
+        return -1;
+    }
+
+    double best = 0;
+    double total = 0;
+    for (int run = 0; run < 3 || total < minTime; run++) {
+        double start = getMonotonicTime();
+        variant->run(input, output, numBytes, format);
+        double seconds = getMonotonicTime() - start;
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+        total += seconds;
+    }
+
+    return best;
+}
+
+// prints a size in the largest unit it is a whole number of
+void formatSize(char* out, unsigned long long numBytes) {
+    if (numBytes >= 1024 * 1024 * 1024 && numBytes % (1024 * 1024 * 1024) == 0) {
+        sprintf(out, "%llu GB", numBytes / (1024 * 1024 * 1024));
+    }
+    else if (numBytes >= 1024 * 1024) {
+        sprintf(out, "%llu MB", numBytes / (1024 * 1024));
+    }
+    else {
+        sprintf(out, "%llu KB", numBytes / 1024);
+    }
+}
+
+// measures every variant on every format in buffers of one size.
+// returns 0 on success, -1 if the buffers could not be allocated
+int benchmarkSize(unsigned long long size, double minTime) {
+    unsigned char* input = malloc((size_t)size);
+    unsigned char* output = malloc((size_t)size);
+    if (input == NULL || output == NULL) {
+        free(input);
+        free(output);
+        return -1;
+    }
+    // the output is written once so its pages are in memory before anything is timed
+    fillSynthetic(input, size);
+    memset(output, 0, (size_t)size);
+
+    char sizeName[32];
+    formatSize(sizeName, size);
+    for (int f = 0; f < NUM_PIXEL_FORMATS; f++) {
+        const PixelFormat* format = &pixelFormats[f];
+        // whole pixels only
+        unsigned long long numBytes = size - size % (3 * format->bytesPerChannel);
+        unsigned long long numPixels = numBytes / (3 * format->bytesPerChannel);
+        double memcpyRate = 0;
+
+        for (int v = 0; v < NUM_VARIANTS; v++) {
+            const Variant* variant = &variants[v];
+            if (!isVariantAvailable[v] || (variant->supports != NULL && !variant->supports(format))) {
+                continue;
+            }
+
+            setNumThreads(variant->numThreads);
+            setBackend(variant->backend);
+            double seconds = timeVariant(variant, input, output, numBytes, format, minTime);
+            if (seconds <= 0) {
+                printf("%-8s %-10s %-18s failed\n", sizeName, format->name, variant->name);
+                continue;
+            }
+
+            double rate = numBytes / seconds / 1e9;
+            if (variant->run == runMemcpy) {
+                memcpyRate = rate;
+            }
+            printf("%-8s %-10s %-18s %8.3f %8.4f %7.1f%%\n", sizeName, format->name, variant->name, rate,
+                numPixels / seconds / 1e9, memcpyRate > 0 ? 100 * rate / memcpyRate : 0);
+            fflush(stdout);
+        }
+    }
+
+    free(input);
+    free(output);
+    return 0;
+}
+
+// prints how to use the benchmark
+void printBenchmarkUsage(const char* programName) {
+    printf("usage: %s [--max-mb <n>] [--min-time <seconds>]\n", programName);
+    printf("       %s --corpus <dir> [--size <width>x<height>] [--seed <n>]\n", programName);
+    printf("  --max-mb <n>          largest buffer to measure in megabytes, default 1024. 4096 also\n");
+    printf("                        measures 4 GB, which needs twice that much free memory\n");
+    printf("  --min-time <seconds>  time each measurement runs for at least, default 0.25\n");
+    printf("  --corpus <dir>        instead of measuring, write a synthetic tiff of every layout, byte\n");
+    printf("                        order and bit depth into this existing directory\n");
+    printf("  --size <w>x<h>        size of the synthetic images, default 1024x768\n");
+    printf("  --seed <n>            seed of the synthetic images, default 1\n");
+    printf("       %s --batch <program> [--work <dir>] [--files <n>] [--runs <n>] [--size <w>x<h>]\n", programName);
+    printf("          [--seed <n>] [--baseline <file>] [--save-baseline <file>] [--tolerance <percent>]\n");
+    printf("  --batch <program>     instead of measuring the kernels, convert a synthetic batch of jpegs,\n");
+    printf("                        pngs and tiffs with the program serially, pipelined and in parallel\n");
+    printf("  --work <dir>          where the batch, outputs and metrics go, default batch-benchmark\n");
+    printf("  --files <n>           images in the batch, default 30\n");
+    printf("  --runs <n>            runs of every mode, the fastest is kept, default 3\n");
+    printf("  --baseline <file>     fail if a mode converts fewer files per second than in this file\n");
+    printf("  --save-baseline <file>\n");
+    printf("                        write the results to this file to compare later runs with\n");
+    printf("  --tolerance <percent> how much slower than the baseline a mode may be, default 10\n");
+    printf("       %s --verify [--samples <n>] [--size <w>x<h>] [--seed <n>]\n", programName);
+    printf("  --verify              instead of measuring, check every kernel against the reference on\n");
+    printf("                        every 8 bit pixel, 16 bit pixels and synthetic images\n");
+    printf("  --samples <n>         random 16 bit pixels checked in each byte order, default 1000000\n");
+}
+
+int main(int argc, char** argv) {
+    unsigned long long maxBytes = 1024ULL * 1024 * 1024;
+    double minTime = 0.25;
+    const char* corpusDir = NULL;
+    int width = 1024;
+    int height = 768;
+    unsigned int seed = 1;
+    BatchOptions batch;
+    getDefaultBatchOptions(&batch);
+    int verify = 0;
+    int numSamples = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-mb") == 0 && i + 1 < argc) {
+            maxBytes = strtoull(argv[++i], NULL, 10) * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTime = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            corpusDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc
+            && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+            i++;
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--verify") == 0) {
+            verify = 1;
+        }
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            numSamples = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch.program = argv[++i];
+        }
+        else if (strcmp(argv[i], "--work") == 0 && i + 1 < argc) {
+            batch.workDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--files") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            batch.numFiles = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            batch.numRuns = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            batch.baselinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc) {
+            batch.savePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            batch.tolerance = atof(argv[++i]) / 100;
+        }
+        else {
+            printBenchmarkUsage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+        }
+    }
+
+    if (verify) {
+        VerifyOptions verifyOptions = { seed, numSamples, width, height };
+        return runVerification(&verifyOptions);
+    }
+
+    if (batch.program != NULL) {
+        batch.width = width;
+        batch.height = height;
+        batch.seed = seed;
+        return runBatchBenchmark(&batch);
+    }
+
+    if (corpusDir != NULL) {
+        return writeTiffCorpus(corpusDir, width, height, seed) == 0 ? 0 : 1;
+    }
+
+    for (int v = 0; v < NUM_VARIANTS; v++) {
+        isVariantAvailable[v] = setBackend(variants[v].backend) == 0;
+    }
+
+    printf("%d cores, GB/s of input processed, %% of memcpy of the same buffer\n", getNumCores());
+    printf("%-8s %-10s %-18s %8s %8s %8s\n", "size", "format", "variant", "GB/s", "pix/ns", "memcpy");
+    for (int s = 0; s < NUM_BUFFER_SIZES && bufferSizes[s] <= maxBytes; s++) {
+        // buffers larger than the address space of a 32 bit build are skipped
+        if (bufferSizes[s] > (size_t)-1 / 2 || benchmarkSize(bufferSizes[s], minTime) != 0) {
+            char sizeName[32];
+            formatSize(sizeName, bufferSizes[s]);
+            printf("%-8s could not allocate two buffers of this size, skipped\n", sizeName);
+        }
+    }
+
+    return 0;
+}
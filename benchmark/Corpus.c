@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Corpus.h"
+#include "Tiff.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// quality of the synthetic jpegs, about what cameras save
+#define JPEG_QUALITY 90
+
+// rows in every strip of the layouts that have neither one strip nor a strip per row
+#define ROWS_PER_STRIP 16
+
+// width and height of the tiles, which tiff wants to be multiples of 16
+#define TILE_SIZE 64
+
+// size and number of the private tag of LAYOUT_PRIVATE_TAGS, from the range of tag
+// numbers tiff leaves to private use
+#define PRIVATE_TAG_BYTES (1024 * 1024)
+#define PRIVATE_TAG 65000
+
+// most entries a synthetic directory has
+#define MAX_CORPUS_ENTRIES 16
+
+// the tiff field types used
+#define TYPE_SHORT 3
+#define TYPE_LONG 4
+#define TYPE_UNDEFINED 7
+#define TYPE_LONG8 16
+
+// returns the name of a layout as used in the file names of the corpus
+const char* getTiffLayoutName(TiffLayout layout) {
+    static const char* names[NUM_LAYOUTS] = {
+        "single-strip", "strips", "scattered", "tiled", "planar", "private-tags", "bigtiff"
+    };
+
+    return layout >= 0 && layout < NUM_LAYOUTS ? names[layout] : "unknown";
+}
+
+// returns the next number of a xorshift sequence, state must not start at 0
+unsigned int nextRandom(unsigned int* state) {
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// mixes the bits of a number so neighbouring numbers give unrelated results
+unsigned int hashNumber(unsigned int x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// returns a channel of a pixel of the synthetic image
+unsigned int getSyntheticSample(unsigned int seed, int x, int y, int channel, int width, int height,
+    int bitsPerSample) {
+    // red is pushed up and blue down, the cast the kernel removes
+    static const int casts[3] = { 6000, 0, -6000 };
+
+    long long value = ((long long)x * 65535 / width + (long long)y * 65535 / height) / 2 + casts[channel];
+    unsigned int index = ((unsigned int)y * width + x) * 3 + channel;
+    value += (long long)(hashNumber(seed ^ hashNumber(index)) % 2048) - 1024;
+    if (value < 0) {
+        value = 0;
+    }
+    if (value > 65535) {
+        value = 65535;
+    }
+
+    return bitsPerSample == 16 ? (unsigned int)value : (unsigned int)value >> 8;
+}
+
+// writes the samples of strip or tile index to data at pointer
+void writeChunk(unsigned char* data, unsigned long long pointer, const SyntheticTiff* tiff, unsigned int index,
+    unsigned int rowsPerStrip, unsigned int stripsPerPlane) {
+    unsigned int bytesPerSample = tiff->bitsPerSample / 8;
+
+    if (tiff->layout == LAYOUT_TILED) {
+        // the tiles on the right and bottom edge are padded with zeros
+        unsigned int tilesAcross = (tiff->width + TILE_SIZE - 1) / TILE_SIZE;
+        int left = (index % tilesAcross) * TILE_SIZE;
+        int top = (index / tilesAcross) * TILE_SIZE;
+        for (int y = top; y < top + TILE_SIZE; y++) {
+            for (int x = left; x < left + TILE_SIZE; x++) {
+                for (int c = 0; c < 3; c++) {
+                    unsigned int value = x < tiff->width && y < tiff->height
+                        ? getSyntheticSample(tiff->seed, x, y, c, tiff->width, tiff->height, tiff->bitsPerSample) : 0;
+                    setInt(value, (unsigned int)pointer, bytesPerSample, data, tiff->isLittle);
+                    pointer += bytesPerSample;
+                }
+            }
+        }
+        return;
+    }
+
+    // planar strips hold a single channel, the strips of red come first
+    int isPlanar = tiff->layout == LAYOUT_PLANAR;
+    int firstChannel = isPlanar ? (int)(index / stripsPerPlane) : 0;
+    int lastChannel = isPlanar ? firstChannel : 2;
+    int top = (index % stripsPerPlane) * rowsPerStrip;
+    int bottom = top + (int)rowsPerStrip < tiff->height ? top + (int)rowsPerStrip : tiff->height;
+    for (int y = top; y < bottom; y++) {
+        for (int x = 0; x < tiff->width; x++) {
+            for (int c = firstChannel; c <= lastChannel; c++) {
+                unsigned int value = getSyntheticSample(tiff->seed, x, y, c, tiff->width, tiff->height,
+                    tiff->bitsPerSample);
+                setInt(value, (unsigned int)pointer, bytesPerSample, data, tiff->isLittle);
+                pointer += bytesPerSample;
+            }
+        }
+    }
+}
+
+// writes a synthetic tiff to path
+int writeSyntheticTiff(const char* path, const SyntheticTiff* tiff) {
+    if (tiff->width <= 0 || tiff->height <= 0 || (tiff->bitsPerSample != 8 && tiff->bitsPerSample != 16)) {
+        printf("ERROR: synthetic tiffs need a size and 8 or 16 bits per sample\n");
+        return -1;
+    }
+
+    int isBig = tiff->layout == LAYOUT_BIGTIFF;
+    int isTiled = tiff->layout == LAYOUT_TILED;
+    int isPlanar = tiff->layout == LAYOUT_PLANAR;
+    unsigned int bytesPerSample = tiff->bitsPerSample / 8;
+    unsigned int rowsPerStrip = tiff->layout == LAYOUT_STRIPS ? 1 : ROWS_PER_STRIP;
+    if (tiff->layout == LAYOUT_SINGLE_STRIP || isBig || rowsPerStrip > (unsigned int)tiff->height) {
+        rowsPerStrip = tiff->height;
+    }
+    unsigned int stripsPerPlane = (tiff->height + rowsPerStrip - 1) / rowsPerStrip;
+    unsigned int tilesAcross = (tiff->width + TILE_SIZE - 1) / TILE_SIZE;
+    unsigned int tilesDown = (tiff->height + TILE_SIZE - 1) / TILE_SIZE;
+    unsigned int numChunks = isTiled ? tilesAcross * tilesDown : stripsPerPlane * (isPlanar ? 3 : 1);
+
+    unsigned long long* offsets = malloc(numChunks * sizeof(unsigned long long));
+    unsigned long long* byteCounts = malloc(numChunks * sizeof(unsigned long long));
+    unsigned int* order = malloc(numChunks * sizeof(unsigned int));
+    unsigned char* privateBytes = tiff->layout == LAYOUT_PRIVATE_TAGS ? malloc(PRIVATE_TAG_BYTES) : NULL;
+    unsigned int random = tiff->seed * 2 + 1;
+    for (unsigned int i = 0; i < numChunks; i++) {
+        unsigned int rows = i % stripsPerPlane == stripsPerPlane - 1 ? tiff->height - (stripsPerPlane - 1) * rowsPerStrip
+            : rowsPerStrip;
+        byteCounts[i] = isTiled ? (unsigned long long)TILE_SIZE * TILE_SIZE * 3 * bytesPerSample
+            : (unsigned long long)rows * tiff->width * (isPlanar ? 1 : 3) * bytesPerSample;
+        order[i] = i;
+    }
+    if (tiff->layout == LAYOUT_SCATTERED) {
+        for (unsigned int i = numChunks - 1; i > 0; i--) {
+            unsigned int j = nextRandom(&random) % (i + 1);
+            unsigned int temp = order[i];
+            order[i] = order[j];
+            order[j] = temp;
+        }
+    }
+    if (privateBytes != NULL) {
+        for (int i = 0; i < PRIVATE_TAG_BYTES; i++) {
+            privateBytes[i] = (unsigned char)nextRandom(&random);
+        }
+    }
+
+    // the entries in the order of their tags, as tiff wants them
+    unsigned long long bitsPerSample[3] = { tiff->bitsPerSample, tiff->bitsPerSample, tiff->bitsPerSample };
+    unsigned int offsetType = isBig ? TYPE_LONG8 : TYPE_LONG;
+    TiffEntry entries[MAX_CORPUS_ENTRIES];
+    memset(entries, 0, sizeof(entries));
+    int n = 0;
+    entries[n++] = (TiffEntry){ .tag = 256, .type = TYPE_LONG, .count = 1, .value = tiff->width };
+    entries[n++] = (TiffEntry){ .tag = 257, .type = TYPE_LONG, .count = 1, .value = tiff->height };
+    entries[n++] = (TiffEntry){ .tag = 258, .type = TYPE_SHORT, .count = 3, .values = bitsPerSample };
+    // no compression
+    entries[n++] = (TiffEntry){ .tag = 259, .type = TYPE_SHORT, .count = 1, .value = 1 };
+    // rgb
+    entries[n++] = (TiffEntry){ .tag = 262, .type = TYPE_SHORT, .count = 1, .value = 2 };
+    if (!isTiled) {
+        entries[n++] = (TiffEntry){ .tag = 273, .type = offsetType, .count = numChunks, .values = offsets };
+    }
+    // samples per pixel
+    entries[n++] = (TiffEntry){ .tag = 277, .type = TYPE_SHORT, .count = 1, .value = 3 };
+    if (!isTiled) {
+        entries[n++] = (TiffEntry){ .tag = 278, .type = TYPE_LONG, .count = 1, .value = rowsPerStrip };
+        entries[n++] = (TiffEntry){ .tag = 279, .type = offsetType, .count = numChunks, .values = byteCounts };
+    }
+    // planar configuration
+    entries[n++] = (TiffEntry){ .tag = 284, .type = TYPE_SHORT, .count = 1, .value = isPlanar ? 2 : 1 };
+    if (isTiled) {
+        entries[n++] = (TiffEntry){ .tag = 322, .type = TYPE_LONG, .count = 1, .value = TILE_SIZE };
+        entries[n++] = (TiffEntry){ .tag = 323, .type = TYPE_LONG, .count = 1, .value = TILE_SIZE };
+        entries[n++] = (TiffEntry){ .tag = 324, .type = offsetType, .count = numChunks, .values = offsets };
+        entries[n++] = (TiffEntry){ .tag = 325, .type = offsetType, .count = numChunks, .values = byteCounts };
+    }
+    if (privateBytes != NULL) {
+        entries[n++] = (TiffEntry){ .tag = PRIVATE_TAG, .type = TYPE_UNDEFINED, .count = PRIVATE_TAG_BYTES,
+            .bytes = privateBytes };
+    }
+
+    // layout of the file: header | directory | strips, or header | strips | directory when
+    // scattered, which also leaves gaps of up to 255 bytes of noise before every strip
+    unsigned long long headerLen = isBig ? 16 : 8;
+    unsigned long long directoryLen = getTiffDirectoryLength(entries, n, isBig);
+    int isDirectoryLast = tiff->layout == LAYOUT_SCATTERED;
+    unsigned long long pointer = isDirectoryLast ? headerLen : headerLen + directoryLen;
+    unsigned int gapRandom = random;
+    for (unsigned int i = 0; i < numChunks; i++) {
+        if (isDirectoryLast) {
+            pointer += nextRandom(&random) % 256;
+        }
+        offsets[order[i]] = pointer;
+        pointer += byteCounts[order[i]];
+    }
+    unsigned long long directoryPtr = isDirectoryLast ? pointer + (pointer & 1) : headerLen;
+    unsigned long long dataLen = isDirectoryLast ? directoryPtr + directoryLen : pointer;
+
+    int result = 0;
+    unsigned char* data = NULL;
+    // every pointer of a classic tiff, and everything this program reads, is 32 bits
+    if (dataLen > 0xffffffffULL) {
+        printf("ERROR: synthetic tiffs are limited to 4 GB\n");
+        result = -1;
+    }
+    else if ((data = calloc((size_t)dataLen, 1)) == NULL) {
+        printf("ERROR: not enough memory for a synthetic tiff of %llu bytes\n", dataLen);
+        result = -1;
+    }
+
+    if (result == 0) {
+        writeTiffHeader(data, directoryPtr, isBig, tiff->isLittle);
+        writeTiffDirectory(data, directoryPtr, entries, n, isBig, tiff->isLittle);
+
+        for (unsigned int i = 0; i < numChunks; i++) {
+            unsigned int index = order[i];
+            if (isDirectoryLast) {
+                // the same gaps as when the offsets were laid out, filled with noise
+                unsigned int gap = nextRandom(&gapRandom) % 256;
+                for (unsigned int j = 1; j <= gap; j++) {
+                    data[offsets[index] - j] = (unsigned char)hashNumber(j ^ index);
+                }
+            }
+            writeChunk(data, offsets[index], tiff, index, rowsPerStrip, stripsPerPlane);
+        }
+
+        Tiff file;
+        memset(&file, 0, sizeof(Tiff));
+        file.data = data;
+        file.dataLen = (unsigned long)dataLen;
+        result = writeTiff(&file, (char*)path);
+    }
+
+    free(data);
+    free(offsets);
+    free(byteCounts);
+    free(order);
+    free(privateBytes);
+    return result;
+}
+
+// writes every layout in both byte orders at 8 and 16 bits
+int writeTiffCorpus(const char* dir, int width, int height, unsigned int seed) {
+    int numFailed = 0;
+    for (int layout = 0; layout < NUM_LAYOUTS; layout++) {
+        for (int bits = 8; bits <= 16; bits += 8) {
+            for (int isLittle = 1; isLittle >= 0; isLittle--) {
+                SyntheticTiff tiff = { (TiffLayout)layout, width, height, bits, isLittle, seed };
+                char* path = malloc(strlen(dir) + 64);
+                sprintf(path, "%s/%s-%d-%s.tif", dir, getTiffLayoutName((TiffLayout)layout), bits,
+                    isLittle ? "ii" : "mm");
+                if (writeSyntheticTiff(path, &tiff) == 0) {
+                    printf("wrote %s\n", path);
+                }
+                else {
+                    printf("ERROR: could not write %s\n", path);
+                    numFailed++;
+                }
+                free(path);
+            }
+        }
+    }
+
+    return numFailed;
+}
+
+// writes the synthetic image as an 8 bit png or jpeg, depending on the extension of path
+int writeSyntheticImage(const char* path, int width, int height, unsigned int seed) {
+    unsigned char* pixels = malloc((size_t)width * height * 3);
+    if (pixels == NULL) {
+        printf("ERROR: not enough memory for a %dx%d synthetic image\n", width, height);
+        return -1;
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                pixels[((size_t)y * width + x) * 3 + c] =
+                    (unsigned char)getSyntheticSample(seed, x, y, c, width, height, 8);
+            }
+        }
+    }
+
+    int written;
+    const char* extension = strrchr(path, '.');
+    if (extension != NULL && strcmp(extension, ".png") == 0) {
+        written = stbi_write_png(path, width, height, 3, pixels, width * 3);
+    }
+    else {
+        written = stbi_write_jpg(path, width, height, 3, pixels, JPEG_QUALITY);
+    }
+
+    free(pixels);
+    return written ? 0 : -1;
+}
+
+// writes numFiles images taking turns between jpeg, png and tiff
+int writeBatchCorpus(const char* dir, int numFiles, int width, int height, unsigned int seed) {
+    static const char* extensions[3] = { "jpg", "png", "tif" };
+    int numFailed = 0;
+    for (int i = 0; i < numFiles; i++) {
+        char* path = malloc(strlen(dir) + 32);
+        sprintf(path, "%s/batch-%04d.%s", dir, i, extensions[i % 3]);
+
+        int result;
+        if (i % 3 == 2) {
+            // every other tiff has 16 bits per sample, alternating byte orders
+            SyntheticTiff tiff = { LAYOUT_STRIPS, width, height, i / 3 % 2 ? 16 : 8, i / 6 % 2 == 0, seed + i };
+            result = writeSyntheticTiff(path, &tiff);
+        }
+        else {
+            result = writeSyntheticImage(path, width, height, seed + i);
+        }
+
+        if (result != 0) {
+            printf("ERROR: could not write %s\n", path);
+            numFailed++;
+        }
+        free(path);
+    }
+
+    return numFailed;
+}
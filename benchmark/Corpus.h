@@ -0,0 +1,56 @@
+#ifndef COLORCAST_CORPUS_H
+#define COLORCAST_CORPUS_H
+
+// synthetic images for the benchmarks and for checking the readers, written from a seed
+// so the same seed and size always give the same files, byte for byte
+
+// the ways a tiff can store its pixels
+typedef enum {
+    LAYOUT_SINGLE_STRIP,
+    LAYOUT_STRIPS,              // a strip per row
+    LAYOUT_SCATTERED,           // strips out of order with gaps between them, the directory last
+    LAYOUT_TILED,
+    LAYOUT_PLANAR,              // every channel in strips of its own
+    LAYOUT_PRIVATE_TAGS,        // a megabyte of private tag data between the directory and the pixels
+    LAYOUT_BIGTIFF,
+    NUM_LAYOUTS
+} TiffLayout;
+
+// everything that decides the contents of a synthetic tiff
+typedef struct {
+    TiffLayout layout;
+    int width;
+    int height;
+    int bitsPerSample;          // 8 or 16
+    int isLittle;               // II or MM byte order
+    unsigned int seed;
+} SyntheticTiff;
+
+// returns the next number of a xorshift sequence, state must not start at 0
+unsigned int nextRandom(unsigned int* state);
+
+// returns the name of a layout as used in the file names of the corpus
+const char* getTiffLayoutName(TiffLayout layout);
+
+// returns a channel of a pixel of the synthetic image: gradients with a color cast and
+// some noise from the seed, the same for every layout and format
+unsigned int getSyntheticSample(unsigned int seed, int x, int y, int channel, int width, int height,
+    int bitsPerSample);
+
+// writes a synthetic tiff to path. returns 0 on success, -1 on failure
+int writeSyntheticTiff(const char* path, const SyntheticTiff* tiff);
+
+// writes every layout in both byte orders at 8 and 16 bits into the existing directory
+// dir, named like strips-16-mm.tif. returns the number of files that could not be written
+int writeTiffCorpus(const char* dir, int width, int height, unsigned int seed);
+
+// writes the synthetic image as an 8 bit png if path ends in .png and as a jpeg
+// otherwise. returns 0 on success, -1 on failure
+int writeSyntheticImage(const char* path, int width, int height, unsigned int seed);
+
+// writes numFiles jpegs, pngs and 8 and 16 bit tiffs in turn into the existing directory
+// dir, named like batch-0002.tif, each from its own seed. returns the number of files that
+// could not be written
+int writeBatchCorpus(const char* dir, int numFiles, int width, int height, unsigned int seed);
+
+#endif //COLORCAST_CORPUS_H
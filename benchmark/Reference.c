@@ -0,0 +1,71 @@
+#include <math.h>
+#include <stdlib.h>
+#include "Reference.h"
+
+// maps a value in one range into another, the same as mapDouble in Process.cu
+double referenceMap(double input, double inputStart, double inputEnd, double outputStart, double outputEnd) {
+    return outputStart + ((outputEnd - outputStart) / (inputEnd - inputStart)) * (input - inputStart);
+}
+
+// moves a channel towards the average of the pixel, the same as dampenColor in Process.cu
+int referenceDampen(int col, double avg, double grayness, double power) {
+    double diff = fabs(col - avg);
+    double change = diff * pow(grayness, power);
+
+    if (col > avg) {
+        return (int)(col - rint(change));
+    }
+
+    return col + (int)rint(change);
+}
+
+// reads channel c of a pixel
+int readChannel(const unsigned char* pixel, int c, int bytesPerChannel, int isLittle) {
+    if (bytesPerChannel == 1) {
+        return pixel[c];
+    }
+
+    const unsigned char* bytes = pixel + 2 * c;
+    return isLittle ? bytes[0] + (bytes[1] << 8) : (bytes[0] << 8) + bytes[1];
+}
+
+// writes channel c of a pixel, keeping the low bits like the stores of processPixel
+void writeChannel(unsigned char* pixel, int c, int value, int bytesPerChannel, int isLittle) {
+    if (bytesPerChannel == 1) {
+        pixel[c] = (unsigned char)value;
+        return;
+    }
+
+    unsigned char* bytes = pixel + 2 * c;
+    bytes[isLittle ? 0 : 1] = (unsigned char)value;
+    bytes[isLittle ? 1 : 0] = (unsigned char)(value >> 8);
+}
+
+// processes one pixel
+void referenceProcessPixel(const unsigned char* input, unsigned char* output, double power, int bytesPerChannel,
+    int isLittle) {
+    int red = readChannel(input, 0, bytesPerChannel, isLittle);
+    int green = readChannel(input, 1, bytesPerChannel, isLittle);
+    int blue = readChannel(input, 2, bytesPerChannel, isLittle);
+
+    double grayness = abs(red - green) + abs(red - blue) + abs(blue - green);
+
+    // 65536 rather than 65535 for 16 bits, as processPixel has it
+    int maxRange = bytesPerChannel == 1 ? 255 * 2 : 65536 * 2;
+    grayness = referenceMap(grayness, 0, maxRange, 0, 1);
+    grayness = 1 - grayness;
+
+    double avg = (double)(red + green + blue) / 3;
+    writeChannel(output, 0, referenceDampen(red, avg, grayness, power), bytesPerChannel, isLittle);
+    writeChannel(output, 1, referenceDampen(green, avg, grayness, power), bytesPerChannel, isLittle);
+    writeChannel(output, 2, referenceDampen(blue, avg, grayness, power), bytesPerChannel, isLittle);
+}
+
+// processes every whole pixel of a buffer
+void referenceProcessBuffer(const unsigned char* input, unsigned char* output, unsigned long long numBytes,
+    double power, int bytesPerChannel, int isLittle) {
+    unsigned long long bytesPerPixel = 3 * bytesPerChannel;
+    for (unsigned long long i = 0; i + bytesPerPixel <= numBytes; i += bytesPerPixel) {
+        referenceProcessPixel(input + i, output + i, power, bytesPerChannel, isLittle);
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef COLORCAST_REFERENCE_H
+#define COLORCAST_REFERENCE_H
+
+// the color cast kernel written one step at a time exactly like processPixel in
+// Process.cu, with no threads and nothing done for speed. Every backend is checked
+// against it, so change it only together with processPixel and KERNEL_VERSION
+
+// processes the pixel at input with power, writing it to output in the same format.
+// bytesPerChannel is 1 or 2, isLittle gives the byte order of 16 bit channels
+void referenceProcessPixel(const unsigned char* input, unsigned char* output, double power, int bytesPerChannel,
+    int isLittle);
+
+// processes every whole pixel of numBytes of contiguous rgb pixel data with power
+void referenceProcessBuffer(const unsigned char* input, unsigned char* output, unsigned long long numBytes,
+    double power, int bytesPerChannel, int isLittle);
+
+#endif //COLORCAST_REFERENCE_H
@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Backend.h"
+#include "ByteOrdering.h"
+#include "Corpus.h"
+#include "CpuProcess.h"
+#include "Reference.h"
+#include "Thread.h"
+#include "Verify.h"
+
+// pixels checked at a time, except for the synthetic images which are checked whole
+#define CHUNK_PIXELS 65536
+
+// pixels in every strip handed to processStrips. Not a divisor of CHUNK_PIXELS, so
+// the last strip of a chunk is shorter than the others
+#define STRIP_PIXELS 1000
+
+// pixels per row handed to cpuProcessArray
+#define ARRAY_WIDTH 256
+
+// 16 bit channel values at the ends of the range and of its bytes, every combination
+// of them is checked
+static const int edgeValues[] = {
+    0, 1, 2, 127, 128, 255, 256, 257, 32767, 32768, 32769, 65279, 65280, 65534, 65535
+};
+#define NUM_EDGE_VALUES (int)(sizeof(edgeValues) / sizeof(edgeValues[0]))
+
+// every kernel is checked with all of these in a single pass, the smallest and
+// largest power the program accepts and some between
+static const double verifyPowers[] = { 0.1, 1, 5, 15 };
+#define NUM_VERIFY_POWERS (int)(sizeof(verifyPowers) / sizeof(verifyPowers[0]))
+
+// fills data with the pixels of chunk index of a case, at most capacity of them.
+// returns the number of pixels, 0 once the case has no more chunks
+typedef unsigned long long (*FillChunk)(unsigned char* data, unsigned long long capacity, int chunk,
+    int bytesPerChannel, int isLittle, const VerifyOptions* options);
+
+// pixels of one format the kernels are checked on
+typedef struct {
+    const char* name;
+    int bytesPerChannel;
+    int isLittle;
+    FillChunk fill;
+} VerifyCase;
+
+// runs a kernel over numBytes of input once for every power, writing the result of
+// powers[i] to outputs[i]. returns 0 on success, -1 on failure
+typedef int (*RunKernel)(unsigned char* input, unsigned long long numBytes, const double* powers,
+    unsigned char** outputs, int numPowers, int bytesPerChannel, int isLittle);
+
+// a kernel that is checked against the reference
+typedef struct {
+    const char* name;
+    Backend backend;
+    RunKernel run;
+    int hostOrderOnly;          // 16 bit channels must be in the byte order of the machine
+    int tolerance;              // largest difference of a channel from the reference that passes
+} CheckedKernel;
+
+// how far the outputs of a kernel are from the reference over a case
+typedef struct {
+    unsigned long long numSamples;
+    unsigned long long numDiffering;
+    int maxDeviation;
+    int failed;                 // the kernel returned an error
+} KernelStats;
+
+// stores the channels of pixel index of data in the format of the case
+void storePixel(unsigned char* data, unsigned long long index, int red, int green, int blue, int bytesPerChannel,
+    int isLittle) {
+    int rgb[3] = { red, green, blue };
+    for (int c = 0; c < 3; c++) {
+        unsigned char* sample = data + (index * 3 + c) * bytesPerChannel;
+        if (bytesPerChannel == 1) {
+            sample[0] = (unsigned char)rgb[c];
+        }
+        else {
+            sample[isLittle ? 0 : 1] = (unsigned char)rgb[c];
+            sample[isLittle ? 1 : 0] = (unsigned char)(rgb[c] >> 8);
+        }
+    }
+}
+
+// returns sample index of data in the format of the case
+int loadSample(const unsigned char* data, unsigned long long index, int bytesPerChannel, int isLittle) {
+    if (bytesPerChannel == 1) {
+        return data[index];
+    }
+
+    const unsigned char* sample = data + index * 2;
+    return isLittle ? sample[0] | (sample[1] << 8) : (sample[0] << 8) | sample[1];
+}
+
+// every 8 bit pixel, with a chunk for each value of red
+unsigned long long fillEveryValue(unsigned char* data, unsigned long long capacity, int chunk, int bytesPerChannel,
+    int isLittle, const VerifyOptions* options) {
+    (void)capacity;
+    (void)options;
+    if (chunk > 255) {
+        return 0;
+    }
+
+    for (int green = 0; green < 256; green++) {
+        for (int blue = 0; blue < 256; blue++) {
+            storePixel(data, green * 256 + blue, chunk, green, blue, bytesPerChannel, isLittle);
+        }
+    }
+
+    return 256 * 256;
+}
+
+// every combination of the edge values, then every gray, then random pixels every
+// other of which is close to gray, where the rounding of the change is closest to
+// flipping
+unsigned long long fillSampled(unsigned char* data, unsigned long long capacity, int chunk, int bytesPerChannel,
+    int isLittle, const VerifyOptions* options) {
+    (void)capacity;
+    unsigned long long numPixels = 0;
+    if (chunk == 0) {
+        for (int r = 0; r < NUM_EDGE_VALUES; r++) {
+            for (int g = 0; g < NUM_EDGE_VALUES; g++) {
+                for (int b = 0; b < NUM_EDGE_VALUES; b++) {
+                    storePixel(data, numPixels++, edgeValues[r], edgeValues[g], edgeValues[b], bytesPerChannel,
+                        isLittle);
+                }
+            }
+        }
+        return numPixels;
+    }
+    if (chunk == 1) {
+        for (int value = 0; value < 65536; value++) {
+            storePixel(data, numPixels++, value, value, value, bytesPerChannel, isLittle);
+        }
+        return numPixels;
+    }
+
+    unsigned long long first = (unsigned long long)(chunk - 2) * CHUNK_PIXELS;
+    if (first >= (unsigned long long)options->numSamples) {
+        return 0;
+    }
+    numPixels = options->numSamples - first < CHUNK_PIXELS ? options->numSamples - first : CHUNK_PIXELS;
+
+    // a sequence of its own for every chunk, never starting at 0
+    unsigned int state = (options->seed + chunk) * 2654435761u | 1;
+    for (unsigned long long i = 0; i < numPixels; i++) {
+        int rgb[3];
+        int gray = nextRandom(&state) & 0xffff;
+        for (int c = 0; c < 3; c++) {
+            rgb[c] = i % 2 ? gray + (int)(nextRandom(&state) % 65) - 32 : (int)(nextRandom(&state) & 0xffff);
+            rgb[c] = rgb[c] < 0 ? 0 : rgb[c] > 65535 ? 65535 : rgb[c];
+        }
+        storePixel(data, i, rgb[0], rgb[1], rgb[2], bytesPerChannel, isLittle);
+    }
+
+    return numPixels;
+}
+
+// a synthetic image like those of the corpus, in a single chunk
+unsigned long long fillImage(unsigned char* data, unsigned long long capacity, int chunk, int bytesPerChannel,
+    int isLittle, const VerifyOptions* options) {
+    (void)capacity;
+    if (chunk > 0) {
+        return 0;
+    }
+
+    int width = options->width;
+    int height = options->height;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int rgb[3];
+            for (int c = 0; c < 3; c++) {
+                rgb[c] = (int)getSyntheticSample(options->seed, x, y, c, width, height, bytesPerChannel * 8);
+            }
+            storePixel(data, (unsigned long long)y * width + x, rgb[0], rgb[1], rgb[2], bytesPerChannel, isLittle);
+        }
+    }
+
+    return (unsigned long long)width * height;
+}
+
+// every case, add new ones here
+static const VerifyCase verifyCases[] = {
+    { "8 bit every pixel", 1, 1, fillEveryValue },
+    { "16 bit LE sampled", 2, 1, fillSampled },
+    { "16 bit BE sampled", 2, 0, fillSampled },
+    { "8 bit image", 1, 1, fillImage },
+    { "16 bit LE image", 2, 1, fillImage },
+    { "16 bit BE image", 2, 0, fillImage }
+};
+#define NUM_VERIFY_CASES (int)(sizeof(verifyCases) / sizeof(verifyCases[0]))
+
+// runs processBuffer of the backend selected for the kernel, the way jpegs and pngs are processed
+int runBufferKernel(unsigned char* input, unsigned long long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle) {
+    return processBuffer(input, (unsigned long)numBytes, powers, outputs, numPowers, bytesPerChannel, isLittle);
+}
+
+// runs processStrips of the backend selected for the kernel on strips of STRIP_PIXELS,
+// the way tiffs are processed
+int runStripsKernel(unsigned char* input, unsigned long long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle) {
+    unsigned int stripBytes = STRIP_PIXELS * 3 * bytesPerChannel;
+    unsigned int numStrips = (unsigned int)((numBytes + stripBytes - 1) / stripBytes);
+    unsigned int* offsets = malloc(numStrips * sizeof(unsigned int));
+    unsigned int* byteCounts = malloc(numStrips * sizeof(unsigned int));
+    for (unsigned int i = 0; i < numStrips; i++) {
+        offsets[i] = i * stripBytes;
+        byteCounts[i] = numBytes - offsets[i] < stripBytes ? (unsigned int)(numBytes - offsets[i]) : stripBytes;
+    }
+
+    int result = processStrips(input, (unsigned long)numBytes, numStrips, offsets, byteCounts, powers, outputs,
+        numPowers, bytesPerChannel, isLittle);
+
+    free(offsets);
+    free(byteCounts);
+    return result;
+}
+
+// runs the strided kernel of the library and the python module once per power, on
+// rows of ARRAY_WIDTH pixels
+int runArrayKernel(unsigned char* input, unsigned long long numBytes, const double* powers, unsigned char** outputs,
+    int numPowers, int bytesPerChannel, int isLittle) {
+    (void)isLittle;
+    ptrdiff_t pixelStride = 3 * bytesPerChannel;
+    ChannelType type = bytesPerChannel == 2 ? CHANNEL_UINT16 : CHANNEL_UINT8;
+    unsigned long long numPixels = numBytes / pixelStride;
+    int height = (int)(numPixels / ARRAY_WIDTH);
+    int lastWidth = (int)(numPixels % ARRAY_WIDTH);
+
+    for (int i = 0; i < numPowers; i++) {
+        PixelArray in = { input, ARRAY_WIDTH * pixelStride, pixelStride, bytesPerChannel };
+        PixelArray out = { outputs[i], ARRAY_WIDTH * pixelStride, pixelStride, bytesPerChannel };
+        if (cpuProcessArray(&in, &out, height, ARRAY_WIDTH, type, powers[i]) != 0) {
+            return -1;
+        }
+
+        // the pixels that do not fill a whole row
+        in.data += (ptrdiff_t)height * in.rowStride;
+        out.data += (ptrdiff_t)height * out.rowStride;
+        if (cpuProcessArray(&in, &out, 1, lastWidth, type, powers[i]) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// every kernel that is checked, add new ones here. The cpu kernels must match the
+// reference exactly. pow on the gpu may differ from the c library in the last bit,
+// which moves a channel by one when the change is right between two integers
+static const CheckedKernel checkedKernels[] = {
+    { "cpu buffer", BACKEND_CPU, runBufferKernel, 0, 0 },
+    { "cpu strips", BACKEND_CPU, runStripsKernel, 0, 0 },
+    { "cpu array", BACKEND_CPU, runArrayKernel, 1, 0 },
+#ifndef COLORCAST_NO_CUDA
+    { "cuda buffer", BACKEND_CUDA, runBufferKernel, 0, 1 },
+    { "cuda strips", BACKEND_CUDA, runStripsKernel, 0, 1 },
+#endif
+};
+#define NUM_CHECKED_KERNELS (int)(sizeof(checkedKernels) / sizeof(checkedKernels[0]))
+
+// adds how many of numSamples samples of output differ from the reference, and by
+// how much at most, to stats
+void compareSamples(const unsigned char* output, const unsigned char* reference, unsigned long long numSamples,
+    int bytesPerChannel, int isLittle, KernelStats* stats) {
+    for (unsigned long long i = 0; i < numSamples; i++) {
+        int deviation = abs(loadSample(output, i, bytesPerChannel, isLittle)
+            - loadSample(reference, i, bytesPerChannel, isLittle));
+        if (deviation != 0) {
+            stats->numDiffering++;
+            if (deviation > stats->maxDeviation) {
+                stats->maxDeviation = deviation;
+            }
+        }
+    }
+    stats->numSamples += numSamples;
+}
+
+// runs every available kernel over every chunk of a case and compares it with the
+// reference. returns 0 on success, -1 if a kernel failed or is out of tolerance
+int checkCase(const VerifyCase* verifyCase, const VerifyOptions* options, const int* isAvailable,
+    unsigned char* input, unsigned long long capacity, unsigned char** references, unsigned char** outputs) {
+    int bytesPerChannel = verifyCase->bytesPerChannel;
+    int isLittle = verifyCase->isLittle;
+    KernelStats stats[NUM_CHECKED_KERNELS];
+    memset(stats, 0, sizeof(stats));
+
+    unsigned long long numPixels;
+    for (int chunk = 0; (numPixels = verifyCase->fill(input, capacity, chunk, bytesPerChannel, isLittle, options)) > 0;
+        chunk++) {
+        unsigned long long numBytes = numPixels * 3 * bytesPerChannel;
+        for (int p = 0; p < NUM_VERIFY_POWERS; p++) {
+            referenceProcessBuffer(input, references[p], numBytes, verifyPowers[p], bytesPerChannel, isLittle);
+        }
+
+        for (int k = 0; k < NUM_CHECKED_KERNELS; k++) {
+            const CheckedKernel* kernel = &checkedKernels[k];
+            if (!isAvailable[k] || stats[k].failed
+                || (kernel->hostOrderOnly && bytesPerChannel == 2 && isLittle != isHostLittleEndian())) {
+                continue;
+            }
+
+            setBackend(kernel->backend);
+            if (kernel->run(input, numBytes, verifyPowers, outputs, NUM_VERIFY_POWERS, bytesPerChannel, isLittle) != 0) {
+                stats[k].failed = 1;
+                continue;
+            }
+            for (int p = 0; p < NUM_VERIFY_POWERS; p++) {
+                compareSamples(outputs[p], references[p], numPixels * 3, bytesPerChannel, isLittle, &stats[k]);
+            }
+        }
+    }
+
+    int result = 0;
+    for (int k = 0; k < NUM_CHECKED_KERNELS; k++) {
+        const CheckedKernel* kernel = &checkedKernels[k];
+        if (stats[k].failed) {
+            printf("%-18s %-12s failed to run\n", verifyCase->name, kernel->name);
+            result = -1;
+            continue;
+        }
+        if (stats[k].numSamples == 0) {
+            continue;
+        }
+
+        int isWithin = stats[k].maxDeviation <= kernel->tolerance;
+        printf("%-18s %-12s %12llu %10llu %8d %9d %s\n", verifyCase->name, kernel->name, stats[k].numSamples,
+            stats[k].numDiffering, stats[k].maxDeviation, kernel->tolerance, isWithin ? "" : "OUT OF TOLERANCE");
+        fflush(stdout);
+        if (!isWithin) {
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+// checks every kernel against the reference
+int runVerification(const VerifyOptions* options) {
+    int isAvailable[NUM_CHECKED_KERNELS];
+    for (int k = 0; k < NUM_CHECKED_KERNELS; k++) {
+        isAvailable[k] = setBackend(checkedKernels[k].backend) == 0;
+    }
+
+    // chunks and whole images are at most this many pixels
+    unsigned long long capacity = (unsigned long long)options->width * options->height;
+    if (capacity < CHUNK_PIXELS) {
+        capacity = CHUNK_PIXELS;
+    }
+    size_t bufferBytes = (size_t)(capacity * 3 * 2);
+    unsigned char* input = malloc(bufferBytes);
+    unsigned char* references[NUM_VERIFY_POWERS];
+    unsigned char* outputs[NUM_VERIFY_POWERS];
+    int allocated = input != NULL;
+    for (int p = 0; p < NUM_VERIFY_POWERS; p++) {
+        references[p] = malloc(bufferBytes);
+        outputs[p] = malloc(bufferBytes);
+        allocated = allocated && references[p] != NULL && outputs[p] != NULL;
+    }
+
+    int failed = 0;
+    if (!allocated) {
+        printf("ERROR: not enough memory to verify %dx%d images\n", options->width, options->height);
+        failed = 1;
+    }
+    else {
+        setNumThreads(0);
+        printf("channels that differ from the reference kernel with powers");
+        for (int p = 0; p < NUM_VERIFY_POWERS; p++) {
+            printf(" %g", verifyPowers[p]);
+        }
+        printf("\n%-18s %-12s %12s %10s %8s %9s\n", "case", "kernel", "samples", "differing", "max diff",
+            "tolerance");
+        for (int c = 0; c < NUM_VERIFY_CASES; c++) {
+            if (checkCase(&verifyCases[c], options, isAvailable, input, capacity, references, outputs) != 0) {
+                failed = 1;
+            }
+        }
+        printf(failed ? "FAILED: a kernel does not match the reference\n"
+            : "PASSED: every kernel is within its tolerance of the reference\n");
+    }
+
+    free(input);
+    for (int p = 0; p < NUM_VERIFY_POWERS; p++) {
+        free(references[p]);
+        free(outputs[p]);
+    }
+    return failed;
+}
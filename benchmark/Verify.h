@@ -0,0 +1,21 @@
+#ifndef COLORCAST_VERIFY_H
+#define COLORCAST_VERIFY_H
+
+// runs every kernel the program and library use over the same pixels as the scalar
+// reference in Reference.h and reports how far each strays from it
+
+// what the kernels are checked on
+typedef struct {
+    unsigned int seed;          // of the random 16 bit pixels and the synthetic images
+    int numSamples;             // random 16 bit pixels in each byte order
+    int width;                  // size of the synthetic images
+    int height;
+} VerifyOptions;
+
+// checks every available kernel on every 8 bit pixel, edge, gray and random 16 bit
+// pixels in both byte orders and whole synthetic images, printing the samples that
+// differ from the reference and the largest difference. returns 0 if every kernel
+// is within its tolerance, 1 otherwise
+int runVerification(const VerifyOptions* options);
+
+#endif //COLORCAST_VERIFY_H
@@ -0,0 +1,201 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Backend.h"
+#include "ByteOrdering.h"
+#include "ColorCast.h"
+#include "CpuProcess.h"
+#include "Failure.h"
+#include "Thread.h"
+#include "Tiff.h"
+
+// the library only handles rgb, the program defines this in main.cpp
+const int NUM_CHANNELS = 3;
+
+// keeps why a call failed for colorcastLastError and returns -1
+int failWith(const char* reason) {
+    reportFailure("%s", reason);
+    return -1;
+}
+
+// returns true if power is in the range the command line accepts
+int isValidPower(double power) {
+    return power >= .1 && power <= 15;
+}
+
+// returns the COLORCAST_API_VERSION the library was built with
+int colorcastGetApiVersion(void) {
+    return COLORCAST_API_VERSION;
+}
+
+// returns why the last call on this thread failed
+const char* colorcastLastError(void) {
+    return getFailure();
+}
+
+// selects where images are processed
+int colorcastSetBackend(const char* name) {
+    clearFailure();
+    Backend backend;
+    if (name == NULL || parseBackend(name, &backend) != 0) {
+        return failWith("unknown backend");
+    }
+
+    return setBackend(backend);
+}
+
+// sets the number of threads the cpu backend uses
+int colorcastSetNumThreads(int numThreads) {
+    clearFailure();
+    if (numThreads < 0) {
+        return failWith("the number of threads must not be negative");
+    }
+
+    setNumThreads(numThreads);
+    return 0;
+}
+
+// removes the color cast of interleaved rgb pixels in place
+int colorcastProcessRgb(unsigned char* pixels, int width, int height, size_t stride,
+    int bitsPerChannel, int isLittleEndian, double power) {
+    clearFailure();
+    if (pixels == NULL || width <= 0 || height <= 0 || (bitsPerChannel != 8 && bitsPerChannel != 16)) {
+        return failWith("pixels must be given with a size and 8 or 16 bits per channel");
+    }
+    if (!isValidPower(power)) {
+        return failWith("power must be from .1 to 15");
+    }
+
+    int bytesPerChannel = bitsPerChannel / 8;
+    unsigned long long rowBytes = (unsigned long long)width * NUM_CHANNELS * bytesPerChannel;
+    unsigned long long numBytes = rowBytes * height;
+    // the backends take the length as an unsigned long, which is 32 bits on windows
+    if (stride < rowBytes) {
+        return failWith("stride is shorter than a row");
+    }
+    if (numBytes > ULONG_MAX) {
+        return failWith("image is too large");
+    }
+
+    unsigned char* outputs[1] = { pixels };
+    if (stride == rowBytes) {
+        return processBuffer(pixels, (unsigned long)numBytes, &power, outputs, 1, bytesPerChannel, isLittleEndian != 0);
+    }
+
+    // padded rows are packed together so the backend sees one contiguous buffer,
+    // which keeps the gpu to a single copy each way
+    unsigned char* packed = malloc(numBytes);
+    if (packed == NULL) {
+        return failWith("not enough memory to pack the rows");
+    }
+    for (int y = 0; y < height; y++) {
+        memcpy(packed + y * rowBytes, pixels + y * stride, rowBytes);
+    }
+
+    outputs[0] = packed;
+    int result = processBuffer(packed, (unsigned long)numBytes, &power, outputs, 1, bytesPerChannel,
+        isLittleEndian != 0);
+    if (result == 0) {
+        for (int y = 0; y < height; y++) {
+            memcpy(pixels + y * stride, packed + y * rowBytes, rowBytes);
+        }
+    }
+
+    free(packed);
+    return result;
+}
+
+// returns true if the strides describe rows of pixels packed one after the other
+int isContiguous(const ptrdiff_t* strides, int width, int bytesPerChannel) {
+    return strides[2] == bytesPerChannel && strides[1] == NUM_CHANNELS * bytesPerChannel
+        && strides[0] == (ptrdiff_t)width * NUM_CHANNELS * bytesPerChannel;
+}
+
+// removes the color cast of a height x width x 3 array read through any strides
+int colorcastProcessArray(const void* input, const ptrdiff_t* inputStrides, void* output,
+    const ptrdiff_t* outputStrides, int height, int width, int type, double power) {
+    clearFailure();
+    if (input == NULL || output == NULL || inputStrides == NULL || outputStrides == NULL || height < 0 || width < 0) {
+        return failWith("arrays must be given with their strides and a size");
+    }
+    if (!isValidPower(power)) {
+        return failWith("power must be from .1 to 15");
+    }
+
+    ChannelType channelType;
+    int bytesPerChannel;
+    switch (type) {
+    case COLORCAST_UINT8:
+        channelType = CHANNEL_UINT8;
+        bytesPerChannel = 1;
+        break;
+    case COLORCAST_UINT16:
+        channelType = CHANNEL_UINT16;
+        bytesPerChannel = 2;
+        break;
+    case COLORCAST_FLOAT32:
+        channelType = CHANNEL_FLOAT32;
+        bytesPerChannel = 4;
+        break;
+    default:
+        return failWith("unknown channel type");
+    }
+
+    // the common case of a whole image in memory goes to the backend like the program does
+    unsigned long long numBytes = (unsigned long long)height * width * NUM_CHANNELS * bytesPerChannel;
+    if (channelType != CHANNEL_FLOAT32 && isContiguous(inputStrides, width, bytesPerChannel)
+        && isContiguous(outputStrides, width, bytesPerChannel) && numBytes <= ULONG_MAX) {
+        unsigned char* outputs[1] = { output };
+        return processBuffer((unsigned char*)input, (unsigned long)numBytes, &power, outputs, 1, bytesPerChannel,
+            isHostLittleEndian());
+    }
+
+    PixelArray in = { (unsigned char*)input, inputStrides[0], inputStrides[1], inputStrides[2] };
+    PixelArray out = { output, outputStrides[0], outputStrides[1], outputStrides[2] };
+    return cpuProcessArray(&in, &out, height, width, channelType, power);
+}
+
+// frees what readTiff allocated, the data belongs to the caller
+void freeTiffHeader(Tiff* tiff) {
+    free(tiff->entries);
+    free(tiff->stripOffsets);
+    free(tiff->bytesPerStrip);
+    free(tiff);
+}
+
+// removes the color cast of an uncompressed rgb tiff file in place
+int colorcastProcessTiff(unsigned char* data, size_t length, double power) {
+    clearFailure();
+    if (data == NULL || length > ULONG_MAX) {
+        return failWith("tiff must be given and smaller than 4 GB");
+    }
+    if (!isValidPower(power)) {
+        return failWith("power must be from .1 to 15");
+    }
+
+    Tiff* tiff = readTiff(data, (unsigned long)length);
+    // readTiff and isValidTiff keep why they reject the file themselves
+    if (tiff == NULL) {
+        return -1;
+    }
+    if (!isValidTiff(tiff)) {
+        freeTiffHeader(tiff);
+        return -1;
+    }
+
+    int bytesPerChannel = tiff->bitsPerSample / 8;
+    int result;
+    if (tiff->numStrips == 1) {
+        unsigned char* pixels = data + tiff->stripOffsets[0];
+        unsigned char* outputs[1] = { pixels };
+        result = processBuffer(pixels, tiff->bytesPerStrip[0], &power, outputs, 1, bytesPerChannel, tiff->isLittle);
+    }
+    else {
+        unsigned char* outputs[1] = { data };
+        result = processStrips(data, tiff->dataLen, tiff->numStrips, tiff->stripOffsets, tiff->bytesPerStrip,
+            &power, outputs, 1, bytesPerChannel, tiff->isLittle);
+    }
+
+    freeTiffHeader(tiff);
+    return result;
+}
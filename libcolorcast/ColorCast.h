@@ -0,0 +1,71 @@
+#ifndef COLORCAST_COLORCAST_H
+#define COLORCAST_COLORCAST_H
+
+// libcolorcast removes the color cast of images that are already in memory, for
+// programs that embed the kernel instead of running the command line tool. Only
+// plain C types cross the library boundary so the ABI stays stable between versions.
+// Every function returns 0 on success and -1 on failure, colorcastLastError tells why.
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#ifdef COLORCAST_BUILD_LIBRARY
+#define COLORCAST_API __declspec(dllexport)
+#else
+#define COLORCAST_API __declspec(dllimport)
+#endif
+#else
+#define COLORCAST_API __attribute__((visibility("default")))
+#endif
+
+// bumped whenever a function is added or changed
+#define COLORCAST_API_VERSION 3
+
+// element types of the channels passed to colorcastProcessArray
+#define COLORCAST_UINT8 0
+#define COLORCAST_UINT16 1      // in the byte order of the machine
+#define COLORCAST_FLOAT32 2     // expected to be from 0 to 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// returns the COLORCAST_API_VERSION the library was built with, so callers can
+// check the library they loaded matches the header they compiled against
+COLORCAST_API int colorcastGetApiVersion(void);
+
+// returns why the last call on this thread failed, or an empty string if it succeeded.
+// The library keeps its errors to this instead of printing them. The string belongs to
+// the library and stays valid until the next call on this thread. Since version 3
+COLORCAST_API const char* colorcastLastError(void);
+
+// selects where images are processed: "auto" uses the gpu if there is one, "cuda"
+// or "cpu". Call before processing from several threads at once
+COLORCAST_API int colorcastSetBackend(const char* name);
+
+// sets the number of threads the cpu backend uses, 0 uses one per core
+COLORCAST_API int colorcastSetNumThreads(int numThreads);
+
+// removes the color cast of interleaved rgb pixels in place. Rows are stride bytes
+// apart, channels have 8 or 16 bits and 16 bit channels are little endian if
+// isLittleEndian is not 0. power goes from .1, completely gray, to 15, almost no change
+COLORCAST_API int colorcastProcessRgb(unsigned char* pixels, int width, int height, size_t stride,
+    int bitsPerChannel, int isLittleEndian, double power);
+
+// removes the color cast of a height x width x 3 array read through any strides,
+// such as a view of a numpy array. strides hold the byte distance between rows,
+// pixels and channels and may be negative. output is either input itself or does
+// not overlap it. Contiguous 8 and 16 bit arrays run on the selected backend, every
+// other array runs on the cpu without being copied. Since version 2
+COLORCAST_API int colorcastProcessArray(const void* input, const ptrdiff_t* inputStrides, void* output,
+    const ptrdiff_t* outputStrides, int height, int width, int type, double power);
+
+// removes the color cast of an uncompressed rgb tiff file of length bytes in place.
+// Only pixel data changes, so the buffer stays a valid tiff that can be saved as is
+COLORCAST_API int colorcastProcessTiff(unsigned char* data, size_t length, double power);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //COLORCAST_COLORCAST_H
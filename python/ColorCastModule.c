@@ -0,0 +1,256 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "ColorCast.h"
+#include "Failure.h"
+#include "Handle.h"
+
+// the colorcast python module. Arrays are read and written through the buffer
+// protocol where they are, so numpy arrays and their views are never copied, and
+// the kernel runs without the GIL so other python threads keep running
+
+// returns the COLORCAST_ type of a buffer format, -1 if it is not supported
+static int getChannelType(const char* format) {
+    // native byte order and alignment are the only ones the kernel reads
+    if (format[0] == '@' || format[0] == '=' || format[0] == (PY_LITTLE_ENDIAN ? '<' : '>')) {
+        format++;
+    }
+
+    if (strcmp(format, "B") == 0) {
+        return COLORCAST_UINT8;
+    }
+    if (strcmp(format, "H") == 0) {
+        return COLORCAST_UINT16;
+    }
+    if (strcmp(format, "f") == 0) {
+        return COLORCAST_FLOAT32;
+    }
+
+    return -1;
+}
+
+// returns why the last call of the library on this thread failed
+static const char* getLastError(void) {
+    const char* reason = colorcastLastError();
+    return reason[0] != '\0' ? reason : "unknown reason";
+}
+
+// gets the buffer of a height x width x 3 array. returns the COLORCAST_ type of its
+// channels, -1 with an exception set if it is not such an array
+static int getPixelBuffer(PyObject* object, Py_buffer* view, int writable, const char* name) {
+    if (PyObject_GetBuffer(object, view, writable ? PyBUF_RECORDS : PyBUF_RECORDS_RO) != 0) {
+        return -1;
+    }
+
+    int type = getChannelType(view->format);
+    if (type < 0 || view->ndim != 3 || view->shape[2] != 3) {
+        PyErr_Format(PyExc_ValueError, "%s must be a height x width x 3 array of uint8, uint16 or float32", name);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    if (view->shape[0] > INT_MAX || view->shape[1] > INT_MAX) {
+        PyErr_Format(PyExc_ValueError, "%s is too large", name);
+        PyBuffer_Release(view);
+        return -1;
+    }
+
+    return type;
+}
+
+// returns true if the memory of two buffers overlaps
+static int buffersOverlap(Py_buffer* a, Py_buffer* b) {
+    char* aStart = (char*)a->buf;
+    char* bStart = (char*)b->buf;
+    // the extent of a strided buffer, whatever the signs of its strides
+    Py_ssize_t aLow = 0, aHigh = a->itemsize, bLow = 0, bHigh = b->itemsize;
+    for (int i = 0; i < 3; i++) {
+        Py_ssize_t aExtent = (a->shape[i] - 1) * a->strides[i];
+        Py_ssize_t bExtent = (b->shape[i] - 1) * b->strides[i];
+        if (aExtent < 0) aLow += aExtent; else aHigh += aExtent;
+        if (bExtent < 0) bLow += bExtent; else bHigh += bExtent;
+    }
+
+    return aStart + aLow < bStart + bHigh && bStart + bLow < aStart + aHigh;
+}
+
+PyDoc_STRVAR(processDoc,
+"process(array, power, out=None)\n"
+"\n"
+"Removes the color cast of a height x width x 3 array of uint8, uint16 or float32\n"
+"channels, any strides, such as a numpy array or a view of one. Floats are expected\n"
+"to be from 0 to 1. power goes from .1, completely gray, to 15, almost no change.\n"
+"Without out the array is changed in place, otherwise the result is written to out,\n"
+"which has the same shape and type and does not overlap array. Returns the array\n"
+"that was written.");
+
+static PyObject* process(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = { "array", "power", "out", NULL };
+    PyObject* array;
+    double power;
+    PyObject* out = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Od|O", keywords, &array, &power, &out)) {
+        return NULL;
+    }
+    if (power < .1 || power > 15) {
+        PyErr_SetString(PyExc_ValueError, "power must be from .1 to 15");
+        return NULL;
+    }
+
+    int inPlace = out == Py_None || out == array;
+    Py_buffer input;
+    int type = getPixelBuffer(array, &input, inPlace, "array");
+    if (type < 0) {
+        return NULL;
+    }
+
+    Py_buffer output;
+    if (inPlace) {
+        output = input;
+        out = array;
+    }
+    else {
+        if (getPixelBuffer(out, &output, 1, "out") != type) {
+            if (!PyErr_Occurred()) {
+                PyErr_SetString(PyExc_ValueError, "out must have the same type as array");
+                PyBuffer_Release(&output);
+            }
+            PyBuffer_Release(&input);
+            return NULL;
+        }
+        if (output.shape[0] != input.shape[0] || output.shape[1] != input.shape[1]
+            || buffersOverlap(&input, &output)) {
+            PyErr_SetString(PyExc_ValueError, "out must have the same shape as array and not overlap it");
+            PyBuffer_Release(&output);
+            PyBuffer_Release(&input);
+            return NULL;
+        }
+    }
+
+    ptrdiff_t inputStrides[3] = { input.strides[0], input.strides[1], input.strides[2] };
+    ptrdiff_t outputStrides[3] = { output.strides[0], output.strides[1], output.strides[2] };
+    int result;
+    Py_BEGIN_ALLOW_THREADS
+    result = colorcastProcessArray(input.buf, inputStrides, output.buf, outputStrides, (int)input.shape[0],
+        (int)input.shape[1], type, power);
+    Py_END_ALLOW_THREADS
+
+    if (!inPlace) {
+        PyBuffer_Release(&output);
+    }
+    PyBuffer_Release(&input);
+    if (result != 0) {
+        PyErr_Format(PyExc_RuntimeError, "processing failed: %s", getLastError());
+        return NULL;
+    }
+
+    Py_INCREF(out);
+    return out;
+}
+
+PyDoc_STRVAR(processFileDoc,
+"process_file(input, output, power)\n"
+"\n"
+"Converts an uncompressed rgb tiff, jpg or png file the same way the program does\n"
+"and writes the result to output in the same format.");
+
+static PyObject* processFile(PyObject* self, PyObject* args) {
+    const char* inputPath;
+    const char* outputPath;
+    double power;
+    if (!PyArg_ParseTuple(args, "ssd", &inputPath, &outputPath, &power)) {
+        return NULL;
+    }
+    if (power < .1 || power > 15) {
+        PyErr_SetString(PyExc_ValueError, "power must be from .1 to 15");
+        return NULL;
+    }
+
+    Job job;
+    memset(&job, 0, sizeof(Job));
+    job.imagePath = (char*)inputPath;
+    char* outputPaths[1] = { (char*)outputPath };
+    job.outputPaths = outputPaths;
+    job.numPowers = 1;
+
+    int result;
+    Py_BEGIN_ALLOW_THREADS
+    clearFailure();
+    result = loadJob(&job, 0);
+    if (result == 0) {
+        result = processJob(&job, &power);
+    }
+    if (result == 0) {
+        result = writeJob(&job);
+    }
+    freeJob(&job);
+    Py_END_ALLOW_THREADS
+
+    if (result != 0) {
+        PyErr_Format(PyExc_RuntimeError, "could not convert %s: %s", inputPath, getLastError());
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(setBackendDoc,
+"set_backend(name)\n"
+"\n"
+"Selects where contiguous uint8 and uint16 arrays and files are processed: \"auto\"\n"
+"uses the gpu if the module was built with it and there is one, \"cuda\" or \"cpu\".");
+
+static PyObject* setBackendName(PyObject* self, PyObject* args) {
+    const char* name;
+    if (!PyArg_ParseTuple(args, "s", &name)) {
+        return NULL;
+    }
+    if (colorcastSetBackend(name) != 0) {
+        PyErr_Format(PyExc_ValueError, "backend %s is unknown or not available", name);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(setThreadsDoc,
+"set_threads(count)\n"
+"\n"
+"Sets the number of threads used on the cpu, 0 uses one per core.");
+
+static PyObject* setThreads(PyObject* self, PyObject* args) {
+    int numThreads;
+    if (!PyArg_ParseTuple(args, "i", &numThreads)) {
+        return NULL;
+    }
+    if (colorcastSetNumThreads(numThreads) != 0) {
+        PyErr_SetString(PyExc_ValueError, "count must not be negative");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef methods[] = {
+    { "process", (PyCFunction)(void (*)(void))process, METH_VARARGS | METH_KEYWORDS, processDoc },
+    { "process_file", processFile, METH_VARARGS, processFileDoc },
+    { "set_backend", setBackendName, METH_VARARGS, setBackendDoc },
+    { "set_threads", setThreads, METH_VARARGS, setThreadsDoc },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    "colorcast",
+    "Removes the color cast of images in numpy arrays and files.",
+    -1,
+    methods
+};
+
+PyMODINIT_FUNC PyInit_colorcast(void) {
+    PyObject* colorcast = PyModule_Create(&module);
+    if (colorcast != NULL) {
+        PyModule_AddIntConstant(colorcast, "API_VERSION", colorcastGetApiVersion());
+    }
+
+    return colorcast;
+}
@@ -0,0 +1,31 @@
+# builds the colorcast python module with the cpu backend:
+#   pip install ./python
+# or, to try it without installing:
+#   python setup.py build_ext --inplace
+import os
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+src = os.path.join(here, "..", "ColorCastCuda")
+lib = os.path.join(here, "..", "libcolorcast")
+
+# the kernel and the loaders and encoders process_file uses, without the program itself
+sources = ["Backend.c", "Buffer.c", "ByteOrdering.c", "Clock.c", "Counters.c", "CpuProcess.c", "Decoder.c",
+           "Deflate.c", "DirEntry.c", "Failure.c", "File.c", "Handle.c", "Image.c", "Jpeg.c", "Png.c", "Stage.c",
+           "Thread.c", "Tiff.c", "tinyfiledialogs.c"]
+
+setup(
+    name="colorcast",
+    version="2",
+    description="Removes the color cast of images in numpy arrays and files",
+    ext_modules=[
+        Extension(
+            "colorcast",
+            sources=[os.path.join(here, "ColorCastModule.c"), os.path.join(lib, "ColorCast.c")]
+                    + [os.path.join(src, name) for name in sources],
+            include_dirs=[src, lib],
+            define_macros=[("COLORCAST_NO_CUDA", None), ("COLORCAST_BUILD_LIBRARY", None),
+                           ("_CRT_SECURE_NO_WARNINGS", None)],
+        )
+    ],
+)